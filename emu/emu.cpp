@@ -12,6 +12,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/wait.h>
 
 #define CYCLE_STEP_PERCENT 1
 
@@ -156,6 +157,17 @@ static int program_sz = 0;
 static int program_fd = 0;
 static void *program = NULL;
 static bool dut_end = false;
+static const char* load_checkpoint = NULL;
+static const char* save_checkpoint = NULL;
+static uint64_t save_cycles = 0; // 0: save when the simulation stops
+static const char* server_fifo = NULL;
+static uint64_t warmup_cycles = 0;
+static const char* trace_file = NULL;
+static uint64_t trace_begin = 0;
+static uint64_t trace_end = UINT64_MAX;
+static const char* trace_scope = "";
+static const char* cost_file = "cost-profile.txt";
+static uint64_t idle_cycles = 0; // cycles skipped by the quiescent model
 
 template <typename T>
 std::vector<size_t> sort_indexes(const std::vector<T> &v) {
@@ -192,9 +204,63 @@ static void close_program() {
   close(program_fd);
 }
 
+#ifdef GSIM
+template <typename T>
+static void dut_load(T& mem, const void* src, size_t size) { memcpy(&mem, src, size); }
+#ifdef GSIM_SPARSE_MEM
+template <typename T, uint64_t DEPTH, int PAGE_SHIFT>
+static void dut_load(SparseMem<T, DEPTH, PAGE_SHIFT>& mem, const void* src, size_t size) { mem.load(src, size); }
+#endif
+#endif
+
+static void load_memory() {
+#ifdef GSIM
+  dut_load(dut->DUT_MEMORY, program, program_sz);
+#endif
+#ifdef VERILATOR
+  memcpy(&ref->rootp->REF_MEMORY, program, program_sz);
+#endif
+#ifdef GSIM_DIFF
+  memcpy(&ref->DUT_MEMORY, program, program_sz);
+#endif
+}
+
+static void parse_args(int argc, char** argv) {
+  for (int i = 2; i < argc; i ++) {
+    if (strncmp(argv[i], "--load-checkpoint=", 18) == 0) load_checkpoint = argv[i] + 18;
+    else if (strncmp(argv[i], "--save-checkpoint=", 18) == 0) save_checkpoint = argv[i] + 18;
+    else if (strncmp(argv[i], "--save-cycles=", 14) == 0) save_cycles = strtoull(argv[i] + 14, NULL, 0);
+    else if (strncmp(argv[i], "--server=", 9) == 0) {
+#ifdef GSIM_THREADS
+      printf("--server requires a model evaluated by a single thread, worker threads are not forked\n");
+      exit(EXIT_FAILURE);
+#endif
+      server_fifo = argv[i] + 9;
+    }
+    else if (strncmp(argv[i], "--warmup=", 9) == 0) warmup_cycles = strtoull(argv[i] + 9, NULL, 0);
+    else if (strncmp(argv[i], "--trace=", 8) == 0) trace_file = argv[i] + 8;
+    else if (strncmp(argv[i], "--trace-begin=", 14) == 0) trace_begin = strtoull(argv[i] + 14, NULL, 0);
+    else if (strncmp(argv[i], "--trace-end=", 12) == 0) trace_end = strtoull(argv[i] + 12, NULL, 0);
+    else if (strncmp(argv[i], "--trace-scope=", 14) == 0) trace_scope = argv[i] + 14;
+    else if (strncmp(argv[i], "--cost-file=", 12) == 0) cost_file = argv[i] + 12;
+    else {
+      printf("Usage: %s <program> [--load-checkpoint=file] [--save-checkpoint=file] [--save-cycles=num] [--server=fifo] [--warmup=num]"
+             " [--trace=file[.gz]] [--trace-begin=cycle] [--trace-end=cycle] [--trace-scope=prefix] [--cost-file=file]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
 #ifdef GSIM
 void dut_cycle(int n) { while (n --) dut->step(); }
 void dut_reset() { dut->set_reset(1); dut_cycle(10); dut->set_reset(0); }
+void dut_save(uint64_t cycles) {
+  if (save_checkpoint == NULL) return;
+  bool ok = dut->saveCheckpoint(save_checkpoint);
+  assert(ok);
+  printf("save checkpoint %s after %ld cycles\n", save_checkpoint, cycles);
+  save_checkpoint = NULL;
+}
 #endif
 #ifdef VERILATOR
 void ref_cycle(int n) {
@@ -217,39 +283,31 @@ bool checkSignals(bool display) {
 }
 #endif
 
-int main(int argc, char** argv) {
-  load_program(argv[1]);
-#ifdef GSIM
-  dut = new DUT_NAME();
-  memcpy(&dut->DUT_MEMORY, program, program_sz);
-  dut_init(dut);
-  dut_reset();
-  dut_cycle(1);
-#endif
-#ifdef VERILATOR
-  ref = new REF_NAME();
-  memcpy(&ref->rootp->REF_MEMORY, program, program_sz);
-  ref_init(ref);
-  ref_reset();
-#endif
-#ifdef GSIM_DIFF
-  ref = new REF_NAME();
-  memcpy(&ref->DUT_MEMORY, program, program_sz);
-  ref_reset();
+#define CYCLE_REPORT (CYCLE_MAX_SIM / (CYCLE_STEP_PERCENT * 100))
+
+/* the next cycle checked by sim_loop, a quiescent model is fast-forwarded to it */
+static uint64_t next_stop(uint64_t cycles, uint64_t max_cycles) {
+  uint64_t stop = std::min<uint64_t>(max_cycles, (cycles / CYCLE_REPORT + 1) * CYCLE_REPORT);
+  if (save_cycles > cycles) stop = std::min(stop, save_cycles);
+#ifdef PERF
+  if (CYCLE_MAX_PERF > cycles) stop = std::min<uint64_t>(stop, CYCLE_MAX_PERF);
 #endif
-  close_program();
+  return stop;
+}
 
-  std::cout << "start testing.....\n";
-  std::signal(SIGINT, [](int){ dut_end = true; });
-  std::signal(SIGTERM, [](int){ dut_end = true; });
-  uint64_t cycles = 0;
+/* simulate until max_cycles or a signal, returns the exit code */
+static int sim_loop(uint64_t& cycles, uint64_t max_cycles) {
 #ifdef PERF
   FILE* activeFp = fopen(ACTIVE_FILE, "w");
 #endif
   auto start = std::chrono::system_clock::now();
   while (!dut_end) {
+    uint64_t n = 1;
 #if defined(GSIM)
-    dut_cycle(1);
+#if !defined(VERILATOR) && !defined(GSIM_DIFF)
+    if (dut->isQuiescent()) n = std::max<uint64_t>(next_stop(cycles, max_cycles), cycles + 1) - cycles;
+#endif
+    idle_cycles += dut->step(n);
     dut_hook(dut);
 #endif
 #ifdef VERILATOR
@@ -259,7 +317,10 @@ int main(int argc, char** argv) {
 #ifdef GSIM_DIFF
     ref_cycle(1);
 #endif
-    cycles ++;
+    cycles += n;
+#ifdef GSIM
+    if (cycles == save_cycles) dut_save(cycles);
+#endif
 #if (defined(VERILATOR) || defined(GSIM_DIFF)) && defined(GSIM)
     bool isDiff = checkSignals(false);
     if(isDiff) {
@@ -271,42 +332,145 @@ int main(int argc, char** argv) {
       return -1;
     }
 #endif
-    if (cycles % (CYCLE_MAX_SIM / (CYCLE_STEP_PERCENT * 100)) == 0 && cycles <= CYCLE_MAX_SIM) {
+    if (cycles % CYCLE_REPORT == 0 && cycles <= CYCLE_MAX_SIM) {
       auto dur = std::chrono::system_clock::now() - start;
       auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(dur);
-      fprintf(stderr, "cycles %ld (%ld ms, %ld per sec) simulation process %.2lf%% \n",
-          cycles, msec.count(), cycles * 1000 / msec.count(), (double)cycles * 100 / CYCLE_MAX_SIM);
+      fprintf(stderr, "cycles %ld (%ld idle, %ld ms, %ld per sec) simulation process %.2lf%% \n",
+          cycles, idle_cycles, msec.count(), cycles * 1000 / std::max<long>(msec.count(), 1), (double)cycles * 100 / CYCLE_MAX_SIM);
 #ifdef PERF
+      size_t superNum = sizeof(dut->activeTimes) / sizeof(dut->activeTimes[0]);
       size_t totalActives = 0;
       size_t validActives = 0;
       size_t nodeActives = 0;
-      for (size_t i = 0; i < sizeof(dut->activeTimes) / sizeof(dut->activeTimes[0]); i ++) {
+      for (size_t i = 0; i < superNum; i ++) {
         totalActives += dut->activeTimes[i];
         validActives += dut->validActive[i];
         nodeActives += dut->nodeNum[i] * dut->activeTimes[i];
       }
-      printf("nodeNum %ld totalActives %ld activePerCycle %ld totalValid %ld validPerCycle %ld nodeActive %ld\n",
-          nodeNum, totalActives, totalActives / cycles, validActives, validActives / cycles, nodeActives);
-      fprintf(activeFp, "totalActives %ld activePerCycle %ld totalValid %ld validPerCycle %ld\n",
-          totalActives, totalActives / cycles, validActives, validActives / cycles);
-      for (size_t i = 1; i < sizeof(dut->activeTimes) / sizeof(dut->activeTimes[0]); i ++) {
-        fprintf(activeFp, "%ld: activeTimes %ld validActive %ld\n", i, dut->activeTimes[i], dut->validActive[i]);
-      }
-
-      std::ofstream out("data/active/activeTimes" + std::to_string(cycles / 10000000) + ".txt");
-      std::vector<uint64_t> activeTimes(dut->allActiveTimes);
-      std::vector<uint64_t> sorted = sort_indexes(activeTimes);
-      out << "posActives " << dut->posActivate << " " << dut->posActivate / cycles << " actives " << dut->activeNum / cycles << std::endl;
-      out << "funcTime " << dut->funcTime << " activeTime " << dut->activeTime << " regsTime " << dut->regsTime << " memoryTime " << dut->memoryTime << std::endl;
-      for (int i = sorted.size()-1; i >= 0; i --) {
-        if (dut->allNames[sorted[i]].length() == 0) continue;
-        out << dut->allNames[sorted[i]] << " " << dut->nodeNum[sorted[i]] << " " << (double)activeTimes[sorted[i]] / cycles << " " << activeTimes[sorted[i]] << " " \
-            << dut->posActives[sorted[i]] << " "  << (double)dut->posActives[sorted[i]] / activeTimes[sorted[i]] << std::endl;
+      printf("superNum %ld totalActives %ld activePerCycle %ld totalValid %ld validPerCycle %ld nodeActive %ld\n",
+          superNum, totalActives, totalActives / cycles, validActives, validActives / cycles, nodeActives);
+      fprintf(activeFp, "totalActives %ld activePerCycle %ld totalValid %ld validPerCycle %ld cycles %ld\n",
+          totalActives, totalActives / cycles, validActives, validActives / cycles, cycles);
+      for (size_t i = 0; i < superNum; i ++) {
+        fprintf(activeFp, "%ld: activeTimes %ld validActive %ld %s\n", i, dut->activeTimes[i], dut->validActive[i], dut->activeMembers[i]);
       }
+      fflush(activeFp);
 
       if (cycles == CYCLE_MAX_PERF) return 0;
 #endif
-      if (cycles == CYCLE_MAX_SIM) return 0;
     }
+    if (cycles == max_cycles) break;
   }
+#ifdef GSIM
+  dut_save(cycles);
+  if (idle_cycles != 0) printf("fast-forward %ld idle cycles of %ld cycles\n", idle_cycles, cycles);
+#endif
+  return 0;
+}
+
+/*
+  fork server: after the warmup, every line "<image|-> [max cycles] [log file]" read from the fifo
+  forks a child, which loads the image into the memory of its copy-on-write model and simulates it
+*/
+static int fork_server(uint64_t& cycles) {
+  if (warmup_cycles != 0) {
+    int ret = sim_loop(cycles, cycles + warmup_cycles);
+    if (ret != 0 || dut_end) return ret;
+  }
+  if (access(server_fifo, F_OK) != 0) {
+    int ret = mkfifo(server_fifo, 0600);
+    assert(ret == 0);
+  }
+  printf("server ready at %s after %ld cycles\n", server_fifo, cycles);
+  fflush(stdout);
+  int workloads = 0;
+  char line[4096], image[4096], log[4096];
+  while (!dut_end) {
+    FILE* fp = fopen(server_fifo, "r"); // wait for a client
+    if (fp == NULL) break;
+    while (!dut_end && fgets(line, sizeof(line), fp)) {
+      unsigned long max_cycles = CYCLE_MAX_SIM;
+      log[0] = '\0';
+      if (sscanf(line, "%4095s %lu %4095s", image, &max_cycles, log) < 1) continue;
+      if (strcmp(image, "quit") == 0) {
+        dut_end = true;
+        break;
+      }
+      pid_t pid = fork();
+      assert(pid != -1);
+      if (pid == 0) {
+        fclose(fp);
+        if (log[0] != '\0' && freopen(log, "w", stdout) == NULL) exit(EXIT_FAILURE);
+        if (strcmp(image, "-") != 0) {
+          load_program(image);
+          load_memory();
+          close_program();
+        }
+        exit(sim_loop(cycles, cycles + max_cycles));
+      }
+      workloads ++;
+      while (waitpid(-1, NULL, WNOHANG) > 0) ; // reap finished workloads
+    }
+    fclose(fp);
+  }
+  while (wait(NULL) > 0) ;
+  printf("server stopped after %d workloads\n", workloads);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  parse_args(argc, argv);
+  load_program(argv[1]);
+#ifdef GSIM
+  dut = new DUT_NAME();
+#endif
+#if defined(VERILATOR) || defined(GSIM_DIFF)
+  ref = new REF_NAME();
+#endif
+  load_memory();
+  close_program();
+#ifdef GSIM
+  dut_init(dut);
+  dut_reset();
+  dut_cycle(1);
+#endif
+#ifdef VERILATOR
+  ref_init(ref);
+  ref_reset();
+#endif
+#ifdef GSIM_DIFF
+  ref_reset();
+#endif
+
+  uint64_t cycles = 0;
+#ifdef GSIM
+  if (load_checkpoint) {
+    uint64_t cycleBase = dut->cycles;
+    bool ok = dut->loadCheckpoint(load_checkpoint);
+    assert(ok);
+    cycles = dut->cycles - cycleBase;
+    printf("load checkpoint %s after %ld cycles\n", load_checkpoint, cycles);
+  }
+#endif
+
+  std::cout << "start testing.....\n";
+  std::signal(SIGINT, [](int){ dut_end = true; });
+  std::signal(SIGTERM, [](int){ dut_end = true; });
+  if (server_fifo) return fork_server(cycles);
+#ifdef GSIM_TRACE
+  if (trace_file) {
+    bool ok = dut->traceOpen(trace_file, trace_begin, trace_end, trace_scope);
+    assert(ok);
+  }
+#endif
+  int ret = sim_loop(cycles, CYCLE_MAX_SIM);
+#ifdef GSIM_TRACE
+  dut->traceClose();
+#endif
+#ifdef GSIM_COST_PROFILE
+  bool ok = dut->costDump(cost_file);
+  assert(ok);
+  printf("cost profile %s\n", cost_file);
+#endif
+  return ret;
 }
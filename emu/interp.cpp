@@ -0,0 +1,568 @@
+/*
+  interpreter of the bytecode emitted by gsim --backend=interp
+  Loading translates the 32-bit code words into cells of direct-threaded code: the opcode becomes the address of
+  its handler and the operands become pointers into the register file, the state and the active flags, so that a
+  handler dispatches to the next one with a single indirect jump.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include "interp.h"
+#include "bytecode.h"
+
+#define WORD_BITS 64
+
+/* addresses of the handlers in exec, indexed by opcode */
+static const void* const* handlers;
+
+static void loadError(const char* path, const char* msg) {
+  fprintf(stderr, "GSimInterp: %s: %s\n", path, msg);
+  exit(EXIT_FAILURE);
+}
+
+static inline int wordNum(uint64_t width) { return (width + WORD_BITS - 1) / WORD_BITS; }
+
+static inline uint64_t widthMask(uint64_t width) { return width >= WORD_BITS ? ~0ull : (1ull << width) - 1; }
+
+static inline uint64_t topMask(uint64_t width) { return widthMask(width - (wordNum(width) - 1) * WORD_BITS); }
+
+static inline int64_t sext(uint64_t val, uint64_t shift) { return (int64_t)(val << shift) >> shift; }
+
+static inline int storageSize(uint64_t width) { return width <= 8 ? 1 : (width <= 16 ? 2 : (width <= 32 ? 4 : 8)); }
+
+/* helpers of wide values, destinations never alias sources */
+
+static inline bool signBit(const uint64_t* a, uint64_t width) {
+  return (a[(width - 1) / WORD_BITS] >> ((width - 1) % WORD_BITS)) & 1;
+}
+
+static void extW(uint64_t* dst, uint64_t dstWidth, const uint64_t* src, uint64_t srcWidth, bool sign) {
+  int dn = wordNum(dstWidth), sn = wordNum(srcWidth);
+  bool neg = sign && srcWidth < dstWidth && signBit(src, srcWidth);
+  for (int i = 0; i < dn; i ++) dst[i] = i < sn ? src[i] : (neg ? ~0ull : 0);
+  if (neg) dst[sn - 1] |= ~topMask(srcWidth);
+  dst[dn - 1] &= topMask(dstWidth);
+}
+
+static void addW(uint64_t* dst, const uint64_t* a, const uint64_t* b, uint64_t width) {
+  int n = wordNum(width);
+  uint64_t carry = 0;
+  for (int i = 0; i < n; i ++) {
+    uint64_t sum = a[i] + carry;
+    carry = sum < carry;
+    dst[i] = sum + b[i];
+    carry += dst[i] < sum;
+  }
+  dst[n - 1] &= topMask(width);
+}
+
+static void subW(uint64_t* dst, const uint64_t* a, const uint64_t* b, uint64_t width) {
+  int n = wordNum(width);
+  uint64_t borrow = 0;
+  for (int i = 0; i < n; i ++) {
+    uint64_t diff = a[i] - b[i];
+    uint64_t nextBorrow = a[i] < b[i];
+    nextBorrow |= diff < borrow;
+    dst[i] = diff - borrow;
+    borrow = nextBorrow;
+  }
+  dst[n - 1] &= topMask(width);
+}
+
+static void mulW(uint64_t* dst, const uint64_t* a, const uint64_t* b, uint64_t width) {
+  int n = wordNum(width);
+  memset(dst, 0, n * sizeof(uint64_t));
+  for (int i = 0; i < n; i ++) {
+    uint64_t carry = 0;
+    for (int j = 0; i + j < n; j ++) {
+      __uint128_t prod = (__uint128_t)a[i] * b[j] + dst[i + j] + carry;
+      dst[i + j] = (uint64_t)prod;
+      carry = (uint64_t)(prod >> WORD_BITS);
+    }
+  }
+  dst[n - 1] &= topMask(width);
+}
+
+static void negW(uint64_t* val, uint64_t width) {
+  int n = wordNum(width);
+  uint64_t carry = 1;
+  for (int i = 0; i < n; i ++) {
+    val[i] = ~val[i] + carry;
+    carry = carry && val[i] == 0;
+  }
+  val[n - 1] &= topMask(width);
+}
+
+static int cmpUW(const uint64_t* a, const uint64_t* b, int n) {
+  for (int i = n - 1; i >= 0; i --) {
+    if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+static bool isZeroW(const uint64_t* a, int n) {
+  for (int i = 0; i < n; i ++) {
+    if (a[i]) return false;
+  }
+  return true;
+}
+
+/* bitwise long division, x / 0 and x % 0 are 0 as in the C++ model */
+static void divW(uint64_t* dst, const uint64_t* a, const uint64_t* b, uint64_t width, bool sign, bool rem) {
+  int n = wordNum(width);
+  memset(dst, 0, n * sizeof(uint64_t));
+  if (isZeroW(b, n)) return;
+  std::vector<uint64_t> ua(a, a + n), ub(b, b + n), quo(n, 0), r(n, 0);
+  bool negA = sign && signBit(a, width), negB = sign && signBit(b, width);
+  if (negA) negW(ua.data(), width);
+  if (negB) negW(ub.data(), width);
+  for (int bit = width - 1; bit >= 0; bit --) {
+    for (int i = n - 1; i > 0; i --) r[i] = (r[i] << 1) | (r[i - 1] >> (WORD_BITS - 1));
+    r[0] = (r[0] << 1) | ((ua[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1);
+    if (cmpUW(r.data(), ub.data(), n) >= 0) {
+      subW(r.data(), r.data(), ub.data(), (uint64_t)n * WORD_BITS);
+      quo[bit / WORD_BITS] |= 1ull << (bit % WORD_BITS);
+    }
+  }
+  std::vector<uint64_t>& ret = rem ? r : quo;
+  if (rem ? negA : negA != negB) negW(ret.data(), width);
+  memcpy(dst, ret.data(), n * sizeof(uint64_t));
+  dst[n - 1] &= topMask(width);
+}
+
+static uint64_t cmpW(const uint64_t* a, const uint64_t* b, uint64_t width, uint64_t kind) {
+  int n = wordNum(width);
+  int cmp;
+  bool negA = signBit(a, width), negB = signBit(b, width);
+  if ((kind & BC_CMP_SIGN) && negA != negB) cmp = negA ? -1 : 1;
+  else cmp = cmpUW(a, b, n);
+  switch (kind & ~BC_CMP_SIGN) {
+    case BC_CMP_LT: return cmp < 0;
+    case BC_CMP_LEQ: return cmp <= 0;
+    case BC_CMP_GT: return cmp > 0;
+    case BC_CMP_GEQ: return cmp >= 0;
+    case BC_CMP_EQ: return cmp == 0;
+    default: return cmp != 0;
+  }
+}
+
+static void shlW(uint64_t* dst, const uint64_t* a, uint64_t amount, uint64_t width) {
+  int n = wordNum(width);
+  if (amount >= width) {
+    memset(dst, 0, n * sizeof(uint64_t));
+    return;
+  }
+  int ws = amount / WORD_BITS, bs = amount % WORD_BITS;
+  for (int i = n - 1; i >= 0; i --) {
+    uint64_t hi = i - ws >= 0 ? a[i - ws] << bs : 0;
+    uint64_t lo = bs && i - ws - 1 >= 0 ? a[i - ws - 1] >> (WORD_BITS - bs) : 0;
+    dst[i] = hi | lo;
+  }
+  dst[n - 1] &= topMask(width);
+}
+
+static void shrW(uint64_t* dst, const uint64_t* a, uint64_t amount, uint64_t width, bool sign) {
+  int n = wordNum(width);
+  bool neg = sign && signBit(a, width);
+  uint64_t fill = neg ? ~0ull : 0;
+  auto word = [&](int idx) {
+    if (idx >= n) return fill;
+    return idx == n - 1 && neg ? a[idx] | ~topMask(width) : a[idx];
+  };
+  if (amount >= width) {
+    for (int i = 0; i < n; i ++) dst[i] = fill;
+  } else {
+    int ws = amount / WORD_BITS, bs = amount % WORD_BITS;
+    for (int i = 0; i < n; i ++) {
+      dst[i] = word(i + ws) >> bs;
+      if (bs) dst[i] |= word(i + ws + 1) << (WORD_BITS - bs);
+    }
+  }
+  dst[n - 1] &= topMask(width);
+}
+
+static uint64_t andrW(const uint64_t* a, uint64_t width) {
+  int n = wordNum(width);
+  for (int i = 0; i < n - 1; i ++) {
+    if (a[i] != ~0ull) return 0;
+  }
+  return a[n - 1] == topMask(width);
+}
+
+static uint64_t xorrW(const uint64_t* a, uint64_t width) {
+  int n = wordNum(width), parity = 0;
+  for (int i = 0; i < n; i ++) parity ^= __builtin_popcountll(a[i]);
+  return parity & 1;
+}
+
+/* same conversions as gprintf of the C++ model */
+static void interpPrintf(const char* format, const BCCell* args, uint64_t argNum) {
+  uint64_t idx = 0;
+  for (const char* p = format; *p; p ++) {
+    if (*p != '%' || !p[1]) {
+      fputc(*p, stderr);
+      continue;
+    }
+    p ++;
+    uint64_t val = idx < argNum ? *args[idx ++].reg : 0;
+    switch (*p) {
+      case 'c': fputc((char)val, stderr); break;
+      case 'x': fprintf(stderr, "%lx", val); break;
+      default: fprintf(stderr, "%ld", val); break;
+    }
+  }
+}
+
+static void interpAssert(const char* msg) {
+  fprintf(stderr, "\033[1;31m%s\033[0m\n", msg);
+  abort();
+}
+
+GSimInterp::GSimInterp(const char* path) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp) loadError(path, "cannot open");
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  std::vector<uint32_t> file(size / sizeof(uint32_t));
+  if (fread(file.data(), sizeof(uint32_t), file.size(), fp) != file.size()) loadError(path, "cannot read");
+  fclose(fp);
+  size_t pos = 0;
+  auto get = [&]() {
+    if (pos >= file.size()) loadError(path, "truncated");
+    return file[pos ++];
+  };
+  auto getStr = [&]() {
+    uint32_t len = get();
+    if (pos + (len + 3) / 4 > file.size()) loadError(path, "truncated");
+    std::string str((const char*)&file[pos], len);
+    pos += (len + 3) / 4;
+    return str;
+  };
+  if (get() != BC_MAGIC) loadError(path, "not a gsim bytecode file");
+  if (get() != BC_VERSION) loadError(path, "bytecode version mismatch, regenerate it with this gsim");
+  uint32_t stateSize = get();
+  uint32_t flagNum = get();
+  uint32_t regNum = get();
+  superNum = get();
+  state.resize((stateSize + 7) / 8 + 1);
+  flags.resize((flagNum + 7) & ~7, 0);
+  regs.resize(regNum + 1);
+  std::vector<uint32_t> code(get());
+  for (uint32_t& word : code) word = get();
+  strs.resize(get());
+  for (std::string& str : strs) str = getStr();
+  std::vector<size_t> cellIdx;
+  translate(code, cellIdx);
+  auto entry = [&](uint32_t offset) -> const BCCell* {
+    if (offset == BC_NONE) return nullptr;
+    if (offset >= code.size()) loadError(path, "bad entry");
+    return &cells[cellIdx[offset]];
+  };
+  auto getActivation = [&](std::vector<Activation>& acts) {
+    acts.resize(get());
+    for (Activation& act : acts) {
+      act.byte = get();
+      act.mask = get();
+      if (act.byte >= flagNum) loadError(path, "bad activation");
+    }
+  };
+  superEntry.resize(superNum);
+  for (const BCCell*& super : superEntry) super = entry(get());
+  initEntry = entry(get());
+  prologueEntry = entry(get());
+  resets.resize(get());
+  for (Reset& reset : resets) {
+    reset.cond = stateBase() + get();
+    reset.condSize = get();
+    reset.entry = entry(get());
+    reset.activateAll = get();
+    getActivation(reset.acts);
+  }
+  for (std::vector<Port>* ports : {&inputs, &outputs}) {
+    ports->resize(get());
+    for (Port& port : *ports) {
+      port.name = getStr();
+      port.width = get();
+      uint32_t offset = get();
+      port.var = offset == BC_NONE ? nullptr : stateBase() + offset;
+      if (ports == &inputs) {
+        getActivation(port.acts);
+      } else {
+        port.cons.resize(get());
+        for (uint64_t& word : port.cons) {
+          word = get();
+          word |= (uint64_t)get() << 32;
+        }
+      }
+    }
+  }
+  init();
+}
+
+/* code words to threaded cells, cellIdx maps the word offset of every instruction to its cell */
+void GSimInterp::translate(const std::vector<uint32_t>& code, std::vector<size_t>& cellIdx) {
+  if (!handlers) exec(nullptr);
+  cellIdx.assign(code.size(), 0);
+  std::vector<size_t> targets;
+  size_t pos = 0;
+  auto word = [&]() {
+    if (pos >= code.size()) loadError("code", "truncated instruction");
+    return code[pos ++];
+  };
+  auto push = [&](BCCell cell) { cells.push_back(cell); };
+  while (pos < code.size()) {
+    cellIdx[pos] = cells.size();
+    uint32_t op = word();
+    if (op >= BC_OP_NUM) loadError("code", "bad opcode");
+    BCCell cell;
+    cell.op = handlers[op];
+    push(cell);
+    for (const char* kind = bcOpSig[op]; *kind; kind ++) {
+      uint32_t val = word();
+      switch (*kind) {
+        case 'R': cell.reg = &regs[val]; break;
+        case 'V': cell.var = stateBase() + val; break;
+        case 'W': cell.imm = val | (uint64_t)word() << 32; break;
+        case 'I': cell.imm = val; break;
+        case 'M': cell.imm = widthMask(val); break;
+        case 'S': cell.imm = WORD_BITS - val; break;
+        case 'T': targets.push_back(cells.size()); cell.imm = val; break;
+        case 'F': cell.var = &flags[val]; break;
+        case 'X': cell.str = strs[val].c_str(); break;
+        case 'N':
+          cell.imm = val;
+          push(cell);
+          for (uint32_t i = 0; i < val; i ++) {
+            cell.reg = &regs[word()];
+            push(cell);
+          }
+          continue;
+        case 'C':
+          cell.imm = val;
+          push(cell);
+          for (uint32_t i = 0; i < val; i ++) {
+            cell.imm = word();
+            cell.imm |= (uint64_t)word() << 32;
+            push(cell);
+          }
+          continue;
+        default: loadError("code", "bad signature");
+      }
+      push(cell);
+    }
+  }
+  for (size_t idx : targets) {
+    if (cells[idx].imm >= code.size()) loadError("code", "bad jump target");
+    cells[idx].target = &cells[cellIdx[cells[idx].imm]];
+  }
+}
+
+void GSimInterp::activate(const std::vector<Activation>& acts) {
+  for (const Activation& act : acts) flags[act.byte] |= act.mask;
+}
+
+void GSimInterp::init() {
+  cycles = 0;
+  std::fill(state.begin(), state.end(), 0);
+  std::fill(flags.begin(), flags.end(), 0xff);
+  if (initEntry) exec(initEntry);
+}
+
+void GSimInterp::step() {
+  if (prologueEntry) exec(prologueEntry);
+  int byteNum = (superNum + 7) / 8;
+  for (int byte = 0; byte < byteNum; byte ++) {
+    /* bits below the last evaluated one are activated for the next cycle */
+    uint32_t done = 0;
+    for (uint32_t pending; (pending = flags[byte] & ~done); ) {
+      int bit = __builtin_ctz(pending);
+      done = (2u << bit) - 1;
+      flags[byte] &= ~(1u << bit);
+      int id = byte * 8 + bit;
+      if (id < superNum && superEntry[id]) exec(superEntry[id]);
+    }
+  }
+  for (Reset& reset : resets) {
+    bool cond = false;
+    for (uint32_t i = 0; i < reset.condSize; i ++) cond |= reset.cond[i] != 0;
+    if (!cond) continue;
+    if (reset.activateAll) std::fill(flags.begin(), flags.end(), 0xff);
+    else activate(reset.acts);
+    if (reset.entry) exec(reset.entry);
+  }
+  cycles ++;
+}
+
+void GSimInterp::setInput(int idx, const uint64_t* val) {
+  Port& port = inputs[idx];
+  bool changed;
+  if (port.width <= WORD_BITS) {
+    int size = storageSize(port.width);
+    uint64_t cur = 0, next = val[0] & widthMask(port.width);
+    memcpy(&cur, port.var, size);
+    changed = cur != next;
+    memcpy(port.var, &next, size);
+  } else {
+    size_t size = wordNum(port.width) * sizeof(uint64_t);
+    changed = memcmp(port.var, val, size) != 0;
+    memcpy(port.var, val, size);
+    ((uint64_t*)port.var)[wordNum(port.width) - 1] &= topMask(port.width);
+  }
+  if (changed) activate(port.acts);
+}
+
+void GSimInterp::getOutput(int idx, uint64_t* val) {
+  Port& port = outputs[idx];
+  int n = wordNum(port.width);
+  memset(val, 0, n * sizeof(uint64_t));
+  if (!port.var) {
+    for (int i = 0; i < n && i < (int)port.cons.size(); i ++) val[i] = port.cons[i];
+  } else if (port.width <= WORD_BITS) {
+    memcpy(val, port.var, storageSize(port.width));
+  } else {
+    memcpy(val, port.var, n * sizeof(uint64_t));
+  }
+}
+
+#define R(i) (*pc[i].reg)
+#define P(i) (pc[i].reg)
+#define IMM(i) (pc[i].imm)
+#define NEXT(n) do { pc += (n); goto *pc->op; } while (0)
+#define VAR(type, i) (*(type*)pc[i].var)
+#define VARX(type, i, idx) (((type*)pc[i].var)[idx])
+#define WIDE_AT(i, idx, slots) ((uint64_t*)pc[i].var + (idx) * (slots))
+
+/* direct-threaded interpreter, pc points to the cell of the opcode and the operands follow it */
+void GSimInterp::exec(const BCCell* pc) {
+#define BC_LABEL(name, sig) &&L_##name,
+  static const void* const table[] = { BC_OPS(BC_LABEL) };
+#undef BC_LABEL
+  if (!pc) {
+    handlers = table;
+    return;
+  }
+  goto *pc->op;
+
+L_RET: return;
+L_CONST: R(1) = IMM(2); NEXT(3);
+
+L_LOAD1: R(1) = VAR(uint8_t, 2); NEXT(3);
+L_LOAD2: R(1) = VAR(uint16_t, 2); NEXT(3);
+L_LOAD4: R(1) = VAR(uint32_t, 2); NEXT(3);
+L_LOAD8: R(1) = VAR(uint64_t, 2); NEXT(3);
+L_LOADX1: R(1) = VARX(uint8_t, 2, R(3)); NEXT(4);
+L_LOADX2: R(1) = VARX(uint16_t, 2, R(3)); NEXT(4);
+L_LOADX4: R(1) = VARX(uint32_t, 2, R(3)); NEXT(4);
+L_LOADX8: R(1) = VARX(uint64_t, 2, R(3)); NEXT(4);
+L_STORE1: VAR(uint8_t, 1) = R(2); NEXT(3);
+L_STORE2: VAR(uint16_t, 1) = R(2); NEXT(3);
+L_STORE4: VAR(uint32_t, 1) = R(2); NEXT(3);
+L_STORE8: VAR(uint64_t, 1) = R(2); NEXT(3);
+L_STOREX1: VARX(uint8_t, 1, R(2)) = R(3); NEXT(4);
+L_STOREX2: VARX(uint16_t, 1, R(2)) = R(3); NEXT(4);
+L_STOREX4: VARX(uint32_t, 1, R(2)) = R(3); NEXT(4);
+L_STOREX8: VARX(uint64_t, 1, R(2)) = R(3); NEXT(4);
+
+L_MASK: R(1) = R(2) & IMM(3); NEXT(4);
+L_SEXT: R(1) = (uint64_t)sext(R(2), IMM(3)) & IMM(4); NEXT(5);
+L_ADD: R(1) = (R(2) + R(3)) & IMM(4); NEXT(5);
+L_SUB: R(1) = (R(2) - R(3)) & IMM(4); NEXT(5);
+L_MUL: R(1) = (R(2) * R(3)) & IMM(4); NEXT(5);
+L_DIVU: R(1) = R(3) ? R(2) / R(3) : 0; NEXT(4);
+L_REMU: R(1) = R(3) ? R(2) % R(3) : 0; NEXT(4);
+L_DIVS: {
+  int64_t a = sext(R(2), IMM(4)), b = sext(R(3), IMM(4));
+  uint64_t ret = b == 0 ? 0 : (b == -1 ? 0 - (uint64_t)a : (uint64_t)(a / b));
+  R(1) = ret & IMM(5);
+  NEXT(6);
+}
+L_REMS: {
+  int64_t a = sext(R(2), IMM(4)), b = sext(R(3), IMM(4));
+  uint64_t ret = b == 0 || b == -1 ? 0 : (uint64_t)(a % b);
+  R(1) = ret & IMM(5);
+  NEXT(6);
+}
+
+L_LTU: R(1) = R(2) < R(3); NEXT(4);
+L_LEU: R(1) = R(2) <= R(3); NEXT(4);
+L_GTU: R(1) = R(2) > R(3); NEXT(4);
+L_GEU: R(1) = R(2) >= R(3); NEXT(4);
+L_LTS: R(1) = sext(R(2), IMM(4)) < sext(R(3), IMM(4)); NEXT(5);
+L_LES: R(1) = sext(R(2), IMM(4)) <= sext(R(3), IMM(4)); NEXT(5);
+L_GTS: R(1) = sext(R(2), IMM(4)) > sext(R(3), IMM(4)); NEXT(5);
+L_GES: R(1) = sext(R(2), IMM(4)) >= sext(R(3), IMM(4)); NEXT(5);
+L_EQ: R(1) = R(2) == R(3); NEXT(4);
+L_NE: R(1) = R(2) != R(3); NEXT(4);
+
+L_AND: R(1) = R(2) & R(3); NEXT(4);
+L_OR: R(1) = R(2) | R(3); NEXT(4);
+L_XOR: R(1) = R(2) ^ R(3); NEXT(4);
+L_NOT: R(1) = ~R(2) & IMM(3); NEXT(4);
+
+L_SHL: R(1) = R(3) >= WORD_BITS ? 0 : (R(2) << R(3)) & IMM(4); NEXT(5);
+L_SHLI: R(1) = (R(2) << IMM(3)) & IMM(4); NEXT(5);
+L_SHRU: R(1) = R(3) >= WORD_BITS ? 0 : R(2) >> R(3); NEXT(4);
+L_SHRUI: R(1) = R(2) >> IMM(3); NEXT(4);
+L_SHRS: R(1) = (uint64_t)(sext(R(2), IMM(4)) >> (R(3) >= WORD_BITS ? WORD_BITS - 1 : R(3))) & IMM(5); NEXT(6);
+L_SHRSI: R(1) = (uint64_t)(sext(R(2), IMM(4)) >> IMM(3)) & IMM(5); NEXT(6);
+
+L_ANDR: R(1) = R(2) == IMM(3); NEXT(4);
+L_ORR: R(1) = R(2) != 0; NEXT(3);
+L_XORR: R(1) = __builtin_parityll(R(2)); NEXT(3);
+L_MUX: R(1) = R(2) ? R(3) : R(4); NEXT(5);
+
+L_JZ:
+  if (!R(1)) {
+    pc = pc[2].target;
+    goto *pc->op;
+  }
+  NEXT(3);
+L_JMP: pc = pc[1].target; goto *pc->op;
+L_LOOP:
+  if (++ R(1) < IMM(2)) {
+    pc = pc[3].target;
+    goto *pc->op;
+  }
+  NEXT(4);
+
+L_ACT: *pc[1].var |= IMM(2); NEXT(3);
+L_ACTC: *pc[2].var |= (0 - (uint64_t)(R(1) != 0)) & IMM(3); NEXT(4);
+L_ACTALL: std::fill(flags.begin(), flags.end(), 0xff); NEXT(1);
+L_ACTALLC: if (R(1)) std::fill(flags.begin(), flags.end(), 0xff); NEXT(2);
+
+L_PRINTF: interpPrintf(pc[1].str, pc + 3, IMM(2)); NEXT(3 + IMM(2));
+L_ASSERT: if (!R(1)) interpAssert(pc[2].str); NEXT(3);
+L_ASSERTC: if (R(2) && !R(1)) interpAssert(pc[3].str); NEXT(4);
+L_EXIT: if (R(1)) exit((int)IMM(2)); NEXT(3);
+
+L_CONSTW: for (uint64_t i = 0; i < IMM(2); i ++) P(1)[i] = pc[3 + i].imm; NEXT(3 + IMM(2));
+L_LOADW: memcpy(P(1), pc[2].var, IMM(3) * sizeof(uint64_t)); NEXT(4);
+L_LOADXW: memcpy(P(1), WIDE_AT(2, R(3), IMM(4)), IMM(4) * sizeof(uint64_t)); NEXT(5);
+L_STOREW: memcpy(pc[1].var, P(2), IMM(3) * sizeof(uint64_t)); NEXT(4);
+L_STOREXW: memcpy(WIDE_AT(1, R(2), IMM(4)), P(3), IMM(4) * sizeof(uint64_t)); NEXT(5);
+L_EXTW: extW(P(1), IMM(2), P(3), IMM(4), IMM(5)); NEXT(6);
+
+L_ADDW: addW(P(1), P(2), P(3), IMM(4)); NEXT(5);
+L_SUBW: subW(P(1), P(2), P(3), IMM(4)); NEXT(5);
+L_MULW: mulW(P(1), P(2), P(3), IMM(4)); NEXT(5);
+L_DIVW: divW(P(1), P(2), P(3), IMM(4), IMM(5), false); NEXT(6);
+L_REMW: divW(P(1), P(2), P(3), IMM(4), IMM(5), true); NEXT(6);
+L_CMPW: R(1) = cmpW(P(2), P(3), IMM(4), IMM(5)); NEXT(6);
+
+L_ANDW: for (int i = 0; i < wordNum(IMM(4)); i ++) P(1)[i] = P(2)[i] & P(3)[i]; NEXT(5);
+L_ORW: for (int i = 0; i < wordNum(IMM(4)); i ++) P(1)[i] = P(2)[i] | P(3)[i]; NEXT(5);
+L_XORW: for (int i = 0; i < wordNum(IMM(4)); i ++) P(1)[i] = P(2)[i] ^ P(3)[i]; NEXT(5);
+L_NOTW:
+  for (int i = 0; i < wordNum(IMM(3)); i ++) P(1)[i] = ~P(2)[i];
+  P(1)[wordNum(IMM(3)) - 1] &= topMask(IMM(3));
+  NEXT(4);
+L_SHLW: shlW(P(1), P(2), R(3), IMM(4)); NEXT(5);
+L_SHRW: shrW(P(1), P(2), R(3), IMM(4), IMM(5)); NEXT(6);
+
+L_ANDRW: R(1) = andrW(P(2), IMM(3)); NEXT(4);
+L_ORRW: R(1) = !isZeroW(P(2), wordNum(IMM(3))); NEXT(4);
+L_XORRW: R(1) = xorrW(P(2), IMM(3)); NEXT(4);
+L_MUXW: memcpy(P(1), R(2) ? P(3) : P(4), wordNum(IMM(5)) * sizeof(uint64_t)); NEXT(6);
+L_SATW: R(1) = isZeroW(P(2) + 1, IMM(3) - 1) ? P(2)[0] : ~0ull; NEXT(4);
+}
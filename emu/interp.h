@@ -0,0 +1,73 @@
+/*
+  GSimInterp: interpreter of the bytecode emitted by gsim --backend=interp (see include/bytecode.h)
+  The bytecode is translated into direct-threaded code when it is loaded, and step() follows the activation
+  scheme of the C++ model: one active flag per superNode, superNodes are evaluated in cppId order with their
+  flags cleared first, and resets are applied at the end of the cycle.
+  Compile emu/interp.cpp once with -I<gsim>/include, the [top].h emitted by gsim derives S[top] from GSimInterp.
+*/
+
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+union BCCell {
+  const void* op;
+  uint64_t* reg;
+  uint8_t* var;
+  uint64_t imm;
+  const char* str;
+  const BCCell* target;
+};
+
+class GSimInterp {
+public:
+  uint64_t cycles = 0;
+  GSimInterp(const char* path);
+  void init();
+  void step();
+  void setInput(int idx, const uint64_t* val);
+  void getOutput(int idx, uint64_t* val);
+
+private:
+  struct Activation {
+    uint32_t byte;
+    uint8_t mask;
+  };
+  struct Reset {
+    const uint8_t* cond;
+    uint32_t condSize;
+    const BCCell* entry;
+    bool activateAll;
+    std::vector<Activation> acts;
+  };
+  struct Port {
+    std::string name;
+    int width;
+    uint8_t* var;
+    std::vector<Activation> acts;
+    std::vector<uint64_t> cons;
+  };
+  std::vector<uint64_t> state;
+  std::vector<uint8_t> flags;
+  std::vector<uint64_t> regs;
+  std::vector<BCCell> cells;
+  std::vector<std::string> strs;
+  int superNum = 0;
+  std::vector<const BCCell*> superEntry;
+  const BCCell* initEntry = nullptr;
+  const BCCell* prologueEntry = nullptr;
+  std::vector<Reset> resets;
+  std::vector<Port> inputs;
+  std::vector<Port> outputs;
+  uint8_t* stateBase() { return (uint8_t*)state.data(); }
+  void activate(const std::vector<Activation>& acts);
+  void translate(const std::vector<uint32_t>& code, std::vector<size_t>& cellIdx);
+  void exec(const BCCell* pc);
+};
+
+#endif
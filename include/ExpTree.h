@@ -83,6 +83,7 @@ enum OPType {
 class ENode {
 private:
   static int counter;
+  friend class GraphArchive;
   valInfo* instsMux(Node* n, std::string lvalue, bool isRoot);
   valInfo* instsAdd(Node* n, std::string lvalue, bool isRoot);
   valInfo* instsSub(Node* n, std::string lvalue, bool isRoot);
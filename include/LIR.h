@@ -0,0 +1,145 @@
+/*
+  LIR: typed low-level instructions between instsGenerator and the backends
+  Every superNode is lowered into a function of three-address instructions over
+  numbered temporaries. Values are canonical: a temporary of width w holds the
+  low w bits of its value zero-extended, signedness only affects EXT, compares,
+  DIV/REM and SHR. Operands of ADD/SUB/MUL/DIV/REM/AND/OR/XOR/MUX have the
+  width of the result, operands of compares have the same width.
+  Only the llvm and interp backends are lowered from the LIR. The cpp backend still emits the strings built by
+  instsGenerator, so the semantics of every operation is implemented twice; the cpp backend never builds the LIR.
+*/
+
+#ifndef LIR_H
+#define LIR_H
+
+/* width of the temporaries indexing vars */
+#define LIR_IDX_WIDTH 32
+
+enum LIROp {
+  LIR_CONST,      // dst = cons
+  LIR_LOAD,       // dst = var[src0 + imm] (src0 = -1: var[imm])
+  LIR_STORE,      // var[src0 + imm] = src1
+  LIR_EXT,        // dst = src0 truncated or extended (signed if sign) to width
+  LIR_ADD,
+  LIR_SUB,
+  LIR_MUL,
+  LIR_DIV,        // x / 0 = 0
+  LIR_REM,        // x % 0 = 0
+  LIR_LT,
+  LIR_LEQ,
+  LIR_GT,
+  LIR_GEQ,
+  LIR_EQ,
+  LIR_NEQ,
+  LIR_AND,
+  LIR_OR,
+  LIR_XOR,
+  LIR_NOT,
+  LIR_SHL,        // dst = src0 << src1 (src1 = -1: imm), 0 if the amount is at least width
+  LIR_SHR,        // dst = src0 >> src1 (src1 = -1: imm), arithmetic if sign, any amount is allowed
+  LIR_ANDR,
+  LIR_ORR,
+  LIR_XORR,
+  LIR_MUX,        // dst = src0 ? src1 : src2
+  LIR_IF,         // if (src0) {
+  LIR_ELSE,       // } else {
+  LIR_ENDIF,      // }
+  LIR_LOOP,       // for (dst = 0; dst < imm; dst ++) {, imm is at least 1
+  LIR_ENDLOOP,    // }, src0 and imm are the dst and imm of its LOOP
+  LIR_ACTIVATE,   // activate superNodes ids if src0 (src0 = -1: unconditionally)
+  LIR_ACTIVATE_ALL,
+  LIR_PRINTF,     // print str with args
+  LIR_ASSERT,     // fail with str if src1 && !src0 (src1 = -1: always enabled)
+  LIR_EXIT,       // exit(imm) if src0
+  LIR_OP_NUM
+};
+
+class LIRVar {
+public:
+  std::string name;
+  int id;
+  int width;
+  bool sign;
+  int entryNum = 1;       // flattened entries, every dimension is padded to a power of 2
+  Node* node = nullptr;
+  LIRVar(std::string _name, int _id, int _width, bool _sign) : name(_name), id(_id), width(_width), sign(_sign) {}
+};
+
+class LIRInst {
+public:
+  LIROp op;
+  int dst = -1;
+  int src[3] = {-1, -1, -1};
+  int width = 0;
+  bool sign = false;
+  int64_t imm = 0;
+  LIRVar* var = nullptr;
+  std::vector<uint64_t> cons;   // little-endian words of LIR_CONST
+  std::vector<int> ids;         // superNodes of LIR_ACTIVATE
+  std::vector<int> args;        // arguments of LIR_PRINTF
+  std::string str;
+  LIRInst(LIROp _op) : op(_op) {}
+};
+
+class LIRFunc {
+public:
+  std::string name;
+  std::vector<LIRInst> insts;
+  std::vector<int> tmpWidth;
+  /* superNodes deduplicated by dedupLIR evaluate the body of proto, whose params are bound to args */
+  LIRFunc* proto = nullptr;
+  std::vector<LIRVar*> varArgs;
+  std::vector<int> idArgs;
+  /*
+    vars and activated superNodes of a shared body that differ in its members, other ones are accessed as usual
+    the varParams of every member lie at the same distances from its first one (see layoutInstances in dedupLIR)
+  */
+  std::vector<LIRVar*> varParams;
+  std::vector<int> idParams;
+  int newTmp(int width) {
+    tmpWidth.push_back(width);
+    return tmpWidth.size() - 1;
+  }
+};
+
+/* reset function called after every cycle if the reset variable is nonzero */
+class LIRReset {
+public:
+  LIRVar* cond;
+  bool activateAll = false;
+  std::vector<int> ids;
+  LIRFunc func;
+};
+
+class LIRPort {
+public:
+  std::string name;
+  int width;
+  LIRVar* var = nullptr;        // nullptr for constant outputs
+  std::vector<uint64_t> cons;
+  std::vector<int> ids;         // superNodes activated when an input changes
+};
+
+class LIRProgram {
+public:
+  std::string name;
+  std::vector<LIRVar*> vars;
+  std::map<std::string, LIRVar*> varMap;
+  int superNum = 0;
+  std::vector<LIRFunc*> supers;  // indexed by cppId, nullptr for unused ids
+  std::vector<LIRFunc*> shared;  // bodies shared by deduplicated superNodes
+  LIRFunc init;
+  LIRFunc prologue;              // evaluated before superNodes in every cycle
+  std::vector<LIRReset> resets;
+  std::vector<LIRPort> inputs;
+  std::vector<LIRPort> outputs;
+  std::string unsupported;       // the first construct that can not be lowered
+  LIRVar* getVar(std::string varName, int width, bool sign, int entryNum, Node* node);
+  size_t instNum();
+  LIRFunc* instantiate(LIRFunc* func);
+  void dump(FILE* fp);
+};
+
+const char* lirOpName(LIROp op);
+
+#endif
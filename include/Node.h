@@ -97,6 +97,7 @@ public:
 class Node {
   void finalConnect(std::string lvalue, valInfo* info);
   static int counter;
+  friend class GraphArchive;
  public:
 
   Node(NodeType _type = NODE_OTHERS) {
@@ -328,6 +329,8 @@ class Node {
   void updateIsRoot();
   void updateHeadTail();
   bool isLocal();
+  bool isSparseMemory();
+  bool isAddrTracked();
 };
 
 enum SuperType {
@@ -369,6 +372,7 @@ public:
 class SuperNode {
 private:
   static int counter;  // initialize to 1
+  friend class GraphArchive;
 public:
   std::string name;
   /* adjacent superNodes */
@@ -386,6 +390,12 @@ public:
   SuperType superType = SUPER_VALID;
   Node* resetNode = nullptr;
   int localTmpNum = 0;
+  /* multi-thread evaluation */
+  int threadId = 0;
+  int epoch = 0;
+  /* work-stealing evaluation: successors and number of predecessors in the task graph */
+  std::vector<SuperNode*> taskNext;
+  int taskDepNum = 0;
   SuperNode() {
     id = counter ++;
   }
@@ -0,0 +1,81 @@
+/*
+  bytecode of the interpreter backend (--backend=interp), shared by interpEmitter and the runtime in emu/interp.cpp
+  Instructions are 32-bit words: an opcode followed by the operands listed in its signature.
+  Registers hold values of at most 64 bits in one 64-bit slot and wider values in consecutive slots, zero-extended
+  to the width as the temporaries of LIR. Opcodes ending with W operate on values wider than 64 bits.
+*/
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+
+#define BC_MAGIC 0x43425347   // "GSBC"
+#define BC_VERSION 2
+#define BC_NONE 0xffffffff
+
+/*
+  operand kinds of signatures:
+  R register slot, V byte offset of a variable, W 64-bit immediate (2 words), I 32-bit immediate,
+  M width converted to the mask of the width, S width converted to the shift of sign extension (64 - width),
+  T target of jumps (word offset in code), F byte of active flags, X string index,
+  N number of registers followed by the registers, C number of 64-bit words followed by the words
+*/
+#define BC_OPS(_) \
+  _(RET, "") \
+  _(CONST, "RW") \
+  _(LOAD1, "RV") _(LOAD2, "RV") _(LOAD4, "RV") _(LOAD8, "RV") \
+  _(LOADX1, "RVR") _(LOADX2, "RVR") _(LOADX4, "RVR") _(LOADX8, "RVR") \
+  _(STORE1, "VR") _(STORE2, "VR") _(STORE4, "VR") _(STORE8, "VR") \
+  _(STOREX1, "VRR") _(STOREX2, "VRR") _(STOREX4, "VRR") _(STOREX8, "VRR") \
+  _(MASK, "RRM") _(SEXT, "RRSM") \
+  _(ADD, "RRRM") _(SUB, "RRRM") _(MUL, "RRRM") \
+  _(DIVU, "RRR") _(REMU, "RRR") _(DIVS, "RRRSM") _(REMS, "RRRSM") \
+  _(LTU, "RRR") _(LEU, "RRR") _(GTU, "RRR") _(GEU, "RRR") \
+  _(LTS, "RRRS") _(LES, "RRRS") _(GTS, "RRRS") _(GES, "RRRS") \
+  _(EQ, "RRR") _(NE, "RRR") \
+  _(AND, "RRR") _(OR, "RRR") _(XOR, "RRR") _(NOT, "RRM") \
+  _(SHL, "RRRM") _(SHLI, "RRIM") _(SHRU, "RRR") _(SHRUI, "RRI") _(SHRS, "RRRSM") _(SHRSI, "RRISM") \
+  _(ANDR, "RRM") _(ORR, "RR") _(XORR, "RR") \
+  _(MUX, "RRRR") \
+  _(JZ, "RT") _(JMP, "T") _(LOOP, "RIT") \
+  _(ACT, "FI") _(ACTC, "RFI") _(ACTALL, "") _(ACTALLC, "R") \
+  _(PRINTF, "XN") _(ASSERT, "RX") _(ASSERTC, "RRX") _(EXIT, "RI") \
+  _(CONSTW, "RC") \
+  _(LOADW, "RVI") _(LOADXW, "RVRI") _(STOREW, "VRI") _(STOREXW, "VRRI") \
+  _(EXTW, "RIRII") \
+  _(ADDW, "RRRI") _(SUBW, "RRRI") _(MULW, "RRRI") _(DIVW, "RRRII") _(REMW, "RRRII") \
+  _(CMPW, "RRRII") \
+  _(ANDW, "RRRI") _(ORW, "RRRI") _(XORW, "RRRI") _(NOTW, "RRI") \
+  _(SHLW, "RRRI") _(SHRW, "RRRII") \
+  _(ANDRW, "RRI") _(ORRW, "RRI") _(XORRW, "RRI") \
+  _(MUXW, "RRRRI") \
+  _(SATW, "RRI")
+
+#define BC_ENUM(name, sig) BC_##name,
+enum BCOp { BC_OPS(BC_ENUM) BC_OP_NUM };
+#undef BC_ENUM
+
+#define BC_SIG(name, sig) sig,
+static const char* const bcOpSig[] = { BC_OPS(BC_SIG) };
+#undef BC_SIG
+
+/* LOOP increments R and jumps to T if R < I */
+
+/* the last immediate of CMPW */
+enum BCCmp { BC_CMP_LT, BC_CMP_LEQ, BC_CMP_GT, BC_CMP_GEQ, BC_CMP_EQ, BC_CMP_NEQ };
+#define BC_CMP_SIGN 8
+
+/*
+  file layout, all fields are 32-bit words unless noted, strings are a length followed by the padded bytes:
+  magic, version, stateSize, flagNum, regNum, superNum
+  codeSize, code[codeSize]
+  strNum, str[strNum]
+  entry[superNum] (BC_NONE for unused superNodes), init entry, prologue entry
+  resetNum, { cond offset, cond size, entry, activateAll, actNum, { flag byte, mask }[actNum] }[resetNum]
+  inputNum, { name, width, offset, actNum, { flag byte, mask }[actNum] }[inputNum]
+  outputNum, { name, width, offset (BC_NONE for constants), consNum, 64-bit cons[consNum] }[outputNum]
+  variables of at most 64 bits occupy 1/2/4/8 bytes, wider ones 8 bytes per 64 bits
+*/
+
+#endif
@@ -124,6 +124,8 @@ std::string arrayMemberName(Node* node, std::string suffix);
 #define oldName(node) (node->name + "$old$" + std::to_string(node->id))
 #define ASSIGN_LABLE std::string("ASSIGN$$$LABEL")
 #define ASSIGN_INDI(node) (node->name + "$$UPDATE")
+#define MEM_ADDR(port) (port->name + "$$ADDR")
+#define RESET_NAME(node) (node->name + "$RESET")
 #define ASSIGN_BEG(node) (node ? (node->name + std::to_string(node->id) + "$$BEG ") : "")
 #define ASSIGN_END(node) (node ? (node->name + std::to_string(node->id) + "$$END ") : "")
 
@@ -133,10 +135,13 @@ std::string arrayMemberName(Node* node, std::string suffix);
 #include "PNode.h"
 #include "ExpTree.h"
 #include "StmtTree.h"
+#include "LIR.h"
 #include "graph.h"
 #include "util.h"
 #include "valInfo.h"
 #include "perf.h"
+#include "report.h"
+#include "profile.h"
 #include "config.h"
 
 #define TIMER_START(name) struct timeval CONCAT(__timer_, name) = getTime();
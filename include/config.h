@@ -8,6 +8,24 @@ struct Config {
   uint32_t cppMaxSizeKB;
   std::string sep_module;
   std::string sep_aggr;
+  int threadNum;
+  bool workSteal;
+  bool repcut;
+  int batchLanes;
+  bool trace;
+  bool dispatch;
+  int sparseMemKB;
+  bool dumpLIR;
+  std::string backend;
+  bool dedup;
+  bool reroll;
+  std::string graphCacheDir;
+  std::string resumeFrom;
+  std::string reportFile;
+  int costProfile;
+  bool srcMap;
+  std::string profileFile;
+  double alwaysActiveRate;
   Config();
 };
 
@@ -9,26 +9,37 @@ class graph {
   FILE *srcFp;
   int srcFileIdx;
   int srcFileBytes;
+  int srcFileLine;
 
   bool __emitSrc(int indent, bool canNewFile, bool alreadyEndFunc, const char *nextFuncDef, const char *fmt, ...);
   void emitPrintf();
   void activateNext(Node* node, std::set<int>& nextNodeId, std::string oldName, bool inStep, std::string flagName, int indent);
   void activateUncondNext(Node* node, std::set<int>activateId, bool inStep, std::string flagName, int indent);
+  void activateReaders(Node* writer, std::string flagName, int indent);
 
   FILE* genHeaderStart();
   void genNodeDef(FILE* fp, Node* node);
   void genNodeInsts(Node* node, std::string flagName, int indent);
+  int laneLoopBegin(int indent);
+  int laneLoopEnd(int indent);
   void genInterfaceInput(Node* input);
   void genInterfaceOutput(Node* output);
-  void genStep(int subStepIdxMax);
+  void genStep(std::vector<int>& subStepIdxMax);
+  void genThreadRuntime(std::vector<int>& subStepIdxMax);
+  void genTaskRuntime(FILE* header);
+  void genCheckpoint(FILE* header);
+  void genTraceRuntime(FILE* header);
+  void genCostProfile(FILE* header);
+  void genSrcMap();
   void genHeaderEnd(FILE* fp);
   int genNodeStepStart(SuperNode* node, uint64_t mask, int idx, std::string flagName, int indent);
-  int genNodeStepEnd(SuperNode* node, int indent);
+  int genNodeStepEnd(SuperNode* node, int indent, bool tested = true);
   void genNodeInit(Node* node, int mode);
   void genMemInit(Node* node);
   void nodeDisplay(Node* member, int indent);
   void genMemRead(FILE* fp);
-  int genActivate();
+  int genActivate(int tid);
+  void genDispatch(FILE* header);
   void genUpdateRegister(FILE* fp);
   void genMemWrite(FILE* fp);
   void saveDiffRegs();
@@ -59,6 +70,7 @@ class graph {
   void removeDeadReg();
   void graphCoarsen();
   void graphInitPartition();
+  void profilePartition(std::set<int>& cut);
   void graphRefine();
   void resort();
   void detectSortedSuperLoop();
@@ -80,7 +92,10 @@ class graph {
   std::set<Node*> splittedArray;
   std::vector<std::string> extDecl;
   std::string name;
+  /* the module of every instance, by the prefix of its signals */
+  std::map<std::string, std::string> instanceModule;
   int nodeNum = 0;
+  LIRProgram* lir = nullptr;
   void addReg(Node* reg) {
     regsrc.push_back(reg);
   }
@@ -117,6 +132,14 @@ class graph {
   void depthPerf();
   void generateStmtTree();
   void connectDep();
+  void threadPartition();
+  void orderDepend(std::map<SuperNode*, std::set<SuperNode*>>& depend);
+  void repcutPartition();
+  void genLIR();
+  void rerollLIR();
+  void dedupLIR();
+  void llvmEmitter();
+  void interpEmitter();
 };
 
 #endif
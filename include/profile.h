@@ -0,0 +1,25 @@
+/*
+  activity profile read by --profile: the table written by costDump() of a model built with --cost-profile,
+  or the activity file of the emulator of a PERF build, which record the evaluations of every superNode
+  and how many of them activated other superNodes
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+class NodeActivity {
+public:
+  int group;        // cppId of the superNode in the profiled model
+  uint64_t calls;   // evaluations
+  uint64_t valid;   // evaluations that activated any superNode
+  double rate() { return (double)calls / MAX(profileCycles(), 1); }
+  double validRatio() { return calls == 0 ? 1.0 : (double)valid / calls; }
+  static uint64_t profileCycles();
+};
+
+void loadProfile(std::string fileName);
+bool hasProfile();
+/* NULL if the node is not in the profile */
+NodeActivity* nodeActivity(Node* node);
+
+#endif
@@ -0,0 +1,22 @@
+/*
+  report of the compile cost: time, memory and graph size after every pass, written by --report
+*/
+
+#ifndef REPORT_H
+#define REPORT_H
+
+class PassReport {
+  std::string name;
+  struct timeval wallStart;
+  uint64_t cpuStart;
+  uint64_t rssStart;
+public:
+  PassReport(const char* _name);
+  void end(graph* g);
+};
+
+/* print a statistic line of a pass, which is also recorded in the report of the pass */
+void printStat(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+void writeReport();
+
+#endif
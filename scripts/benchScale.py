@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Run GSIM over synthetic circuits of growing sizes and report how the time and memory of every pass scale.
+# Circuits are generated by genFIR.py, the sizes are the numbers of instances in the top module; the options
+# not recognized here are passed to genFIR.py. Every run writes its --report, and the growth of every pass is
+# fitted as time ~ nodes^k, passes with k above --superlinear are flagged.
+
+import argparse
+import csv
+import json
+import math
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+def run(cmd, log, timeout):
+    with open(log, "w") as f:
+        start = time.time()
+        try:
+            ret = subprocess.run(cmd, stdout=f, stderr=subprocess.STDOUT, timeout=timeout).returncode
+        except subprocess.TimeoutExpired:
+            ret = "timeout"
+        return ret, time.time() - start
+
+# least squares slope of log(y) on log(x)
+def growth(xs, ys):
+    points = [(math.log(x), math.log(y)) for x, y in zip(xs, ys) if x > 0 and y > 0]
+    if len(points) < 2:
+        return None
+    mx = sum(p[0] for p in points) / len(points)
+    my = sum(p[1] for p in points) / len(points)
+    var = sum((p[0] - mx) ** 2 for p in points)
+    if var == 0:
+        return None
+    return sum((p[0] - mx) * (p[1] - my) for p in points) / var
+
+def main():
+    parser = argparse.ArgumentParser(description="Scaling benchmark of the passes of GSIM", epilog="other options are passed to genFIR.py")
+    parser.add_argument("--gsim", default="build/gsim/gsim", help="gsim binary")
+    parser.add_argument("--gsim-flags", default="", help="extra options of gsim")
+    parser.add_argument("--sizes", default="1,2,4,8,16", help="instances in the top module of every run")
+    parser.add_argument("--out", default="build/bench-scale", help="output directory")
+    parser.add_argument("--timeout", type=int, default=3600, help="seconds per run")
+    parser.add_argument("--min-ms", type=float, default=10, help="passes faster than this in all runs are not fitted")
+    parser.add_argument("--superlinear", type=float, default=1.3, help="growth exponent above which a pass is flagged")
+    args, genArgs = parser.parse_known_args()
+
+    out = Path(args.out)
+    sizes = [int(x) for x in args.sizes.split(",")]
+    genFIR = Path(__file__).resolve().parent / "genFIR.py"
+    runs = []
+    for size in sizes:
+        work = out / ("size%d" % size)
+        (work / "model").mkdir(parents=True, exist_ok=True)
+        fir = work / "Top.fir"
+        subprocess.run([sys.executable, str(genFIR), "--top-instances", str(size), "-o", str(fir)] + genArgs, check=True)
+        report = work / "report.json"
+        cmd = [args.gsim, "--dir=%s" % (work / "model"), "--report=%s" % report] + args.gsim_flags.split() + [str(fir)]
+        ret, seconds = run(cmd, work / "gsim.log", args.timeout)
+        if ret != 0:
+            print("size %d: gsim failed (%s) after %.1fs, see %s" % (size, ret, seconds, work / "gsim.log"))
+            break
+        data = json.load(open(report))
+        # the size of a run is the number of nodes when the graph is first sorted
+        nodes = next((p["nodes"] for p in data["passes"] if "nodes" in p), 0)
+        # repeated passes are told apart by their occurrence
+        seen = {}
+        passes = {}
+        for p in data["passes"]:
+            seen[p["name"]] = seen.get(p["name"], 0) + 1
+            name = p["name"] if seen[p["name"]] == 1 else "%s#%d" % (p["name"], seen[p["name"]])
+            passes[name] = p
+        runs.append({"size": size, "nodes": nodes, "wallMs": data["wallMs"], "peakRssKB": data["peakRssKB"], "passes": passes})
+        print("size %d: %d nodes, %.1f s, peak RSS %.1f MB" % (size, nodes, data["wallMs"] / 1000, data["peakRssKB"] / 1024))
+    if not runs:
+        return 1
+
+    names = list(runs[-1]["passes"].keys())
+    xs = [r["nodes"] for r in runs]
+    rows = []
+    for name in names:
+        times = [r["passes"][name]["wallMs"] if name in r["passes"] else 0 for r in runs]
+        rss = [r["passes"][name]["rssDeltaKB"] if name in r["passes"] else 0 for r in runs]
+        k = growth(xs, times) if max(times) >= args.min_ms else None
+        rows.append({"pass": name, "timeMs": times, "rssDeltaKB": rss, "growth": k})
+    # the total has no change of memory, but the peak of every run
+    rows.append({"pass": "total", "timeMs": [r["wallMs"] for r in runs], "peakRssKB": [r["peakRssKB"] for r in runs], "growth": growth(xs, [r["wallMs"] for r in runs])})
+
+    with open(out / "scaling.csv", "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["pass", "growth"] + ["ms@%d" % x for x in xs] + ["rssDeltaKB@%d" % x for x in xs] + ["peakRssKB@%d" % x for x in xs])
+        for row in rows:
+            empty = [""] * len(xs)
+            writer.writerow([row["pass"], "" if row["growth"] is None else "%.2f" % row["growth"]] + ["%.1f" % t for t in row["timeMs"]] +
+                            row.get("rssDeltaKB", empty) + row.get("peakRssKB", empty))
+    with open(out / "scaling.json", "w") as f:
+        json.dump({"nodes": xs, "sizes": [r["size"] for r in runs], "peakRssKB": [r["peakRssKB"] for r in runs], "passes": rows}, f, indent=2)
+
+    width = max(len(row["pass"]) for row in rows)
+    print("%-*s %6s %s" % (width, "pass", "growth", " ".join("%10s" % ("%dn" % x) for x in xs)))
+    for row in rows:
+        k = row["growth"]
+        flag = "  <- superlinear" if k is not None and k > args.superlinear else ""
+        print("%-*s %6s %s%s" % (width, row["pass"], "-" if k is None else "%.2f" % k, " ".join("%8.0fms" % t for t in row["timeMs"]), flag))
+    print("results in %s and %s" % (out / "scaling.csv", out / "scaling.json"))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,5 +1,10 @@
 #!/usr/bin/env python3
 
+import argparse
+import bisect
+import json
+import re
+import sys
 from pathlib import Path
 
 llc_slice_size = 96*1024*1024/16 # Configured for Zen4-X3D
@@ -88,7 +93,153 @@ def extract_result_multicopy_to_csv(result_dir: Path):
         res[key] = f"{best_l3_0_cache_unit * llc_slice_size / 1024 / 1024} MB"
     return "\n".join(f"{key[0]}-{key[1]}copy,{res[key]}" for key in res)
 
+# Attribution of the simulation cost to the module hierarchy by the source map of gsim --srcmap.
+# The cost of every superNode comes from the PERF activity (activeTimes, weighted by the members), the
+# table of --cost-profile (ticks) or perf samples by source line of the emitted model, and is split among
+# the instances and FIRRTL lines of its members in proportion to the members.
+
+def load_srcmap(path: Path):
+    with open(path, "r") as file:
+        srcmap = json.load(file)
+    srcmap["memberNum"] = {sup["id"]: sum(m[2] for m in sup["members"]) for sup in srcmap["superNodes"]}
+    return srcmap
+
+def perf_active_cost(path: Path, srcmap):
+    cost = dict()
+    with open(path, "r") as file:
+        for line in file.readlines():
+            if line.startswith("totalActives"):
+                cost = dict()  # only the last report counts
+            match = re.match(r"(\d+): activeTimes (\d+)", line)
+            if match:
+                id = int(match.group(1))
+                cost[id] = int(match.group(2)) * srcmap["memberNum"].get(id, 0)
+    return cost
+
+def cost_profile_cost(path: Path, srcmap):
+    cost = dict()
+    with open(path, "r") as file:
+        for line in file.readlines():
+            if line.startswith("#") or len(line.split()) < 4:
+                continue
+            id, calls, valid, ticks = line.split()[:4]
+            cost[int(id)] = int(ticks)
+    return cost
+
+# the output of `perf report --stdio --no-children --sort srcline` on a model compiled with -g
+def perf_srcline_cost(path: Path, srcmap):
+    ranges = dict()  # file -> sorted [(first, last, id)]
+    for sup in srcmap["superNodes"]:
+        for file, first, last in sup["lines"]:
+            ranges.setdefault(srcmap["files"][file], []).append((first, last, sup["id"]))
+    for file in ranges:
+        ranges[file].sort()
+    cost = dict()
+    with open(path, "r") as file:
+        for line in file.readlines():
+            match = re.match(r"\s*([\d.]+)%\s+(\S+):(\d+)", line)
+            if not match:
+                continue
+            name, lineno, percent = Path(match.group(2)).name, int(match.group(3)), float(match.group(1))
+            id = -1  # outside superNodes, e.g. activation, registers and memories
+            # the innermost range containing the line, ranges of superNodes do not overlap
+            candidates = ranges.get(name, [])
+            idx = bisect.bisect_right(candidates, (lineno, float("inf"), 0)) - 1
+            if idx >= 0 and candidates[idx][0] <= lineno <= candidates[idx][1]:
+                id = candidates[idx][2]
+            cost[id] = cost.get(id, 0) + percent
+    return cost
+
+# parents of an instance are its prefixes separated by sepModule (but not sepAggr) which are instances
+def instance_parent(inst, srcmap):
+    sep_module, sep_aggr = srcmap["sepModule"], srcmap["sepAggr"]
+    parent = ""
+    pos = inst.find(sep_module)
+    while pos != -1:
+        if inst.startswith(sep_aggr, pos):
+            pos = inst.find(sep_module, pos + len(sep_aggr))
+            continue
+        if inst[:pos] in srcmap["instances"]:
+            parent = inst[:pos]
+        pos = inst.find(sep_module, pos + len(sep_module))
+    return parent
+
+def aggregate_by_hierarchy(srcmap, cost):
+    self_cost = dict()
+    line_cost = dict()
+    for sup in srcmap["superNodes"]:
+        total = srcmap["memberNum"][sup["id"]]
+        if sup["id"] not in cost or total == 0:
+            continue
+        for inst, lineno, num in sup["members"]:
+            share = cost[sup["id"]] * num / total
+            self_cost[inst] = self_cost.get(inst, 0) + share
+            key = (srcmap["instances"].get(inst, srcmap["top"]), lineno)
+            line_cost[key] = line_cost.get(key, 0) + share
+    incl_cost = dict()
+    for inst, value in self_cost.items():
+        while True:
+            incl_cost[inst] = incl_cost.get(inst, 0) + value
+            if inst == "":
+                break
+            inst = instance_parent(inst, srcmap)
+    module_cost = dict()
+    for inst, value in self_cost.items():
+        module = srcmap["instances"].get(inst, srcmap["top"])
+        module_cost[module] = module_cost.get(module, 0) + value
+    return self_cost, incl_cost, module_cost, line_cost
+
+def hierarchy_report(srcmap, cost, depth, top):
+    self_cost, incl_cost, module_cost, line_cost = aggregate_by_hierarchy(srcmap, cost)
+    total = sum(cost.values())
+    if total == 0:
+        return "no cost\n"
+    def level(inst):
+        n = 0
+        while inst != "":
+            inst = instance_parent(inst, srcmap)
+            n += 1
+        return n
+    buf = ""
+    if -1 in cost:
+        buf += "%.2f%% outside superNodes\n\n" % (100 * cost[-1] / total)
+    buf += "%8s %8s  %s\n" % ("incl", "self", "instance (module)")
+    rows = [inst for inst in incl_cost if level(inst) <= depth]
+    for inst in sorted(rows, key=lambda x: -incl_cost[x])[:top]:
+        module = srcmap["instances"].get(inst, srcmap["top"])
+        buf += "%7.2f%% %7.2f%%  %s%s (%s)\n" % (100 * incl_cost[inst] / total, 100 * self_cost.get(inst, 0) / total,
+                                                  "  " * level(inst), inst if inst else "<top>", module)
+    buf += "\n%8s  %s\n" % ("self", "module (all instances)")
+    for module in sorted(module_cost, key=lambda x: -module_cost[x])[:top]:
+        buf += "%7.2f%%  %s\n" % (100 * module_cost[module] / total, module)
+    buf += "\n%8s  %s\n" % ("self", "module:line of the FIRRTL input")
+    for module, lineno in sorted(line_cost, key=lambda x: -line_cost[x])[:top]:
+        buf += "%7.2f%%  %s:%d\n" % (100 * line_cost[(module, lineno)] / total, module, lineno)
+    return buf
+
+def hierarchy_main(argv):
+    parser = argparse.ArgumentParser(description="Attribute the simulation cost to the module hierarchy")
+    parser.add_argument("srcmap", help="[dir]/[top].srcmap.json written by gsim --srcmap")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--active", help="activity of a PERF build, e.g. logs/active-[dut].txt")
+    source.add_argument("--cost", help="table of a --cost-profile build, e.g. cost-profile.txt")
+    source.add_argument("--perf", help="output of `perf report --stdio --no-children --sort srcline`")
+    parser.add_argument("--depth", type=int, default=3, help="levels of instances shown")
+    parser.add_argument("--top", type=int, default=30, help="rows per table")
+    args = parser.parse_args(argv)
+    srcmap = load_srcmap(Path(args.srcmap))
+    if args.active:
+        cost = perf_active_cost(Path(args.active), srcmap)
+    elif args.cost:
+        cost = cost_profile_cost(Path(args.cost), srcmap)
+    else:
+        cost = perf_srcline_cost(Path(args.perf), srcmap)
+    print(hierarchy_report(srcmap, cost, args.depth, args.top), end="")
+
 if __name__ == "__main__":
+    if len(sys.argv) > 1:
+        hierarchy_main(sys.argv[1:])
+        sys.exit(0)
     with open(Path("result-multicopy").resolve() / "result-multicopy.csv", "w") as file:
         file.write(extract_result_multicopy_to_csv(Path("result-multicopy").resolve()))
     with open(Path("result").resolve() / "result.csv", "w") as file:
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+# Generate a synthetic FIRRTL circuit for benchmarking the passes of GSIM.
+# The top module instantiates a hierarchy of `depth` levels with `fanout` instances per module; the leaves
+# are `modules` different random modules with registers, memories, combinational nodes and nested whens.
+
+import argparse
+import random
+
+class Leaf:
+    def __init__(self, name, args, rng):
+        self.name = name
+        self.args = args
+        self.rng = rng
+        self.lines = []
+        self.pool = []  # (expression, width)
+        self.nodeNum = 0
+
+    def emit(self, line, indent=2):
+        self.lines.append("  " * indent + line)
+
+    def width(self):
+        return self.rng.choice(self.args.widths)
+
+    def fit(self, value, width):
+        expr, w = value
+        if w > width:
+            return "bits(%s, %d, 0)" % (expr, width - 1)
+        if w < width:
+            return "pad(%s, %d)" % (expr, width)
+        return expr
+
+    # operands are mostly recent values, so that the logic has locality like real designs
+    def pick(self):
+        if self.rng.random() < 0.7:
+            return self.rng.choice(self.pool[-16:])
+        return self.rng.choice(self.pool)
+
+    def cond(self):
+        expr, w = self.pick()
+        bit = self.rng.randrange(w)
+        return "bits(%s, %d, %d)" % (expr, bit, bit)
+
+    def node(self):
+        a, b = self.pick(), self.pick()
+        w = max(a[1], b[1])
+        op = self.rng.choice(["add", "sub", "xor", "and", "or", "mux", "eq", "lt", "cat", "shl", "shr", "not", "mul"])
+        if op in ("add", "sub"):
+            expr, ew = "%s(%s, %s)" % (op, a[0], b[0]), w + 1
+        elif op in ("xor", "and", "or"):
+            expr, ew = "%s(%s, %s)" % (op, a[0], b[0]), w
+        elif op == "mux":
+            expr, ew = "mux(%s, %s, %s)" % (self.cond(), a[0], b[0]), w
+        elif op in ("eq", "lt"):
+            expr, ew = "%s(%s, %s)" % (op, a[0], b[0]), 1
+        elif op == "cat" and a[1] + b[1] <= 128:
+            expr, ew = "cat(%s, %s)" % (a[0], b[0]), a[1] + b[1]
+        elif op == "shl" and a[1] < 120:
+            n = self.rng.randrange(1, 8)
+            expr, ew = "shl(%s, %d)" % (a[0], n), a[1] + n
+        elif op == "shr" and a[1] > 1:
+            n = self.rng.randrange(1, a[1])
+            expr, ew = "shr(%s, %d)" % (a[0], n), a[1] - n
+        elif op == "mul" and a[1] + b[1] <= 64:
+            expr, ew = "mul(%s, %s)" % (a[0], b[0]), a[1] + b[1]
+        else:
+            expr, ew = "not(%s)" % a[0], a[1]
+        width = self.width()
+        name = "n%d" % self.nodeNum
+        self.nodeNum += 1
+        self.emit("node %s = %s" % (name, self.fit((expr, ew), width)))
+        self.pool.append((name, width))
+
+    # connect the targets in nested whens, every level overrides a part of the connections of its parent
+    def whens(self, targets, depth, indent):
+        for name, width in targets:
+            self.emit("connect %s, %s" % (name, self.fit(self.pick(), width)), indent)
+        if depth == 0 or len(targets) < 2:
+            return
+        self.emit("when %s :" % self.cond(), indent)
+        self.whens(targets[: len(targets) // 2], depth - 1, indent + 1)
+        self.emit("else :", indent)
+        self.whens(targets[len(targets) // 2 :], depth - 1, indent + 1)
+
+    def generate(self):
+        args = self.args
+        self.emit("module %s :" % self.name, 1)
+        self.emit("input clock : Clock")
+        self.emit("input reset : UInt<1>")
+        self.emit("input io_in : UInt<64>")
+        self.emit("output io_out : UInt<64>")
+        self.emit("")
+        for lo in range(0, 64, 16):
+            self.pool.append(("bits(io_in, %d, %d)" % (lo + 15, lo), 16))
+        regs = []
+        for i in range(args.regs):
+            width = self.width()
+            if i % 2 == 0:
+                self.emit("regreset r%d : UInt<%d>, clock, reset, UInt<%d>(0h0)" % (i, width, width))
+            else:
+                self.emit("reg r%d : UInt<%d>, clock" % (i, width))
+            regs.append(("r%d" % i, width))
+        self.pool.extend(regs)
+        mems = []
+        for i in range(args.mems):
+            width = self.width()
+            self.emit("cmem m%d : UInt<%d>[%d]" % (i, width, 1 << args.mem_addr))
+            self.emit("read mport rd%d = m%d[%s], clock" % (i, i, self.fit(self.pick(), args.mem_addr)))
+            self.pool.append(("rd%d" % i, width))
+            mems.append(("m%d" % i, width))
+        for i in range(args.nodes):
+            self.node()
+        for i, (mem, width) in enumerate(mems):
+            self.emit("when %s :" % self.cond())
+            self.emit("write mport wr%d = %s[%s], clock" % (i, mem, self.fit(self.pick(), args.mem_addr)), 3)
+            self.emit("connect wr%d, %s" % (i, self.fit(self.pick(), width)), 3)
+        self.whens(regs, args.when_depth, 2)
+        out = self.fit(self.pool[-1], 64)
+        for value in self.pool[-8:-1]:
+            out = "xor(%s, %s)" % (out, self.fit(value, 64))
+        self.emit("connect io_out, %s" % out)
+        self.emit("")
+        return self.lines
+
+# a module of the hierarchy: chained instances of its children, each also sees the input of the module
+def hierModule(name, children, lines):
+    lines.append("  module %s :" % name)
+    lines.append("    input clock : Clock")
+    lines.append("    input reset : UInt<1>")
+    lines.append("    input io_in : UInt<64>")
+    lines.append("    output io_out : UInt<64>")
+    lines.append("")
+    prev = "io_in"
+    for i, child in enumerate(children):
+        lines.append("    inst u%d of %s" % (i, child))
+        lines.append("    connect u%d.clock, clock" % i)
+        lines.append("    connect u%d.reset, reset" % i)
+        lines.append("    connect u%d.io_in, xor(%s, io_in)" % (i, prev))
+        prev = "u%d.io_out" % i
+    out = "u0.io_out"
+    for i in range(1, len(children)):
+        out = "xor(%s, u%d.io_out)" % (out, i)
+    lines.append("    connect io_out, %s" % out)
+    lines.append("")
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a synthetic FIRRTL circuit")
+    parser.add_argument("--modules", type=int, default=4, help="number of different leaf modules")
+    parser.add_argument("--depth", type=int, default=2, help="levels of instances below the top module")
+    parser.add_argument("--fanout", type=int, default=4, help="instances in every non-leaf module")
+    parser.add_argument("--top-instances", type=int, default=1, help="instances of the hierarchy in the top module, which scales the circuit linearly")
+    parser.add_argument("--regs", type=int, default=16, help="registers per leaf module")
+    parser.add_argument("--nodes", type=int, default=64, help="combinational nodes per leaf module")
+    parser.add_argument("--mems", type=int, default=1, help="memories per leaf module")
+    parser.add_argument("--mem-addr", type=int, default=4, help="address width of memories")
+    parser.add_argument("--widths", type=lambda s: [int(x) for x in s.split(",")], default=[1, 8, 16, 32, 64], help="widths of values, e.g. 1,8,16,32,64,128")
+    parser.add_argument("--when-depth", type=int, default=2, help="nesting of whens around register updates")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("-o", "--output", default="-", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    lines = ["FIRRTL version 3.3.0", "circuit Top :"]
+    leaves = ["Leaf%d" % i for i in range(args.modules)]
+    for name in leaves:
+        lines.extend(Leaf(name, args, rng).generate())
+    children = [leaves[i % len(leaves)] for i in range(args.fanout)]
+    for level in range(args.depth - 1, 0, -1):
+        name = "Level%d" % level
+        hierModule(name, children, lines)
+        children = [name] * args.fanout
+    if args.depth > 1:
+        children = [children[0]] * args.top_instances
+    else:
+        children = [leaves[i % len(leaves)] for i in range(args.top_instances)]
+    hierModule("Top", children, lines)
+    text = "\n".join(lines) + "\n"
+    if args.output == "-":
+        print(text, end="")
+    else:
+        with open(args.output, "w") as f:
+            f.write(text)
+
+if __name__ == "__main__":
+    main()
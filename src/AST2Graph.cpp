@@ -1108,6 +1108,7 @@ void visitInst(graph* g, PNode* inst) {
   PNode* module = moduleMap[inst->getExtra(0)];
   prefix_append(SEP_MODULE, inst->name);
   moduleInstances.insert(topPrefix());
+  g->instanceModule[topPrefix()] = module->name;
   switch(module->type) {
     case P_MOD: visitModule(g, module); break;
     case P_EXTMOD: visitExtModule(g, module); break;
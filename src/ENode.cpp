@@ -42,7 +42,7 @@ void ENode::usedBitWithFixRoot(int rootWidth) {
       childBits.push_back(rootWidth);
       break;
     case OP_SHL:
-      childBits.push_back(MAX(0, rootWidth - values[0]));
+      childBits.push_back(MAX(1, rootWidth - values[0]));
       break;
     case OP_SHR:
       childBits.push_back(rootWidth + values[0]);
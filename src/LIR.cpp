@@ -0,0 +1,981 @@
+/*
+  genLIR: lower the stmtTrees of superNodes into LIR (see LIR.h), the input of backends other than cppEmitter
+  Expressions follow the FIRRTL semantics of every ENode: results are truncated to the width of the ENode and
+  leaves are resized to it. Sub-arrays are assigned element by element, the element index is passed
+  down to leaves, GROUP and operands, but not to conditions, indexes and addresses.
+  Activation follows genSuperEval, except that writers activate all their readers.
+*/
+
+#include "common.h"
+
+#define ALL_ELEM -1
+/* reset functions activate all superNodes if they have more successors */
+#define RESET_ACTIVATE_MAX 100
+
+static LIRProgram* program;
+static LIRFunc* curFunc;
+
+static const char* opNames[] = {
+  "const", "load", "store", "ext", "add", "sub", "mul", "div", "rem", "lt", "leq", "gt", "geq", "eq", "neq",
+  "and", "or", "xor", "not", "shl", "shr", "andr", "orr", "xorr", "mux", "if", "else", "endif", "loop", "endloop",
+  "activate", "activate_all", "printf", "assert", "exit"
+};
+
+const char* lirOpName(LIROp op) {
+  static_assert(LENGTH(opNames) == LIR_OP_NUM, "opNames does not match LIROp");
+  return opNames[op];
+}
+
+static void unsupported(const char* fmt, ...) {
+  if (!program->unsupported.empty()) return;
+  char buf[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  program->unsupported = buf;
+}
+
+LIRVar* LIRProgram::getVar(std::string varName, int width, bool sign, int entryNum, Node* node) {
+  auto iter = varMap.find(varName);
+  if (iter != varMap.end()) return iter->second;
+  LIRVar* var = new LIRVar(varName, vars.size(), width, sign);
+  var->entryNum = entryNum;
+  var->node = node;
+  vars.push_back(var);
+  varMap[varName] = var;
+  return var;
+}
+
+size_t LIRProgram::instNum() {
+  size_t num = init.insts.size() + prologue.insts.size();
+  for (LIRFunc* func : supers) {
+    if (func) num += func->insts.size();
+  }
+  for (LIRFunc* func : shared) num += func->insts.size();
+  for (LIRReset& reset : resets) num += reset.func.insts.size();
+  return num;
+}
+
+/* the body of a deduplicated superNode with its own vars and superNodes, for backends evaluating it inline */
+LIRFunc* LIRProgram::instantiate(LIRFunc* func) {
+  if (!func->proto) return func;
+  LIRFunc* proto = func->proto;
+  std::map<LIRVar*, LIRVar*> varMap;
+  std::map<int, int> idMap;
+  for (size_t i = 0; i < proto->varParams.size(); i ++) varMap[proto->varParams[i]] = func->varArgs[i];
+  for (size_t i = 0; i < proto->idParams.size(); i ++) idMap[proto->idParams[i]] = func->idArgs[i];
+  LIRFunc* ret = new LIRFunc();
+  ret->name = func->name;
+  ret->insts = proto->insts;
+  ret->tmpWidth = proto->tmpWidth;
+  for (LIRInst& inst : ret->insts) {
+    if (inst.var && varMap.find(inst.var) != varMap.end()) inst.var = varMap[inst.var];
+    for (int& id : inst.ids) {
+      if (idMap.find(id) != idMap.end()) id = idMap[id];
+    }
+  }
+  return ret;
+}
+
+static int tw(int width) { return MAX(width, 1); }
+
+static int log2Int(int x) {
+  int ret = 0;
+  while ((1 << ret) < x) ret ++;
+  return ret;
+}
+
+static int tmpWidth(int tmp) { return curFunc->tmpWidth[tmp]; }
+
+static int newInst(LIROp op, int width, bool sign, int src0, int src1 = -1, int src2 = -1, int64_t imm = 0) {
+  LIRInst inst(op);
+  inst.dst = curFunc->newTmp(width);
+  inst.width = width;
+  inst.sign = sign;
+  inst.src[0] = src0;
+  inst.src[1] = src1;
+  inst.src[2] = src2;
+  inst.imm = imm;
+  curFunc->insts.push_back(std::move(inst));
+  return curFunc->tmpWidth.size() - 1;
+}
+
+static void newCtrl(LIROp op, int src0 = -1) {
+  LIRInst inst(op);
+  inst.src[0] = src0;
+  curFunc->insts.push_back(std::move(inst));
+}
+
+static int consInst(mpz_t val, int width) {
+  mpz_t canon;
+  mpz_init(canon);
+  mpz_fdiv_r_2exp(canon, val, width);
+  LIRInst inst(LIR_CONST);
+  inst.dst = curFunc->newTmp(width);
+  inst.width = width;
+  inst.cons.resize((width + 63) / 64, 0);
+  mpz_export(inst.cons.data(), nullptr, -1, sizeof(uint64_t), 0, 0, canon);
+  mpz_clear(canon);
+  curFunc->insts.push_back(std::move(inst));
+  return curFunc->tmpWidth.size() - 1;
+}
+
+static int consInst(uint64_t val, int width) {
+  mpz_t cons;
+  mpz_init_set_ui(cons, val);
+  int ret = consInst(cons, width);
+  mpz_clear(cons);
+  return ret;
+}
+
+static int extInst(int tmp, int width, bool sign) {
+  if (tmpWidth(tmp) == width) return tmp;
+  return newInst(LIR_EXT, width, sign, tmp);
+}
+
+static int shiftImm(LIROp op, int tmp, int shift, bool sign) {
+  if (shift == 0) return tmp;
+  return newInst(op, tmpWidth(tmp), sign, tmp, -1, -1, shift);
+}
+
+static int nonZero(int tmp) {
+  if (tmpWidth(tmp) == 1) return tmp;
+  return newInst(LIR_ORR, 1, false, tmp);
+}
+
+static int loadVar(LIRVar* var, int idx, int64_t off) {
+  int ret = newInst(LIR_LOAD, var->width, var->sign, idx, -1, -1, off);
+  curFunc->insts.back().var = var;
+  return ret;
+}
+
+static void storeVar(LIRVar* var, int idx, int64_t off, int val) {
+  LIRInst inst(LIR_STORE);
+  inst.var = var;
+  inst.src[0] = idx;
+  inst.src[1] = val;
+  inst.imm = off;
+  inst.width = var->width;
+  curFunc->insts.push_back(std::move(inst));
+}
+
+static bool isConstant(ENode* enode) {
+  return enode && enode->computeInfo && enode->computeInfo->status == VAL_CONSTANT && enode->computeInfo->type != TYPE_ARRAY;
+}
+
+static bool isInvalid(ENode* enode) {
+  return enode && enode->computeInfo && enode->computeInfo->status == VAL_INVALID;
+}
+
+static LIRVar* nodeVar(Node* node) {
+  int entryNum = node->type == NODE_MEMORY ? upperPower2(node->depth) : 1;
+  for (int dim : node->dimension) entryNum *= upperPower2(dim);
+  return program->getVar(node->name, tw(node->width), node->sign, entryNum, node);
+}
+
+static LIRVar* resetVar(Node* node) {
+  return program->getVar(RESET_NAME(node), tw(node->width), node->sign, 1, node);
+}
+
+/* access to the elements of an array node selected by the index children of an enode */
+class ArrayAccess {
+public:
+  Node* node;
+  int dimBeg = 0;       // number of indexed dimensions
+  int idx = -1;         // variable part of the offset
+  int64_t off = 0;      // constant part of the offset, dimensions are padded to a power of 2
+  int64_t realOff = 0;  // offset without padding, used in splitted arrays
+  bool varIdx = false;
+  bool isSubArray() { return dimBeg < (int)node->dimension.size(); }
+  int elemNum() {
+    int num = 1;
+    for (size_t i = dimBeg; i < node->dimension.size(); i ++) num *= node->dimension[i];
+    return num;
+  }
+  int64_t elemOffset(int elem, bool padded) {
+    int64_t ret = 0, stride = 1;
+    for (int i = node->dimension.size() - 1; i >= dimBeg; i --) {
+      ret += (elem % node->dimension[i]) * stride;
+      elem /= node->dimension[i];
+      stride *= padded ? upperPower2(node->dimension[i]) : node->dimension[i];
+    }
+    return ret;
+  }
+};
+
+static int lowerExpr(ENode* enode, int elem);
+static ArrayAccess* curLval = nullptr;
+
+static bool constIndex(ENode* index, int& val) {
+  if (index->opType == OP_INDEX_INT) {
+    val = index->values[0];
+    return true;
+  }
+  if (isConstant(index->getChild(0))) {
+    val = mpz_get_ui(index->getChild(0)->computeInfo->consVal);
+    return true;
+  }
+  return false;
+}
+
+static ArrayAccess arrayAccess(ENode* enode, Node* node) {
+  ArrayAccess ret;
+  ret.node = node;
+  ret.dimBeg = node->isArray() ? enode->getChildNum() : 0;
+  for (int i = 0; i < ret.dimBeg; i ++) {
+    int64_t stride = 1, realStride = 1;
+    for (size_t j = i + 1; j < node->dimension.size(); j ++) {
+      stride *= upperPower2(node->dimension[j]);
+      realStride *= node->dimension[j];
+    }
+    int pad = upperPower2(node->dimension[i]);
+    int val;
+    if (constIndex(enode->getChild(i), val)) {
+      ret.off += (int64_t)(val & (pad - 1)) * stride;
+      ret.realOff += (int64_t)val * realStride;
+      continue;
+    }
+    ret.varIdx = true;
+    if (node->arraySplitted()) continue;
+    /* indexes out of the padded dimension are wrapped */
+    int idx = lowerExpr(enode->getChild(i)->getChild(0), ALL_ELEM);
+    if (tmpWidth(idx) > log2Int(pad)) idx = newInst(LIR_AND, tmpWidth(idx), false, idx, consInst(pad - 1, tmpWidth(idx)));
+    idx = extInst(idx, LIR_IDX_WIDTH, false);
+    idx = shiftImm(LIR_SHL, idx, log2Int(stride), false);
+    ret.idx = ret.idx < 0 ? idx : newInst(LIR_ADD, LIR_IDX_WIDTH, false, ret.idx, idx);
+  }
+  return ret;
+}
+
+static ArrayAccess wholeAccess(Node* node) {
+  ArrayAccess ret;
+  ret.node = node;
+  return ret;
+}
+
+/* value of a node without index, merged nodes are computed in place */
+static int nodeValue(Node* node) {
+  if (node->status == CONSTANT_NODE && node->computeInfo && node->computeInfo->status == VAL_CONSTANT) {
+    return consInst(node->computeInfo->consVal, tw(node->width));
+  }
+  if (node->status == MERGED_NODE) {
+    ENode* root = node->assignTree[0]->getRoot();
+    return extInst(lowerExpr(root, ALL_ELEM), tw(node->width), root->sign);
+  }
+  return loadVar(nodeVar(node), -1, 0);
+}
+
+static Node* splittedMember(ArrayAccess& access, int elem) {
+  if (access.varIdx) {
+    unsupported("variable index of splitted array %s", access.node->name.c_str());
+    return nullptr;
+  }
+  return access.node->getArrayMember(access.realOff + access.elemOffset(elem, false));
+}
+
+static int loadElem(ArrayAccess& access, int elem) {
+  Node* node = access.node;
+  if (elem < 0) {
+    if (access.isSubArray() && access.elemNum() > 1) unsupported("array %s is used as a value", node->name.c_str());
+    elem = 0;
+  }
+  if (node->arraySplitted()) {
+    Node* member = splittedMember(access, elem);
+    return member ? nodeValue(member) : consInst((uint64_t)0, tw(node->width));
+  }
+  if (!node->isArray()) return nodeValue(node);
+  return loadVar(nodeVar(node), access.idx, access.off + access.elemOffset(elem, true));
+}
+
+static void storeElem(ArrayAccess& access, int elem, int val, bool valSign) {
+  Node* node = access.node;
+  if (elem < 0) elem = 0;
+  LIRVar* var;
+  int idx = -1;
+  int64_t off = 0;
+  if (node->arraySplitted()) {
+    Node* member = splittedMember(access, elem);
+    if (!member) return;
+    var = nodeVar(member);
+  } else {
+    var = nodeVar(node);
+    idx = access.idx;
+    off = access.off + access.elemOffset(elem, true);
+  }
+  storeVar(var, idx, off, extInst(val, var->width, valSign));
+}
+
+/* the previous value of the lvalue, used by when without a branch in expressions */
+static int selfValue(int elem, int width) {
+  if (!curLval) {
+    unsupported("when without else branch in expression");
+    return consInst((uint64_t)0, width);
+  }
+  return extInst(loadElem(*curLval, elem), width, curLval->node->sign);
+}
+
+static int condValue(ENode* cond) {
+  return nonZero(lowerExpr(cond, ALL_ELEM));
+}
+
+static int childValue(ENode* enode, int idx, int elem) {
+  return lowerExpr(enode->getChild(idx), elem);
+}
+
+static int fitChild(ENode* enode, int idx, int elem, int width) {
+  return extInst(childValue(enode, idx, elem), width, enode->getChild(idx)->sign);
+}
+
+static int lowerLeaf(ENode* enode, int elem) {
+  Node* node = enode->getNode();
+  int val;
+  if (node->isArray()) {
+    ArrayAccess access = arrayAccess(enode, node);
+    val = loadElem(access, elem);
+  } else {
+    val = nodeValue(node);
+  }
+  return extInst(val, tw(enode->width), enode->sign);
+}
+
+static int lowerMux(ENode* enode, int elem, int width) {
+  ENode* cond = enode->getChild(0);
+  ENode* trueNode = enode->getChildNum() > 1 ? enode->getChild(1) : nullptr;
+  ENode* falseNode = enode->getChildNum() > 2 ? enode->getChild(2) : nullptr;
+  auto branchValue = [&](ENode* branch) {
+    if (!branch) return selfValue(elem, width);
+    return extInst(lowerExpr(branch, elem), width, branch->sign);
+  };
+  if (isConstant(cond)) return branchValue(mpz_sgn(cond->computeInfo->consVal) != 0 ? trueNode : falseNode);
+  if (isInvalid(trueNode)) return branchValue(falseNode);
+  if (isInvalid(falseNode)) return branchValue(trueNode);
+  int condVal = condValue(cond);
+  int trueVal = branchValue(trueNode);
+  int falseVal = branchValue(falseNode);
+  return newInst(LIR_MUX, width, false, condVal, trueVal, falseVal);
+}
+
+/* operands are extended with their signs to the operation width, the result is truncated to width */
+static int lowerArith(LIROp op, ENode* enode, int elem, int width, bool sign) {
+  int opWidth = MAX(width, MAX(tw(enode->getChild(0)->width), tw(enode->getChild(1)->width)));
+  int left = fitChild(enode, 0, elem, opWidth);
+  int right = fitChild(enode, 1, elem, opWidth);
+  return extInst(newInst(op, opWidth, sign, left, right), width, sign);
+}
+
+static int lowerCompare(LIROp op, ENode* enode, int elem, int width) {
+  int opWidth = MAX(tw(enode->getChild(0)->width), tw(enode->getChild(1)->width));
+  bool sign = enode->getChild(0)->sign;
+  int left = fitChild(enode, 0, elem, opWidth);
+  int right = fitChild(enode, 1, elem, opWidth);
+  return extInst(newInst(op, 1, sign, left, right), width, false);
+}
+
+static int lowerReadMem(ENode* enode, int width) {
+  Node* memory = enode->memoryNode;
+  if (!memory->dimension.empty()) unsupported("memory %s of arrays", memory->name.c_str());
+  int depth = upperPower2(memory->depth);
+  int addr = childValue(enode, 0, ALL_ELEM);
+  if (tmpWidth(addr) > log2Int(depth)) addr = newInst(LIR_AND, tmpWidth(addr), false, addr, consInst(depth - 1, tmpWidth(addr)));
+  addr = extInst(addr, LIR_IDX_WIDTH, false);
+  return extInst(loadVar(nodeVar(memory), addr, 0), width, memory->sign);
+}
+
+static int lowerExpr(ENode* enode, int elem) {
+  int width = tw(enode->width);
+  if (isConstant(enode)) return consInst(enode->computeInfo->consVal, width);
+  if (enode->getNode()) return lowerLeaf(enode, elem);
+  bool childSign = enode->getChildNum() > 0 && enode->getChild(0) ? enode->getChild(0)->sign : false;
+  int childWidth = enode->getChildNum() > 0 && enode->getChild(0) ? enode->getChild(0)->width : 0;
+  switch (enode->opType) {
+    case OP_ADD: return lowerArith(LIR_ADD, enode, elem, width, enode->sign);
+    case OP_SUB: return lowerArith(LIR_SUB, enode, elem, width, enode->sign);
+    case OP_MUL: return lowerArith(LIR_MUL, enode, elem, width, enode->sign);
+    case OP_DIV: return lowerArith(LIR_DIV, enode, elem, width, childSign);
+    case OP_REM: return lowerArith(LIR_REM, enode, elem, width, childSign);
+    case OP_AND: return lowerArith(LIR_AND, enode, elem, width, false);
+    case OP_OR: return lowerArith(LIR_OR, enode, elem, width, false);
+    case OP_XOR: return lowerArith(LIR_XOR, enode, elem, width, false);
+    case OP_LT: return lowerCompare(LIR_LT, enode, elem, width);
+    case OP_LEQ: return lowerCompare(LIR_LEQ, enode, elem, width);
+    case OP_GT: return lowerCompare(LIR_GT, enode, elem, width);
+    case OP_GEQ: return lowerCompare(LIR_GEQ, enode, elem, width);
+    case OP_EQ: return lowerCompare(LIR_EQ, enode, elem, width);
+    case OP_NEQ: return lowerCompare(LIR_NEQ, enode, elem, width);
+    case OP_DSHL: {
+      int val = fitChild(enode, 0, elem, width);
+      return newInst(LIR_SHL, width, false, val, childValue(enode, 1, elem));
+    }
+    case OP_DSHR: {
+      int val = childValue(enode, 0, elem);
+      int shifted = newInst(LIR_SHR, tmpWidth(val), childSign, val, childValue(enode, 1, elem));
+      return extInst(shifted, width, childSign);
+    }
+    case OP_CAT: {
+      int loWidth = enode->getChild(1)->width;
+      int lo = fitChild(enode, 1, elem, width);
+      if (loWidth >= width) return extInst(lo, width, false);
+      int hi = shiftImm(LIR_SHL, extInst(childValue(enode, 0, elem), width, false), loWidth, false);
+      return newInst(LIR_OR, width, false, hi, extInst(lo, width, false));
+    }
+    case OP_ASUINT: return extInst(childValue(enode, 0, elem), width, false);
+    case OP_ASSINT:
+    case OP_SEXT: return extInst(childValue(enode, 0, elem), width, true);
+    case OP_CVT:
+    case OP_PAD: return fitChild(enode, 0, elem, width);
+    case OP_ASCLOCK:
+    case OP_ASASYNCRESET: return extInst(nonZero(childValue(enode, 0, elem)), width, false);
+    case OP_NEG: return newInst(LIR_SUB, width, false, consInst((uint64_t)0, width), fitChild(enode, 0, elem, width));
+    case OP_NOT: return newInst(LIR_NOT, width, false, fitChild(enode, 0, elem, width));
+    case OP_ANDR: return extInst(newInst(LIR_ANDR, 1, false, childValue(enode, 0, elem)), width, false);
+    case OP_ORR: return extInst(newInst(LIR_ORR, 1, false, childValue(enode, 0, elem)), width, false);
+    case OP_XORR: return extInst(newInst(LIR_XORR, 1, false, childValue(enode, 0, elem)), width, false);
+    case OP_SHL: return shiftImm(LIR_SHL, fitChild(enode, 0, elem, width), enode->values[0], false);
+    case OP_SHR:
+    case OP_HEAD: {
+      int val = childValue(enode, 0, elem);
+      int shift = MIN(enode->values[0], tmpWidth(val));
+      return extInst(shiftImm(LIR_SHR, val, shift, childSign), width, childSign);
+    }
+    case OP_TAIL: {
+      int val = fitChild(enode, 0, elem, MAX(width, tw(childWidth)));
+      return extInst(extInst(val, MIN(width, MAX(enode->values[0], 1)), false), width, false);
+    }
+    case OP_BITS: {
+      int hi = enode->values[0], lo = enode->values[1];
+      if (lo >= childWidth) return consInst((uint64_t)0, width);
+      int val = fitChild(enode, 0, elem, MAX(hi + 1, tw(childWidth)));
+      val = extInst(shiftImm(LIR_SHR, val, lo, false), hi - lo + 1, false);
+      return extInst(val, width, false);
+    }
+    case OP_BITS_NOSHIFT: {
+      int hi = enode->values[0], lo = enode->values[1];
+      int opWidth = MAX(width, hi + 1);
+      mpz_t mask;
+      mpz_init(mask);
+      mpz_setbit(mask, hi + 1);
+      mpz_sub_ui(mask, mask, 1);
+      mpz_tdiv_q_2exp(mask, mask, lo);
+      mpz_mul_2exp(mask, mask, lo);
+      int val = newInst(LIR_AND, opWidth, false, fitChild(enode, 0, elem, opWidth), consInst(mask, opWidth));
+      mpz_clear(mask);
+      return extInst(val, width, false);
+    }
+    case OP_MUX:
+    case OP_WHEN: return lowerMux(enode, elem, width);
+    case OP_GROUP:
+      if (elem < 0) {
+        unsupported("group is used as a value");
+        elem = 0;
+      }
+      return fitChild(enode, elem, ALL_ELEM, width);
+    case OP_READ_MEM: return lowerReadMem(enode, width);
+    case OP_INVALID: return consInst((uint64_t)0, width);
+    case OP_INT: return consInst(enode->computeInfo->consVal, width);
+    case OP_EXT_FUNC: unsupported("external function %s", enode->strVal.c_str()); break;
+    default: unsupported("operation %d in expression", enode->opType); break;
+  }
+  return consInst((uint64_t)0, width);
+}
+
+/* strVal of printf and assert is a C string literal */
+static std::string unescapeStr(std::string str) {
+  if (str.length() >= 2 && str.front() == '"' && str.back() == '"') str = str.substr(1, str.length() - 2);
+  std::string ret;
+  for (size_t i = 0; i < str.length(); i ++) {
+    if (str[i] != '\\' || i + 1 == str.length()) {
+      ret += str[i];
+      continue;
+    }
+    char c = str[++ i];
+    switch (c) {
+      case 'n': ret += '\n'; break;
+      case 't': ret += '\t'; break;
+      case 'r': ret += '\r'; break;
+      case '0': ret += '\0'; break;
+      default: ret += c; break;
+    }
+  }
+  return ret;
+}
+
+static std::string escapeStr(const std::string& str) {
+  std::string ret = "\"";
+  for (char c : str) {
+    switch (c) {
+      case '\n': ret += "\\n"; break;
+      case '\t': ret += "\\t"; break;
+      case '\r': ret += "\\r"; break;
+      case '\0': ret += "\\0"; break;
+      case '"': ret += "\\\""; break;
+      case '\\': ret += "\\\\"; break;
+      default: ret += c; break;
+    }
+  }
+  return ret + "\"";
+}
+
+static void lowerAssign(ENode* root, ArrayAccess& lvalue, int elem);
+
+static void storeValue(ENode* root, ArrayAccess& lvalue, int elem) {
+  if (elem < 0 && lvalue.isSubArray()) {
+    for (int i = 0; i < lvalue.elemNum(); i ++) storeElem(lvalue, i, lowerExpr(root, i), root->sign);
+  } else {
+    storeElem(lvalue, elem, lowerExpr(root, elem), root->sign);
+  }
+}
+
+static void lowerBranches(int cond, ENode* trueNode, ENode* falseNode, ArrayAccess& lvalue, int elem) {
+  newCtrl(LIR_IF, cond);
+  lowerAssign(trueNode, lvalue, elem);
+  size_t elseIdx = curFunc->insts.size();
+  newCtrl(LIR_ELSE);
+  lowerAssign(falseNode, lvalue, elem);
+  if (curFunc->insts.size() == elseIdx + 1) curFunc->insts.pop_back();
+  newCtrl(LIR_ENDIF);
+}
+
+static void lowerWriteMem(ENode* root) {
+  Node* memory = root->memoryNode;
+  if (!memory->dimension.empty()) {
+    unsupported("memory %s of arrays", memory->name.c_str());
+    return;
+  }
+  int depth = upperPower2(memory->depth);
+  int addr = childValue(root, 0, ALL_ELEM);
+  if (tmpWidth(addr) > log2Int(depth)) addr = newInst(LIR_AND, tmpWidth(addr), false, addr, consInst(depth - 1, tmpWidth(addr)));
+  addr = extInst(addr, LIR_IDX_WIDTH, false);
+  LIRVar* var = nodeVar(memory);
+  storeVar(var, addr, 0, fitChild(root, 1, ALL_ELEM, var->width));
+}
+
+static void lowerPrintf(ENode* root) {
+  LIRInst inst(LIR_PRINTF);
+  for (ENode* arg : root->child) inst.args.push_back(lowerExpr(arg, ALL_ELEM));
+  inst.str = unescapeStr(root->strVal);
+  curFunc->insts.push_back(std::move(inst));
+}
+
+static void lowerAssert(ENode* root) {
+  ENode* pred = root->getChild(0);
+  ENode* en = root->getChild(1);
+  if (isConstant(pred) && mpz_sgn(pred->computeInfo->consVal) != 0) return;
+  if (isConstant(en) && mpz_sgn(en->computeInfo->consVal) == 0) return;
+  LIRInst inst(LIR_ASSERT);
+  inst.src[0] = condValue(pred);
+  if (!isConstant(en)) inst.src[1] = condValue(en);
+  inst.str = unescapeStr(root->strVal);
+  curFunc->insts.push_back(std::move(inst));
+}
+
+static void lowerExit(ENode* root) {
+  ENode* cond = root->getChild(0);
+  if (isConstant(cond) && mpz_sgn(cond->computeInfo->consVal) == 0) return;
+  LIRInst inst(LIR_EXIT);
+  inst.src[0] = condValue(cond);
+  inst.imm = strtol(root->strVal.c_str(), nullptr, 0);
+  curFunc->insts.push_back(std::move(inst));
+}
+
+static void lowerAssign(ENode* root, ArrayAccess& lvalue, int elem) {
+  if (!root) return;
+  valInfo* info = root->computeInfo;
+  if (info && (info->status == VAL_INVALID || info->status == VAL_EMPTY || info->status == VAL_EMPTY_SRC)) return;
+  if (isConstant(root)) {
+    storeValue(root, lvalue, elem);
+    return;
+  }
+  switch (root->opType) {
+    case OP_WHEN: {
+      ENode* cond = root->getChild(0);
+      ENode* trueNode = root->getChild(1);
+      ENode* falseNode = root->getChild(2);
+      Node* node = lvalue.node;
+      if (isConstant(cond)) {
+        lowerAssign(mpz_sgn(cond->computeInfo->consVal) != 0 ? trueNode : falseNode, lvalue, elem);
+      } else if (isInvalid(trueNode) && (node->type == NODE_OTHERS || node->type == NODE_MEM_MEMBER)) {
+        lowerAssign(falseNode, lvalue, elem);
+      } else if (isInvalid(falseNode) && (node->type == NODE_OTHERS || node->type == NODE_MEM_MEMBER)) {
+        lowerAssign(trueNode, lvalue, elem);
+      } else {
+        lowerBranches(condValue(cond), trueNode, falseNode, lvalue, elem);
+      }
+      break;
+    }
+    case OP_RESET: {
+      ENode* cond = root->getChild(0);
+      if (isConstant(cond)) {
+        if (mpz_sgn(cond->computeInfo->consVal) != 0) lowerAssign(root->getChild(1), lvalue, elem);
+      } else {
+        lowerBranches(condValue(cond), root->getChild(1), nullptr, lvalue, elem);
+      }
+      break;
+    }
+    case OP_STMT:
+      for (ENode* child : root->child) lowerAssign(child, lvalue, elem);
+      break;
+    case OP_WRITE_MEM:
+      if (lvalue.node->isArray()) unsupported("writer %s of arrays", lvalue.node->name.c_str());
+      else lowerWriteMem(root);
+      break;
+    case OP_PRINTF: lowerPrintf(root); break;
+    case OP_ASSERT: lowerAssert(root); break;
+    case OP_EXIT: lowerExit(root); break;
+    case OP_EXT_FUNC: unsupported("external function %s", root->strVal.c_str()); break;
+    case OP_INVALID: break;
+    default: storeValue(root, lvalue, elem); break;
+  }
+}
+
+static void emitActivate(std::set<int>& nextId, int cond) {
+  LIRInst inst(LIR_ACTIVATE);
+  for (int id : nextId) {
+    if (id < program->superNum) inst.ids.push_back(id);
+  }
+  if (inst.ids.empty()) return;
+  inst.src[0] = cond;
+  curFunc->insts.push_back(std::move(inst));
+}
+
+static void lowerStmtNode(StmtNode* stmt, bool activate) {
+  ENode* lval = stmt->tree->getlval();
+  Node* node = lval->getNode();
+  Node* belong = (activate && node->type != NODE_SPECIAL && stmt->belong && !stmt->belong->isLocal() && stmt->belong->needActivate()) ? stmt->belong : nullptr;
+  size_t beg = curFunc->insts.size();
+  int oldVal = -1;
+  if (belong && !belong->isArray() && belong->type != NODE_WRITER) oldVal = loadVar(nodeVar(belong), -1, 0);
+  ArrayAccess lvalue = arrayAccess(lval, node);
+  size_t bodyBeg = curFunc->insts.size();
+  curLval = &lvalue;
+  lowerAssign(stmt->tree->getRoot(), lvalue, ALL_ELEM);
+  curLval = nullptr;
+  if (curFunc->insts.size() == bodyBeg) {
+    curFunc->insts.resize(beg, LIRInst(LIR_CONST));
+    return;
+  }
+  if (!belong) return;
+  if (belong->isArray() || belong->type == NODE_WRITER) {
+    emitActivate(belong->nextActiveId, -1);
+    return;
+  }
+  int newVal = loadVar(nodeVar(belong), -1, 0);
+  int changed = newInst(LIR_NEQ, tmpWidth(newVal), false, newVal, oldVal);
+  if (belong->isAsyncReset()) {
+    LIRInst inst(LIR_ACTIVATE_ALL);
+    inst.src[0] = newInst(LIR_OR, 1, false, nonZero(oldVal), changed);
+    curFunc->insts.push_back(std::move(inst));
+  } else {
+    emitActivate(belong->nextActiveId, changed);
+  }
+}
+
+static void lowerStmt(StmtNode* stmt, bool activate) {
+  switch (stmt->type) {
+    case OP_STMT_SEQ:
+      for (StmtNode* child : stmt->child) lowerStmt(child, activate);
+      break;
+    case OP_STMT_WHEN: {
+      ENode* cond = stmt->getChild(0)->enode;
+      if (isConstant(cond)) {
+        lowerStmt(stmt->getChild(mpz_sgn(cond->computeInfo->consVal) != 0 ? 1 : 2), activate);
+        break;
+      }
+      newCtrl(LIR_IF, condValue(cond));
+      lowerStmt(stmt->getChild(1), activate);
+      size_t elseIdx = curFunc->insts.size();
+      newCtrl(LIR_ELSE);
+      lowerStmt(stmt->getChild(2), activate);
+      if (curFunc->insts.size() == elseIdx + 1) curFunc->insts.pop_back();
+      newCtrl(LIR_ENDIF);
+      break;
+    }
+    case OP_STMT_NODE: lowerStmtNode(stmt, activate); break;
+    default: Panic();
+  }
+}
+
+/* same as cppEmitter, used if genLIR is called without it */
+static void assignCppId(std::vector<SuperNode*>& sortedSuper) {
+  for (SuperNode* super : sortedSuper) {
+    if (super->cppId >= 0) return;
+  }
+  int superId = 0;
+  std::set<int> alwaysActive;
+  for (SuperNode* super : sortedSuper) {
+    if (!super->instsEmpty() || super->superType == SUPER_EXTMOD) {
+      super->cppId = superId ++;
+      if (super->superType == SUPER_EXTMOD) alwaysActive.insert(super->cppId);
+    }
+  }
+  for (SuperNode* super : sortedSuper) {
+    for (Node* member : super->member) {
+      if (member->status == VALID_NODE) {
+        member->updateActivate();
+        member->updateNeedActivate(alwaysActive);
+      }
+    }
+  }
+}
+
+static void resetActivation(SuperNode* super, LIRReset& reset) {
+  std::set<int> allNext;
+  for (Node* node : super->member) {
+    for (Node* next : node->next) {
+      if (next->super->cppId >= 0) allNext.insert(next->super->cppId);
+    }
+    if (!node->regSplit) {
+      if (node->getDst()->super->cppId >= 0) allNext.insert(node->getDst()->super->cppId);
+    } else if (node->getSrc()->regUpdate && node->getSrc()->regUpdate->super->cppId >= 0) {
+      allNext.insert(node->getSrc()->regUpdate->super->cppId);
+    }
+  }
+  if (allNext.size() > RESET_ACTIVATE_MAX) reset.activateAll = true;
+  else reset.ids.assign(allNext.begin(), allNext.end());
+}
+
+void graph::genLIR() {
+  assignCppId(sortedSuper);
+  program = new LIRProgram();
+  program->name = name;
+  for (SuperNode* super : sortedSuper) program->superNum = MAX(program->superNum, super->cppId + 1);
+  program->supers.resize(program->superNum, nullptr);
+  if (globalConfig.batchLanes > 1) unsupported("batch mode");
+
+  /* superNodes */
+  for (SuperNode* super : sortedSuper) {
+    if (super->cppId < 0) continue;
+    LIRFunc* func = new LIRFunc();
+    func->name = format("super%d", super->cppId);
+    program->supers[super->cppId] = func;
+    if (super->superType == SUPER_EXTMOD) {
+      unsupported("external module %s", super->member[0]->name.c_str());
+      continue;
+    }
+    curFunc = func;
+    if (super->stmtTree) lowerStmt(super->stmtTree->root, true);
+  }
+
+  /* constant arrays */
+  program->init.name = "init";
+  curFunc = &program->init;
+  for (SuperNode* super : sortedSuper) {
+    if (super->superType != SUPER_VALID && super->superType != SUPER_ASYNC_RESET) continue;
+    for (Node* node : super->member) {
+      if (node->type == NODE_SPECIAL || node->type == NODE_REG_UPDATE || node->status != VALID_NODE) continue;
+      if ((node->type == NODE_REG_DST && !node->regSplit) || node->initInsts.empty()) continue;
+      for (ExpTree* tree : node->assignTree) {
+        ArrayAccess lvalue = arrayAccess(tree->getlval(), node);
+        lowerAssign(tree->getRoot(), lvalue, ALL_ELEM);
+      }
+    }
+  }
+
+  /* registers with reset read their values before the current cycle */
+  program->prologue.name = "prologue";
+  curFunc = &program->prologue;
+  for (SuperNode* super : sortedSuper) {
+    for (Node* member : super->member) {
+      if (member->isReset() && member->type == NODE_REG_SRC) storeVar(resetVar(member), -1, 0, loadVar(nodeVar(member), -1, 0));
+    }
+  }
+
+  /* reset functions */
+  std::vector<SuperNode*> resetSuper;
+  for (SuperNode* super : sortedSuper) {
+    if (super->superType == SUPER_ASYNC_RESET) resetSuper.push_back(super);
+  }
+  for (SuperNode* super : uintReset) {
+    if (super->resetNode->status != CONSTANT_NODE) resetSuper.push_back(super);
+  }
+  for (SuperNode* super : resetSuper) {
+    LIRReset reset;
+    reset.cond = super->resetNode->type == NODE_REG_SRC ? resetVar(super->resetNode) : nodeVar(super->resetNode);
+    reset.func.name = format("reset%ld", program->resets.size());
+    resetActivation(super, reset);
+    curFunc = &reset.func;
+    if (super->superType == SUPER_ASYNC_RESET) {
+      if (super->stmtTree) lowerStmt(super->stmtTree->root, false);
+    } else {
+      for (Node* reg : super->member) {
+        if (reg->status != VALID_NODE || !reg->resetTree) continue;
+        ENode* root = reg->resetTree->getRoot();
+        ArrayAccess lvalue = wholeAccess(reg);
+        lowerAssign(root, lvalue, ALL_ELEM);
+        if (reg->regSplit && reg->getDst()->status == VALID_NODE) {
+          ArrayAccess dstLvalue = wholeAccess(reg->getDst());
+          lowerAssign(root, dstLvalue, ALL_ELEM);
+        }
+      }
+    }
+    program->resets.push_back(std::move(reset));
+  }
+
+  /* interface */
+  for (Node* in : input) {
+    LIRPort port;
+    port.name = in->name;
+    port.width = in->width;
+    port.var = nodeVar(in);
+    std::set<int> allNext;
+    for (Node* next : in->next) {
+      if (next->super->cppId >= 0) allNext.insert(next->super->cppId);
+    }
+    port.ids.assign(allNext.begin(), allNext.end());
+    if (!in->insts.empty()) unsupported("instructions of input %s", in->name.c_str());
+    program->inputs.push_back(port);
+  }
+  for (Node* out : output) {
+    LIRPort port;
+    port.name = out->name;
+    port.width = out->width;
+    if (out->status == CONSTANT_NODE && out->computeInfo && out->computeInfo->status == VAL_CONSTANT) {
+      mpz_t canon;
+      mpz_init(canon);
+      mpz_fdiv_r_2exp(canon, out->computeInfo->consVal, tw(out->width));
+      port.cons.resize((tw(out->width) + 63) / 64, 0);
+      mpz_export(port.cons.data(), nullptr, -1, sizeof(uint64_t), 0, 0, canon);
+      mpz_clear(canon);
+    } else if (std::find(sortedSuper.begin(), sortedSuper.end(), out->super) != sortedSuper.end()) {
+      port.var = nodeVar(out);
+    } else {
+      continue;
+    }
+    program->outputs.push_back(port);
+  }
+
+  lir = program;
+  printStat("[genLIR] %ld vars, %d superNodes, %ld resets, %ld insts\n", program->vars.size(), program->superNum, program->resets.size(), program->instNum());
+  if (!program->unsupported.empty()) printStat("[genLIR] unsupported: %s\n", program->unsupported.c_str());
+  if (globalConfig.reroll) rerollLIR();
+  if (globalConfig.dedup) dedupLIR();
+  if (globalConfig.dumpLIR) {
+    std::string fileName = globalConfig.OutputDir + "/" + name + ".lir";
+    FILE* fp = fopen(fileName.c_str(), "w");
+    Assert(fp, "can not open %s", fileName.c_str());
+    program->dump(fp);
+    fclose(fp);
+  }
+}
+
+static std::string tmpStr(int tmp) {
+  return tmp < 0 ? "-" : "t" + std::to_string(tmp);
+}
+
+static std::string consStr(const std::vector<uint64_t>& cons) {
+  std::string ret = "0x";
+  bool leading = true;
+  for (int i = cons.size() - 1; i >= 0; i --) {
+    if (leading && cons[i] == 0 && i != 0) continue;
+    ret += leading ? format("%lx", cons[i]) : format("%016lx", cons[i]);
+    leading = false;
+  }
+  return ret;
+}
+
+static std::string locStr(const LIRInst& inst) {
+  std::string ret = inst.var->name;
+  if (inst.var->entryNum == 1 && inst.src[0] < 0 && inst.imm == 0) return ret;
+  if (inst.src[0] < 0) return ret + format("[%ld]", inst.imm);
+  if (inst.imm == 0) return ret + "[" + tmpStr(inst.src[0]) + "]";
+  return ret + format("[%s + %ld]", tmpStr(inst.src[0]).c_str(), inst.imm);
+}
+
+static void dumpFunc(FILE* fp, LIRFunc& func, std::string header) {
+  fprintf(fp, "%s (%ld tmps) {\n", header.c_str(), func.tmpWidth.size());
+  int indent = 1;
+  for (LIRInst& inst : func.insts) {
+    if (inst.op == LIR_ELSE || inst.op == LIR_ENDIF || inst.op == LIR_ENDLOOP) indent --;
+    std::string str;
+    std::string suffix = format("%s.%d", inst.sign ? ".s" : "", inst.width);
+    switch (inst.op) {
+      case LIR_CONST: str = format("%s = const.%d %s", tmpStr(inst.dst).c_str(), inst.width, consStr(inst.cons).c_str()); break;
+      case LIR_LOAD: str = format("%s = load.%d %s", tmpStr(inst.dst).c_str(), inst.width, locStr(inst).c_str()); break;
+      case LIR_STORE: str = format("store %s = %s", locStr(inst).c_str(), tmpStr(inst.src[1]).c_str()); break;
+      case LIR_SHL:
+      case LIR_SHR:
+        if (inst.src[1] < 0) {
+          str = format("%s = %s%s %s, %ld", tmpStr(inst.dst).c_str(), lirOpName(inst.op), suffix.c_str(), tmpStr(inst.src[0]).c_str(), inst.imm);
+          break;
+        }
+        /* fall through */
+      case LIR_EXT: case LIR_ADD: case LIR_SUB: case LIR_MUL: case LIR_DIV: case LIR_REM:
+      case LIR_LT: case LIR_LEQ: case LIR_GT: case LIR_GEQ: case LIR_EQ: case LIR_NEQ:
+      case LIR_AND: case LIR_OR: case LIR_XOR: case LIR_NOT: case LIR_ANDR: case LIR_ORR: case LIR_XORR: case LIR_MUX:
+        str = format("%s = %s%s", tmpStr(inst.dst).c_str(), lirOpName(inst.op), suffix.c_str());
+        for (int i = 0; i < 3 && inst.src[i] >= 0; i ++) str += (i == 0 ? " " : ", ") + tmpStr(inst.src[i]);
+        break;
+      case LIR_IF: str = "if " + tmpStr(inst.src[0]); break;
+      case LIR_ELSE: str = "else"; break;
+      case LIR_ENDIF: str = "endif"; break;
+      case LIR_LOOP: str = format("loop %s < %ld", tmpStr(inst.dst).c_str(), inst.imm); break;
+      case LIR_ENDLOOP: str = "endloop"; break;
+      case LIR_ACTIVATE:
+      case LIR_ACTIVATE_ALL:
+        str = inst.op == LIR_ACTIVATE_ALL ? "activate all" : "activate";
+        for (int id : inst.ids) str += " " + std::to_string(id);
+        if (inst.src[0] >= 0) str += " if " + tmpStr(inst.src[0]);
+        break;
+      case LIR_PRINTF:
+        str = "printf " + escapeStr(inst.str);
+        for (int arg : inst.args) str += ", " + tmpStr(arg);
+        break;
+      case LIR_ASSERT:
+        str = "assert " + tmpStr(inst.src[0]);
+        if (inst.src[1] >= 0) str += " if " + tmpStr(inst.src[1]);
+        str += " " + escapeStr(inst.str);
+        break;
+      case LIR_EXIT: str = format("exit %ld if %s", inst.imm, tmpStr(inst.src[0]).c_str()); break;
+      default: Panic();
+    }
+    fprintf(fp, "%s%s\n", std::string(indent * 2, ' ').c_str(), str.c_str());
+    if (inst.op == LIR_IF || inst.op == LIR_ELSE || inst.op == LIR_LOOP) indent ++;
+  }
+  fprintf(fp, "}\n\n");
+}
+
+void LIRProgram::dump(FILE* fp) {
+  fprintf(fp, "; LIR of %s: %ld vars, %d superNodes, %ld insts\n", name.c_str(), vars.size(), superNum, instNum());
+  if (!unsupported.empty()) fprintf(fp, "; unsupported: %s\n", unsupported.c_str());
+  for (LIRVar* var : vars) {
+    if (var->entryNum == 1) fprintf(fp, "var %s : %c%d\n", var->name.c_str(), var->sign ? 's' : 'u', var->width);
+    else fprintf(fp, "var %s : %c%d x %d\n", var->name.c_str(), var->sign ? 's' : 'u', var->width, var->entryNum);
+  }
+  for (LIRPort& port : inputs) {
+    fprintf(fp, "input %s : u%d activate", port.name.c_str(), port.width);
+    for (int id : port.ids) fprintf(fp, " %d", id);
+    fprintf(fp, "\n");
+  }
+  for (LIRPort& port : outputs) {
+    if (port.var) fprintf(fp, "output %s : u%d = %s\n", port.name.c_str(), port.width, port.var->name.c_str());
+    else fprintf(fp, "output %s : u%d = %s\n", port.name.c_str(), port.width, consStr(port.cons).c_str());
+  }
+  fprintf(fp, "\n");
+  dumpFunc(fp, init, "init");
+  dumpFunc(fp, prologue, "prologue");
+  for (LIRFunc* func : shared) {
+    std::string header = func->name + " (";
+    for (size_t i = 0; i < func->varParams.size(); i ++) header += (i == 0 ? "" : ", ") + func->varParams[i]->name;
+    header += ";";
+    for (int id : func->idParams) header += " " + std::to_string(id);
+    dumpFunc(fp, *func, header + ")");
+  }
+  for (LIRFunc* func : supers) {
+    if (!func) continue;
+    if (!func->proto) {
+      dumpFunc(fp, *func, func->name);
+      continue;
+    }
+    fprintf(fp, "%s = %s(", func->name.c_str(), func->proto->name.c_str());
+    for (size_t i = 0; i < func->varArgs.size(); i ++) fprintf(fp, "%s%s", i == 0 ? "" : ", ", func->varArgs[i]->name.c_str());
+    fprintf(fp, ";");
+    for (int id : func->idArgs) fprintf(fp, " %d", id);
+    fprintf(fp, ")\n\n");
+  }
+  for (LIRReset& reset : resets) {
+    std::string header = reset.func.name + " if " + reset.cond->name + " activate";
+    if (reset.activateAll) header += " all";
+    for (int id : reset.ids) header += " " + std::to_string(id);
+    dumpFunc(fp, reset.func, header);
+  }
+}
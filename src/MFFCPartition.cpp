@@ -64,7 +64,7 @@ void graph::MFFCPartition() {
   size_t totalSuper = sortedSuper.size();
   removeEmptySuper();
   reconnectSuper();
-  printf("[MFFCPartition] remove %ld superNodes (%ld -> %ld)\n", totalSuper - sortedSuper.size(), totalSuper, sortedSuper.size());
+  printStat("[MFFCPartition] remove %ld superNodes (%ld -> %ld)\n", totalSuper - sortedSuper.size(), totalSuper, sortedSuper.size());
 }
 
 bool anyPath(SuperNode* super1, SuperNode* super2, graph* g) {
@@ -197,7 +197,7 @@ void graph::essentPartition(){
   size_t phaseSuper = sortedSuper.size();
   mergeAsyncReset();
   mergeUIntReset();
-  printf("[mergeNodes-reset] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[mergeNodes-reset] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
 
   phaseSuper = sortedSuper.size();
   orderAllNodes();
@@ -207,15 +207,15 @@ void graph::essentPartition(){
   }
   resort();
   orderAllNodes();
-  printf("[mergeNodes-MFFC] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[mergeNodes-MFFC] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
 
   phaseSuper = sortedSuper.size();
   mergeIn1();
-  printf("[mergeNodes-In] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[mergeNodes-In] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
 
   phaseSuper = sortedSuper.size();
   mergeSublings();
-  printf("[mergeNodes-Sibling] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[mergeNodes-Sibling] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
 
   phaseSuper = sortedSuper.size();
   orderAllNodes();
@@ -226,7 +226,7 @@ void graph::essentPartition(){
   }
   resort();
 
-  printf("[mergeNodes-smallSib1] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[mergeNodes-smallSib1] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
   phaseSuper = sortedSuper.size();
   mergeEssentSmallSubling(4 * MAX_SIB_SIZE, 0.25);
   for (SuperNode* super : sortedSuper) {
@@ -234,7 +234,7 @@ void graph::essentPartition(){
   }
   resort();
 
-  printf("[mergeNodes-smallSib2] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[mergeNodes-smallSib2] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
   phaseSuper = sortedSuper.size();
-  printf("[mergeNodes] remove %ld superNodes (%ld -> %ld)\n", totalSuper - phaseSuper, totalSuper, phaseSuper);
+  printStat("[mergeNodes] remove %ld superNodes (%ld -> %ld)\n", totalSuper - phaseSuper, totalSuper, phaseSuper);
 }
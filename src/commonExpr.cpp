@@ -190,7 +190,7 @@ void graph::commonExpr() {
   removeNodesNoConnect(DEAD_NODE);
   reconnectAll();
 
-  printf("[commonExpr] remove %ld nodes (-> %ld)\n", aliasMap.size(), countNodes());
+  printStat("[commonExpr] remove %ld nodes (-> %ld)\n", aliasMap.size(), countNodes());
 
 }
 
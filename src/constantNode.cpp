@@ -959,7 +959,7 @@ void graph::constantMemory() {
         memory.end()
     );
   }
-  printf("[constantNode] find %d constant memories\n", num);
+  printStat("[constantNode] find %d constant memories\n", num);
 }
 
 valInfo* Node::computeConstant() {
@@ -1259,6 +1259,6 @@ void graph::constantAnalysis() {
   reconnectAll();
 
   size_t optimizeNodes = countNodes();
-  printf("[constantNode] find %d constantNodes (total %ld)\n", consNum, optimizeNodes);
+  printStat("[constantNode] find %d constantNodes (total %ld)\n", consNum, optimizeNodes);
 
 }
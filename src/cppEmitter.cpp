@@ -5,9 +5,13 @@
 #include "common.h"
 #include "util.h"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <map>
+#include <queue>
 #include <string>
 #include <utility>
 
@@ -20,7 +24,6 @@
 FILE* sigFile = nullptr;
 #endif
 
-#define RESET_NAME(node) (node->name + "$RESET")
 #define emitFuncDecl(indent, ...) __emitSrc(indent, true, true, NULL, __VA_ARGS__)
 #define emitBodyLock(indent, ...) __emitSrc(indent, false, false, NULL, __VA_ARGS__)
 
@@ -37,6 +40,103 @@ static std::set<int> alwaysActive;
 extern int maxConcatNum;
 bool nameExist(std::string str);
 static int resetFuncNum = 0;
+/* source map: the emitted lines (file, first, last) of every superNode */
+static std::map<int, std::vector<std::tuple<int, int, int>>> superSrcLines;
+static int taskSinkNum = 0;
+/* multi-thread evaluation: cppId ranges [beg, end) of every thread in each epoch */
+static int epochNum = 1;
+static std::vector<std::vector<std::tuple<int, int, int>>> threadRanges;
+#define RANGE_EPOCH(range) std::get<0>(range)
+#define RANGE_BEG(range) std::get<1>(range)
+#define RANGE_END(range) std::get<2>(range)
+
+static bool multiThread() {
+  return globalConfig.threadNum > 1;
+}
+
+static bool workSteal() {
+  return multiThread() && globalConfig.workSteal;
+}
+
+/* batch mode: every state variable holds LANES instances, and lane$ selects the evaluated one */
+static bool laneScope = false;
+static std::set<std::string> laneVar;
+
+static bool batchMode() {
+  return globalConfig.batchLanes > 1;
+}
+
+/* append the lane index to all state variables out of string literals */
+static std::string laneRewrite(const std::string& str) {
+  std::string ret;
+  size_t i = 0;
+  while (i < str.length()) {
+    char c = str[i];
+    size_t j = i + 1;
+    if (c == '"' || c == '\'') {
+      while (j < str.length() && str[j] != c) j += str[j] == '\\' ? 2 : 1;
+      j = MIN(j + 1, str.length());
+      ret += str.substr(i, j - i);
+    } else if (isalnum(c) || c == '_' || c == '$') {
+      while (j < str.length() && (isalnum(str[j]) || str[j] == '_' || str[j] == '$')) j ++;
+      std::string token = str.substr(i, j - i);
+      ret += token;
+      if (!isdigit(c) && laneVar.find(token) != laneVar.end()) ret += "[lane$]";
+    } else {
+      ret += c;
+    }
+    i = j;
+  }
+  return ret;
+}
+
+/* FNV-1a hash of the declarations of all state variables, checkpoints are only loaded by the same layout */
+static uint64_t layoutFingerprint = 0xcbf29ce484222325;
+
+static void fingerprintAdd(std::string str) {
+  for (char c : str) layoutFingerprint = (layoutFingerprint ^ (uint8_t)c) * 0x100000001b3;
+}
+
+static bool traceMode() {
+  return globalConfig.trace;
+}
+
+/* dispatch mode: superNodes are evaluated by their own functions, which are called for the set bits of active flags */
+static bool dispatchMode() {
+  return globalConfig.dispatch;
+}
+
+/*
+  summary bitmap: one bit per SUMMARY_REGION flag words, set together with the flags by every activation,
+  so that idle regions are skipped by a single test. Only used by the single-thread evaluation.
+*/
+#define SUMMARY_REGION 64
+
+static bool summaryMode() {
+  return !multiThread() && !dispatchMode() && activeFlagNum > SUMMARY_REGION;
+}
+
+static std::string summaryStr(int idx) {
+  int region = idx / SUMMARY_REGION;
+  return format("activeSummary[%d] |= 0x%lxUL;", region / 64, (uint64_t)1 << (region % 64));
+}
+
+static std::string summaryStr(int idx, std::string& cond) {
+  int region = idx / SUMMARY_REGION;
+  return format("activeSummary[%d] |= (uint64_t)(%s) << %d;", region / 64, cond.c_str(), region % 64);
+}
+
+/* cost profiling: every costProfile-th superNode is timed by the time-stamp counter */
+static bool costMode() {
+  return globalConfig.costProfile > 0;
+}
+
+static bool isCostProfiled(int cppId) {
+  return costMode() && cppId % globalConfig.costProfile == 0;
+}
+
+/* the profiled superNode being emitted, whose evaluations that activate any superNode are counted as valid */
+static int costSuper = -1;
 
 static bool isAlwaysActive(int cppId) {
   return alwaysActive.find(cppId) != alwaysActive.end();
@@ -68,12 +168,13 @@ ActiveType activeSet2bitMap(std::set<int>& activeId, std::map<uint64_t, ActiveTy
   uint64_t ret = 0;
   std::string comment = "";
   int uniqueIdx = 0;
+  if (workSteal()) curId = -1; // superNodes in the same word may be evaluated by other threads
   for (int id : activeId) {
     if (isAlwaysActive(id)) continue;
     int bitMapId;
     uint64_t bitMapMask;
     std::tie(bitMapId, bitMapMask) = setIdxMask(id);
-    int num = 64 / ACTIVE_WIDTH;
+    int num = multiThread() ? 1 : 64 / ACTIVE_WIDTH; // flags of different threads can not be merged
     if (curId >= 0 && id > curId && bitMapId == curId / ACTIVE_WIDTH) {
       if (ret == 0) uniqueIdx = id % ACTIVE_WIDTH;
       else uniqueIdx = -1;
@@ -107,15 +208,22 @@ ActiveType activeSet2bitMap(std::set<int>& activeId, std::map<uint64_t, ActiveTy
   return std::make_tuple(ret, comment, uniqueIdx);
 }
 
-std::string updateActiveStr(int idx, uint64_t mask) {
+static std::string updateFlagStr(int idx, uint64_t mask) {
+  if (multiThread()) return format("__atomic_fetch_or(&activeFlags[%d], 0x%lx, __ATOMIC_RELAXED);", idx, mask);
   if (mask <= MAX_U8) return format("activeFlags[%d] |= 0x%lx;", idx, mask);
   if (mask <= MAX_U16) return format("*(uint16_t*)&activeFlags[%d] |= 0x%lx;", idx, mask);
   if (mask <= MAX_U32) return format("*(uint32_t*)&activeFlags[%d] |= 0x%lx;", idx, mask);
   return format("*(uint64_t*)&activeFlags[%d] |= 0x%lx;", idx, mask);
 }
 
-std::string updateActiveStr(int idx, uint64_t mask, std::string& cond, int uniqueId) {
+std::string updateActiveStr(int idx, uint64_t mask) {
+  if (summaryMode()) return updateFlagStr(idx, mask) + " " + summaryStr(idx);
+  return updateFlagStr(idx, mask);
+}
+
+static std::string updateFlagStr(int idx, uint64_t mask, std::string& cond, int uniqueId) {
   auto activeFlags = std::string("activeFlags[") + std::to_string(idx) + std::string("]");
+  if (multiThread()) return format("if (%s) __atomic_fetch_or(&%s, 0x%lx, __ATOMIC_RELAXED);", cond.c_str(), activeFlags.c_str(), mask);
 
   if (mask <= MAX_U8) {
     if (uniqueId >= 0) return format("%s |= %s %s;", activeFlags.c_str(), cond.c_str(), shiftBits(uniqueId, ShiftDir::Left).c_str());
@@ -128,6 +236,11 @@ std::string updateActiveStr(int idx, uint64_t mask, std::string& cond, int uniqu
   return format("*(uint64_t*)&%s |= -(uint64_t)%s & 0x%lx;", activeFlags.c_str(), cond.c_str(), mask, activeFlags.c_str());
 }
 
+std::string updateActiveStr(int idx, uint64_t mask, std::string& cond, int uniqueId) {
+  if (summaryMode()) return updateFlagStr(idx, mask, cond, uniqueId) + " " + summaryStr(idx, cond);
+  return updateFlagStr(idx, mask, cond, uniqueId);
+}
+
 std::string strRepeat(std::string str, int times) {
   std::string ret;
   for (int i = 0; i < times; i ++) ret += str;
@@ -181,6 +294,296 @@ void graph::genNodeInit(Node* node, int mode) {
   }
 }
 
+/* Chase-Lev deque: the owner pushes and pops tasks at the bottom, other threads steal them from the top */
+static void genTaskDeque(FILE* header) {
+  int size = 1;
+  while (size < superId) size <<= 1;
+  fprintf(header, "#define TASK_DEQUE_SIZE %d\n", size);
+  fprintf(header, "struct TaskDeque {\n"
+                  "  alignas(64) std::atomic<int64_t> top;\n"
+                  "  alignas(64) std::atomic<int64_t> bottom;\n"
+                  "  std::atomic<int> buf[TASK_DEQUE_SIZE];\n"
+                  "  void push(int task) {\n"
+                  "    int64_t b = bottom.load(std::memory_order_relaxed);\n"
+                  "    buf[b & (TASK_DEQUE_SIZE - 1)].store(task, std::memory_order_relaxed);\n"
+                  "    std::atomic_thread_fence(std::memory_order_release);\n"
+                  "    bottom.store(b + 1, std::memory_order_relaxed);\n"
+                  "  }\n"
+                  "  int pop() {\n"
+                  "    int64_t b = bottom.load(std::memory_order_relaxed) - 1;\n"
+                  "    bottom.store(b, std::memory_order_relaxed);\n"
+                  "    std::atomic_thread_fence(std::memory_order_seq_cst);\n"
+                  "    int64_t t = top.load(std::memory_order_relaxed);\n"
+                  "    int task = -1;\n"
+                  "    if (t <= b) {\n"
+                  "      task = buf[b & (TASK_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);\n"
+                  "      if (t != b) return task;\n"
+                  "      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) task = -1;\n"
+                  "    }\n"
+                  "    bottom.store(b + 1, std::memory_order_relaxed);\n"
+                  "    return task;\n"
+                  "  }\n"
+                  "  int steal() {\n"
+                  "    int64_t t = top.load(std::memory_order_acquire);\n"
+                  "    std::atomic_thread_fence(std::memory_order_seq_cst);\n"
+                  "    int64_t b = bottom.load(std::memory_order_acquire);\n"
+                  "    if (t >= b) return -1;\n"
+                  "    int task = buf[t & (TASK_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);\n"
+                  "    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return -1;\n"
+                  "    return task;\n"
+                  "  }\n"
+                  "};\n\n");
+}
+
+/*
+  waveform tracing: values of signals written by superNodes evaluated in a cycle are staged and pushed into a ring buffer,
+  and a background thread writes the values changed since the last dump to a VCD file (piped through a forked gzip
+  for *.gz, so the path never goes through a shell)
+*/
+static void genTraceWriter(FILE* header) {
+  fprintf(header, "struct TraceSignal {\n"
+                  "  const void* addr;\n"
+                  "  int bytes;\n"
+                  "  int width;\n"
+                  "  const char* name;\n"
+                  "};\n"
+                  "#define TRACE_BUF_SIZE (1 << 22)\n"
+                  "struct TraceWriter {\n"
+                  "  std::vector<TraceSignal> sigs;\n"
+                  "  std::vector<char> enabled;\n"
+                  "  std::vector<uint64_t> shadow;\n"
+                  "  std::vector<size_t> shadowOffset;\n"
+                  "  std::vector<std::string> ids;\n"
+                  "  std::vector<uint64_t> buf;\n"
+                  "  std::vector<uint64_t> stage;\n"
+                  "  alignas(64) std::atomic<uint64_t> head;\n"
+                  "  alignas(64) std::atomic<uint64_t> tail;\n"
+                  "  std::atomic<bool> stop;\n"
+                  "  std::thread worker;\n"
+                  "  FILE* fp = NULL;\n"
+                  "  pid_t gzip = -1;\n"
+                  "  uint64_t begin, end;\n"
+                  "  static std::vector<std::string> scopeOf(const char* name) {\n"
+                  "    std::vector<std::string> ret(1);\n"
+                  "    for (const char* p = name; *p; p ++) {\n"
+                  "      if (p[0] == '$' && p[1] == '$') {\n"
+                  "        ret.back() += \"_\";\n"
+                  "        p ++;\n"
+                  "      } else if (p[0] == '$') {\n"
+                  "        ret.push_back(\"\");\n"
+                  "      } else {\n"
+                  "        ret.back() += *p;\n"
+                  "      }\n"
+                  "    }\n"
+                  "    return ret;\n"
+                  "  }\n"
+                  "  bool open(const char* path, uint64_t _begin, uint64_t _end, const char* scope) {\n"
+                  "    size_t len = strlen(path);\n"
+                  "    if (len > 3 && strcmp(path + len - 3, \".gz\") == 0) {\n"
+                  "      int file = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);\n"
+                  "      if (file < 0) return false;\n"
+                  "      int fds[2];\n"
+                  "      if (pipe(fds) != 0) {\n"
+                  "        ::close(file);\n"
+                  "        return false;\n"
+                  "      }\n"
+                  "      gzip = fork();\n"
+                  "      if (gzip == 0) {\n"
+                  "        dup2(fds[0], 0);\n"
+                  "        dup2(file, 1);\n"
+                  "        ::close(fds[0]);\n"
+                  "        ::close(fds[1]);\n"
+                  "        ::close(file);\n"
+                  "        execlp(\"gzip\", \"gzip\", \"-c\", (char*)NULL);\n"
+                  "        _exit(127);\n"
+                  "      }\n"
+                  "      ::close(fds[0]);\n"
+                  "      ::close(file);\n"
+                  "      if (gzip < 0) {\n"
+                  "        ::close(fds[1]);\n"
+                  "        return false;\n"
+                  "      }\n"
+                  "      fp = fdopen(fds[1], \"w\");\n"
+                  "    } else {\n"
+                  "      fp = fopen(path, \"w\");\n"
+                  "    }\n"
+                  "    if (fp == NULL) return false;\n"
+                  "    begin = _begin;\n"
+                  "    end = _end;\n"
+                  "    std::vector<std::pair<std::vector<std::string>, int>> order;\n"
+                  "    enabled.resize(sigs.size());\n"
+                  "    for (size_t i = 0; i < sigs.size(); i ++) {\n"
+                  "      shadowOffset.push_back(shadow.size());\n"
+                  "      shadow.resize(shadow.size() + (sigs[i].bytes + 7) / 8);\n"
+                  "      std::string id;\n"
+                  "      for (size_t n = i; ; n = n / 94 - 1) {\n"
+                  "        id += (char)('!' + n %% 94);\n"
+                  "        if (n < 94) break;\n"
+                  "      }\n"
+                  "      ids.push_back(id);\n"
+                  "      enabled[i] = strncmp(sigs[i].name, scope, strlen(scope)) == 0;\n"
+                  "      if (enabled[i]) order.push_back(std::make_pair(scopeOf(sigs[i].name), (int)i));\n"
+                  "    }\n"
+                  "    shadowOffset.push_back(shadow.size());\n"
+                  "    std::sort(order.begin(), order.end());\n"
+                  "    fprintf(fp, \"$timescale 1ns $end\\n\");\n"
+                  "    std::vector<std::string> stack;\n"
+                  "    for (auto& iter : order) {\n"
+                  "      std::vector<std::string>& path = iter.first;\n"
+                  "      size_t same = 0;\n"
+                  "      while (same < stack.size() && same + 1 < path.size() && stack[same] == path[same]) same ++;\n"
+                  "      for (; stack.size() > same; stack.pop_back()) fprintf(fp, \"$upscope $end\\n\");\n"
+                  "      for (; stack.size() + 1 < path.size(); stack.push_back(path[stack.size()])) fprintf(fp, \"$scope module %%s $end\\n\", path[stack.size()].c_str());\n"
+                  "      fprintf(fp, \"$var wire %%d %%s %%s $end\\n\", sigs[iter.second].width, ids[iter.second].c_str(), path.back().c_str());\n"
+                  "    }\n"
+                  "    for (; !stack.empty(); stack.pop_back()) fprintf(fp, \"$upscope $end\\n\");\n"
+                  "    fprintf(fp, \"$enddefinitions $end\\n\");\n"
+                  "    buf.resize(TRACE_BUF_SIZE);\n"
+                  "    head = 0;\n"
+                  "    tail = 0;\n"
+                  "    stop = false;\n"
+                  "    worker = std::thread(&TraceWriter::run, this);\n"
+                  "    return true;\n"
+                  "  }\n"
+                  "  void record(int sig) {\n"
+                  "    if (!enabled[sig]) return;\n"
+                  "    size_t pos = stage.size();\n"
+                  "    stage.resize(pos + 1 + (sigs[sig].bytes + 7) / 8);\n"
+                  "    stage[pos] = sig;\n"
+                  "    memcpy(&stage[pos + 1], sigs[sig].addr, sigs[sig].bytes);\n"
+                  "  }\n"
+                  "  /* move the staged values of a cycle into the ring buffer */\n"
+                  "  void commit(uint64_t cycle) {\n"
+                  "    uint64_t size = stage.size() + 2;\n"
+                  "    assert(size <= TRACE_BUF_SIZE);\n"
+                  "    uint64_t t = tail.load(std::memory_order_relaxed);\n"
+                  "    while (t + size - head.load(std::memory_order_acquire) > TRACE_BUF_SIZE) std::this_thread::yield();\n"
+                  "    buf[t %% TRACE_BUF_SIZE] = cycle;\n"
+                  "    buf[(t + 1) %% TRACE_BUF_SIZE] = stage.size();\n"
+                  "    for (size_t i = 0; i < stage.size(); i ++) buf[(t + 2 + i) %% TRACE_BUF_SIZE] = stage[i];\n"
+                  "    tail.store(t + size, std::memory_order_release);\n"
+                  "    stage.clear();\n"
+                  "  }\n"
+                  "  void dump(int sig) {\n"
+                  "    uint64_t* val = &shadow[shadowOffset[sig]];\n"
+                  "    if (sigs[sig].width == 1) {\n"
+                  "      fprintf(fp, \"%%c%%s\\n\", (val[0] & 1) ? '1' : '0', ids[sig].c_str());\n"
+                  "      return;\n"
+                  "    }\n"
+                  "    fputc('b', fp);\n"
+                  "    int bit = sigs[sig].width - 1;\n"
+                  "    while (bit > 0 && !((val[bit / 64] >> (bit %% 64)) & 1)) bit --;\n"
+                  "    for (; bit >= 0; bit --) fputc('0' + ((val[bit / 64] >> (bit %% 64)) & 1), fp);\n"
+                  "    fprintf(fp, \" %%s\\n\", ids[sig].c_str());\n"
+                  "  }\n"
+                  "  /* background thread: only values different from the last dumped ones are written */\n"
+                  "  void run() {\n"
+                  "    std::vector<char> dumped(sigs.size(), 0);\n"
+                  "    while (true) {\n"
+                  "      uint64_t h = head.load(std::memory_order_relaxed);\n"
+                  "      bool stopped = stop.load(std::memory_order_acquire);\n"
+                  "      uint64_t t = tail.load(std::memory_order_acquire);\n"
+                  "      if (h == t) {\n"
+                  "        if (stopped) break;\n"
+                  "        std::this_thread::sleep_for(std::chrono::microseconds(100));\n"
+                  "        continue;\n"
+                  "      }\n"
+                  "      while (h != t) {\n"
+                  "        uint64_t cycle = buf[h %% TRACE_BUF_SIZE];\n"
+                  "        uint64_t recordEnd = h + 2 + buf[(h + 1) %% TRACE_BUF_SIZE];\n"
+                  "        bool timed = false;\n"
+                  "        for (uint64_t p = h + 2; p < recordEnd; ) {\n"
+                  "          int sig = buf[p %% TRACE_BUF_SIZE];\n"
+                  "          p ++;\n"
+                  "          bool changed = !dumped[sig];\n"
+                  "          for (size_t i = shadowOffset[sig]; i < shadowOffset[sig + 1]; i ++, p ++) {\n"
+                  "            changed |= shadow[i] != buf[p %% TRACE_BUF_SIZE];\n"
+                  "            shadow[i] = buf[p %% TRACE_BUF_SIZE];\n"
+                  "          }\n"
+                  "          if (!changed) continue;\n"
+                  "          if (!timed) fprintf(fp, \"#%%lu\\n\", cycle);\n"
+                  "          timed = true;\n"
+                  "          dumped[sig] = 1;\n"
+                  "          dump(sig);\n"
+                  "        }\n"
+                  "        h = recordEnd;\n"
+                  "        head.store(h, std::memory_order_release);\n"
+                  "      }\n"
+                  "    }\n"
+                  "  }\n"
+                  "  void close() {\n"
+                  "    stop.store(true, std::memory_order_release);\n"
+                  "    worker.join();\n"
+                  "    fclose(fp);\n"
+                  "    if (gzip > 0) waitpid(gzip, NULL, 0);\n"
+                  "  }\n"
+                  "};\n");
+}
+
+/*
+  sparse memory: a page table of lazily mmapped pages, pages are only allocated by writes and unallocated
+  pages are read as zero. Checkpoints save the index and data of allocated pages.
+*/
+static void genSparseMem(FILE* header) {
+  fprintf(header, "template <typename T, uint64_t DEPTH, int PAGE_SHIFT>\n"
+                  "class SparseMem {\n"
+                  "  static const uint64_t PAGE_BYTES = (uint64_t)1 << PAGE_SHIFT;\n"
+                  "  static const uint64_t PAGE_ENTRIES = PAGE_BYTES / sizeof(T);\n"
+                  "  static const uint64_t PAGE_NUM = (DEPTH + PAGE_ENTRIES - 1) / PAGE_ENTRIES;\n"
+                  "  T* pages[PAGE_NUM] = {};\n"
+                  "  T* alloc(uint64_t page) {\n"
+                  "    void* p = mmap(NULL, PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);\n"
+                  "    gAssert(p != MAP_FAILED, \"failed to allocate a page of sparse memory\");\n"
+                  "#ifdef MADV_HUGEPAGE\n"
+                  "    if (PAGE_SHIFT >= 21) madvise(p, PAGE_BYTES, MADV_HUGEPAGE);\n"
+                  "#endif\n"
+                  "    return pages[page] = (T*)p;\n"
+                  "  }\n"
+                  "public:\n"
+                  "  ~SparseMem() { clear(); }\n"
+                  "  T read(uint64_t idx) const {\n"
+                  "    T* p = pages[idx / PAGE_ENTRIES];\n"
+                  "    return likely(p != NULL) ? p[idx %% PAGE_ENTRIES] : 0;\n"
+                  "  }\n"
+                  "  T& write(uint64_t idx) {\n"
+                  "    T* p = pages[idx / PAGE_ENTRIES];\n"
+                  "    if (unlikely(p == NULL)) p = alloc(idx / PAGE_ENTRIES);\n"
+                  "    return p[idx %% PAGE_ENTRIES];\n"
+                  "  }\n"
+                  "  void clear() {\n"
+                  "    for (uint64_t i = 0; i < PAGE_NUM; i ++) {\n"
+                  "      if (pages[i]) munmap(pages[i], PAGE_BYTES);\n"
+                  "      pages[i] = NULL;\n"
+                  "    }\n"
+                  "  }\n"
+                  "  /* copy an image into the memory from index 0 */\n"
+                  "  void load(const void* src, size_t size) {\n"
+                  "    const size_t pageData = PAGE_ENTRIES * sizeof(T);\n"
+                  "    for (uint64_t i = 0; i * pageData < size && i < PAGE_NUM; i ++) {\n"
+                  "      T* p = pages[i] ? pages[i] : alloc(i);\n"
+                  "      memcpy(p, (const char*)src + i * pageData, size - i * pageData < pageData ? size - i * pageData : pageData);\n"
+                  "    }\n"
+                  "  }\n"
+                  "  bool save(FILE* fp) const {\n"
+                  "    bool ok = true;\n"
+                  "    for (uint64_t i = 0; i < PAGE_NUM && ok; i ++) {\n"
+                  "      if (pages[i]) ok = fwrite(&i, sizeof(i), 1, fp) == 1 && fwrite(pages[i], PAGE_BYTES, 1, fp) == 1;\n"
+                  "    }\n"
+                  "    uint64_t end = PAGE_NUM;\n"
+                  "    return ok && fwrite(&end, sizeof(end), 1, fp) == 1;\n"
+                  "  }\n"
+                  "  bool restore(FILE* fp) {\n"
+                  "    clear();\n"
+                  "    uint64_t i;\n"
+                  "    while (fread(&i, sizeof(i), 1, fp) == 1) {\n"
+                  "      if (i == PAGE_NUM) return true;\n"
+                  "      if (i > PAGE_NUM || fread(alloc(i), PAGE_BYTES, 1, fp) != 1) return false;\n"
+                  "    }\n"
+                  "    return false;\n"
+                  "  }\n"
+                  "};\n");
+}
+
 FILE* graph::genHeaderStart() {
   FILE* header = std::fopen((globalConfig.OutputDir + "/" + name + ".h").c_str(), "w");
 
@@ -196,6 +599,22 @@ FILE* graph::genHeaderStart() {
   includeLib(header, "cstring", true);
   includeLib(header, "map", true);
   includeLib(header, "cstdarg", true);
+  bool sparseMem = std::any_of(memory.begin(), memory.end(), [](Node* mem) { return mem->isSparseMemory(); });
+  if (sparseMem) includeLib(header, "sys/mman.h", true);
+  if (multiThread() || traceMode()) {
+    includeLib(header, "thread", true);
+    includeLib(header, "atomic", true);
+  }
+  if (traceMode() || costMode()) {
+    includeLib(header, "string", true);
+    includeLib(header, "algorithm", true);
+    includeLib(header, "chrono", true);
+  }
+  if (traceMode()) {
+    includeLib(header, "fcntl.h", true);
+    includeLib(header, "unistd.h", true);
+    includeLib(header, "sys/wait.h", true);
+  }
   newLine(header);
 
   fprintf(header, "\n// User configuration\n");
@@ -218,7 +637,21 @@ FILE* graph::genHeaderStart() {
 
   fprintf(header, "#define likely(x) __builtin_expect(!!(x), 1)\n");
   fprintf(header, "#define unlikely(x) __builtin_expect(!!(x), 0)\n");
+  fprintf(header, "#define CHECKPOINT_MAGIC 0x54504b434d495347UL // \"GSIMCKPT\"\n");
   fprintf(header, "void gprintf(const char *fmt, ...);\n");
+  if (multiThread()) {
+    fprintf(header, "#define GSIM_THREADS %d\n", globalConfig.threadNum);
+    fprintf(header, "static inline void threadPause(int spin) {\n"
+                    "  if (spin >= 1024) std::this_thread::yield();\n"
+                    "#if defined(__x86_64__) || defined(__i386__)\n"
+                    "  else __builtin_ia32_pause();\n"
+                    "#endif\n"
+                    "}\n");
+  }
+  if (batchMode()) {
+    fprintf(header, "#define LANES %d\n", globalConfig.batchLanes);
+    fprintf(header, "#define LANE_LOOP _Pragma(\"clang loop vectorize(enable)\") for (int lane$ = 0; lane$ < LANES; lane$ ++)\n");
+  }
 
   for (int num = 2; num <= maxConcatNum; num ++) {
     std::string param;
@@ -233,17 +666,42 @@ FILE* graph::genHeaderStart() {
   }
   for (std::string str : extDecl) fprintf(header, "%s\n", str.c_str());
   newLine(header);
+  if (workSteal()) genTaskDeque(header);
+  if (traceMode()) {
+    fprintf(header, "#define GSIM_TRACE\n");
+    genTraceWriter(header);
+  }
+  if (costMode()) {
+    fprintf(header, "#define GSIM_COST_PROFILE\n"
+                    "#if defined(__x86_64__) || defined(__i386__)\n"
+                    "#include <x86intrin.h>\n"
+                    "#define COST_TICKS() __rdtsc()\n"
+                    "#else\n"
+                    "#define COST_TICKS() (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count()\n"
+                    "#endif\n");
+  }
+  if (sparseMem) {
+    fprintf(header, "#define GSIM_SPARSE_MEM\n");
+    genSparseMem(header);
+  }
   return header;
 }
 
+int graph::laneLoopBegin(int indent) {
+  if (!batchMode()) return indent;
+  emitBodyLock(indent, "LANE_LOOP {\n");
+  laneScope = true;
+  return indent + 1;
+}
+
+int graph::laneLoopEnd(int indent) {
+  if (!batchMode()) return indent;
+  laneScope = false;
+  emitBodyLock(indent - 1, "}\n");
+  return indent - 1;
+}
+
 void graph::genInterfaceInput(Node* input) {
-  /* set by string */
-  emitFuncDecl(0, "void S%s::set_%s(%s val) {\n", name.c_str(), input->name.c_str(), widthUType(input->width).c_str());
-  emitBodyLock(1, "if (%s != val) { \n", input->name.c_str());
-  emitBodyLock(2, "%s = val;\n", input->name.c_str());
-  for (std::string inst : input->insts) {
-    emitBodyLock(2, "%s\n", inst.c_str());
-  }
   /* update nodes in the same superNode */
   std::set<int> allNext;
   for (Node* next : input->next) {
@@ -251,11 +709,30 @@ void graph::genInterfaceInput(Node* input) {
   }
   std::map<uint64_t, ActiveType> bitMapInfo;
   activeSet2bitMap(allNext, bitMapInfo, -1);
-  for (auto iter : bitMapInfo) {
-    emitBodyLock(2, "%s // %s\n", updateActiveStr(iter.first, ACTIVE_MASK(iter.second)).c_str(), ACTIVE_COMMENT(iter.second).c_str());
-  }
-  emitBodyLock(1, "}\n");
+  auto genSetBody = [&](int indent) {
+    emitBodyLock(indent, "if (%s != val) { \n", input->name.c_str());
+    emitBodyLock(indent + 1, "%s = val;\n", input->name.c_str());
+    for (std::string inst : input->insts) {
+      emitBodyLock(indent + 1, "%s\n", inst.c_str());
+    }
+    for (auto iter : bitMapInfo) {
+      emitBodyLock(indent + 1, "%s // %s\n", updateActiveStr(iter.first, ACTIVE_MASK(iter.second)).c_str(), ACTIVE_COMMENT(iter.second).c_str());
+    }
+    emitBodyLock(indent, "}\n");
+  };
+  /* set by string, all lanes are set in batch mode */
+  emitFuncDecl(0, "void S%s::set_%s(%s val) {\n", name.c_str(), input->name.c_str(), widthUType(input->width).c_str());
+  int indent = laneLoopBegin(1);
+  genSetBody(indent);
+  laneLoopEnd(indent);
   emitBodyLock(0, "}\n");
+  if (batchMode()) {
+    emitFuncDecl(0, "void S%s::set_%s(int lane$, %s val) {\n", name.c_str(), input->name.c_str(), widthUType(input->width).c_str());
+    laneScope = true;
+    genSetBody(1);
+    laneScope = false;
+    emitBodyLock(0, "}\n");
+  }
 }
 
 void graph::genInterfaceOutput(Node* output) {
@@ -263,10 +740,17 @@ void graph::genInterfaceOutput(Node* output) {
   if (std::find(sortedSuper.begin(), sortedSuper.end(), output->super) == sortedSuper.end()) return;
   // TODO: constant output
   emitFuncDecl(0, "%s S%s::get_%s() {\n"
-               "  return %s;\n"
+               "  return %s%s;\n"
                "}\n",
                widthUType(output->width).c_str(), name.c_str(),
-               output->name.c_str(), output->name.c_str());
+               output->name.c_str(), output->name.c_str(), batchMode() ? "[0]" : "");
+  if (batchMode()) {
+    emitFuncDecl(0, "%s S%s::get_%s(int lane$) {\n"
+                 "  return %s[lane$];\n"
+                 "}\n",
+                 widthUType(output->width).c_str(), name.c_str(),
+                 output->name.c_str(), output->name.c_str());
+  }
 }
 
 void graph::genHeaderEnd(FILE* fp) {
@@ -390,8 +874,13 @@ void graph::genNodeDef(FILE* fp, Node* node) {
   if (definedNode.find(node) != definedNode.end()) return;
   definedNode.insert(node);
   fprintf(fp, "%s %s", widthUType(node->width).c_str(), node->name.c_str());
+  if (batchMode()) {
+    fprintf(fp, "[LANES]");
+    laneVar.insert(node->name);
+  }
   if (node->type == NODE_MEMORY) fprintf(fp, "[%d]", upperPower2(node->depth));
   for (int dim : node->dimension) fprintf(fp, "[%d]", upperPower2(dim));
+  fingerprintAdd(format("%s %s %d %d;", widthUType(node->width).c_str(), node->name.c_str(), node->type == NODE_MEMORY ? upperPower2(node->depth) : 0, node->arrayEntryNum()));
   fprintf(fp, "; // width = %d, lineno = %d\n", node->width, node->lineno);
   int w = node->width;
   bool needInitMask = (node->type != NODE_MEMORY) &&
@@ -414,7 +903,9 @@ void graph::genNodeDef(FILE* fp, Node* node) {
   /* save reset registers */
   if (node->isReset() && node->type == NODE_REG_SRC) {
     Assert(!node->isArray() && node->width <= BASIC_WIDTH, "%s is treated as reset (isArray: %d width: %d)", node->name.c_str(), node->isArray(), node->width);
-    fprintf(fp, "%s %s;\n", widthUType(node->width).c_str(), RESET_NAME(node).c_str());
+    fprintf(fp, "%s %s%s;\n", widthUType(node->width).c_str(), RESET_NAME(node).c_str(), batchMode() ? "[LANES]" : "");
+    fingerprintAdd(RESET_NAME(node) + ";");
+    if (batchMode()) laneVar.insert(RESET_NAME(node));
     if (needInitMask) {
       emitBodyLock(1, "%s = %s & %s;\n", RESET_NAME(node).c_str(), RESET_NAME(node).c_str(), bitMask(w).c_str());
     }
@@ -474,11 +965,11 @@ std::string activateNextStr(Node* node, std::set<int>& nextNodeId, std::string o
   #ifdef PERF
     #if ENABLE_ACTIVATOR
     for (int id : nextNodeId) {
-      fprintf(fp, "if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\nactivator[%d][%d] ++;\n",
+      ret += format("if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\nactivator[%d][%d] ++;\n",
                   id, node->super->cppId, id, id, node->super->cppId, id, node->super->cppId);
     }
     #endif
-    if (inStep) fprintf(fp, "isActivateValid = true;\n");
+    if (inStep) ret += "isActivateValid = true;\n";
   #endif
   }
   if (!opt) ret += "}\n";
@@ -496,11 +987,11 @@ static std::string activateUncondNextStr(Node* node, std::set<int>activateId, bo
 #ifdef PERF
   #if ENABLE_ACTIVATOR
   for (int id : activateId) {
-    fprintf(fp, "if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\n activator[%d][%d] ++;\n",
+    ret += format("if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\n activator[%d][%d] ++;\n",
                 id, node->super->cppId, id, id, node->super->cppId, id, node->super->cppId);
   }
   #endif
-  if (inStep) fprintf(fp, "isActivateValid = true;\n");
+  if (inStep) ret += "isActivateValid = true;\n";
 #endif
   return ret;
 }
@@ -548,13 +1039,17 @@ void graph::activateNext(Node* node, std::set<int>& nextNodeId, std::string oldN
   #ifdef PERF
     #if ENABLE_ACTIVATOR
     for (int id : nextNodeId) {
-      emitBodyLock("if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\nactivator[%d][%d] ++;\n",
+      emitBodyLock(indent, "if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\nactivator[%d][%d] ++;\n",
                   id, node->super->cppId, id, id, node->super->cppId, id, node->super->cppId);
     }
     #endif
-    if (inStep) emitBodyLock("isActivateValid = true;\n");
+    if (inStep) emitBodyLock(indent, "isActivateValid = true;\n");
   #endif
   }
+  if (costSuper >= 0) {
+    if (opt) emitBodyLock(indent, "costChanged%d |= %s;\n", costSuper, condName.c_str());
+    else emitBodyLock(indent, "costChanged%d = true;\n", costSuper);
+  }
   if (!opt) emitBodyLock(indent - 1, "}\n");
 }
 
@@ -565,14 +1060,15 @@ void graph::activateUncondNext(Node* node, std::set<int>activateId, bool inStep,
   for (auto iter : bitMapInfo) {
     emitBodyLock(indent, "%s // %s\n", updateActiveStr(iter.first, ACTIVE_MASK(iter.second)).c_str(), ACTIVE_COMMENT(iter.second).c_str());
   }
+  if (costSuper >= 0 && !activateId.empty()) emitBodyLock(indent, "costChanged%d = true;\n", costSuper);
 #ifdef PERF
   #if ENABLE_ACTIVATOR
   for (int id : activateId) {
-    emitBodyLock("if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\n activator[%d][%d] ++;\n",
+    emitBodyLock(indent, "if (activator[%d].find(%d) == activator[%d].end()) activator[%d][%d] = 0;\n activator[%d][%d] ++;\n",
                 id, node->super->cppId, id, id, node->super->cppId, id, node->super->cppId);
   }
   #endif
-  if (inStep) emitBodyLock("isActivateValid = true;\n");
+  if (inStep) emitBodyLock(indent, "isActivateValid = true;\n");
 #endif
 }
 
@@ -625,18 +1121,29 @@ void graph::genNodeInsts(Node* node, std::string flagName, int indent) { // TODO
   else activateUncondNext(node, node->nextNeedActivate, true, flagName, indent);
 }
 
+/* the active flag is not tested if flagName is empty */
 int graph::genNodeStepStart(SuperNode* node, uint64_t mask, int idx, std::string flagName, int indent) {
   nodeNum ++;
-  if (!isAlwaysActive(node->cppId)) {
+  if (globalConfig.srcMap) superSrcLines[node->cppId].push_back(std::make_tuple(srcFileIdx - 1, srcFileLine + 1, -1));
+  if (!isAlwaysActive(node->cppId) && !flagName.empty()) {
     emitBodyLock(indent, "if(unlikely(%s & 0x%lx)) { // id=%d\n", flagName.c_str(), mask, idx);
     indent ++;
   }
   int id;
   uint64_t newMask;
   std::tie(id, newMask) = clearIdxMask(node->cppId);
+  if (traceMode()) {
+    if (multiThread()) emitBodyLock(indent, "__atomic_fetch_or(&traceFlags[%d], 0x%lx, __ATOMIC_RELAXED);\n", id, mask);
+    else emitBodyLock(indent, "traceFlags[%d] |= 0x%lx;\n", id, mask);
+  }
+  if (isCostProfiled(node->cppId)) {
+    emitBodyLock(indent, "uint64_t costStart%d = COST_TICKS();\n", node->cppId);
+    emitBodyLock(indent, "bool costChanged%d = false;\n", node->cppId);
+    costSuper = node->cppId;
+  }
 #ifdef PERF
-  emitBodyLock("activeTimes[%d] ++;\n", node->cppId);
-  emitBodyLock("bool isActivateValid = false;\n");
+  emitBodyLock(indent, "activeTimes[%d] ++;\n", node->cppId);
+  emitBodyLock(indent, "bool isActivateValid = false;\n");
 #endif
   return indent;
 }
@@ -689,15 +1196,22 @@ void graph::nodeDisplay(Node* member, int indent) {
   emitBodyLock(indent, "#endif\n");
 }
 
-int graph::genNodeStepEnd(SuperNode* node, int indent) {
+int graph::genNodeStepEnd(SuperNode* node, int indent, bool tested) {
 #ifdef PERF
-  emitBodyLock("validActive[%d] += isActivateValid;\n", node->cppId);
+  emitBodyLock(indent, "validActive[%d] += isActivateValid;\n", node->cppId);
 #endif
+  if (isCostProfiled(node->cppId)) {
+    emitBodyLock(indent, "costTicks[%d] += COST_TICKS() - costStart%d;\n", node->cppId, node->cppId);
+    emitBodyLock(indent, "costCalls[%d] ++;\n", node->cppId);
+    emitBodyLock(indent, "costValid[%d] += costChanged%d;\n", node->cppId, node->cppId);
+    costSuper = -1;
+  }
 
-  if(!isAlwaysActive(node->cppId)) {
+  if(!isAlwaysActive(node->cppId) && tested) {
     emitBodyLock(indent, "}\n");
     indent --;
   }
+  if (globalConfig.srcMap) std::get<2>(superSrcLines[node->cppId].back()) = srcFileLine;
   return indent;
 }
 
@@ -736,6 +1250,53 @@ bool Node::isLocal() { // TODO: isArray is OK
   return status == VALID_NODE && type == NODE_OTHERS && !anyNextActive() && !isArray();
 }
 
+/* memories of at least sparseMemKB are backed by SparseMem, except memories of arrays and batched memories */
+bool Node::isSparseMemory() {
+  if (type != NODE_MEMORY || globalConfig.sparseMemKB <= 0 || !dimension.empty() || batchMode()) return false;
+  return (uint64_t)upperPower2(depth) * (widthBits(width) / 8) >= (uint64_t)globalConfig.sparseMemKB * 1024;
+}
+
+/*
+  ports of memories without arrays record the address of their last access in MEM_ADDR,
+  a writer only activates readers reading the written address.
+  Readers changing their address are activated by their address anyway.
+*/
+bool Node::isAddrTracked() {
+  if (type != NODE_MEMORY || !dimension.empty() || batchMode()) return false;
+  for (Node* port : member) {
+    if (port->type == NODE_READWRITER) return false;
+  }
+  return true;
+}
+
+/* memories of 1 GB or more use 2 MB pages to keep the page table small */
+static int sparsePageShift(Node* mem) {
+  return (uint64_t)upperPower2(mem->depth) * (widthBits(mem->width) / 8) >= ((uint64_t)1 << 30) ? 21 : 12;
+}
+
+/* activate the readers of the written address, readers without a recorded address are activated unconditionally */
+void graph::activateReaders(Node* writer, std::string flagName, int indent) {
+  std::map<int, std::vector<Node*>> readers;
+  for (Node* port : writer->parent->member) {
+    if (port->type != NODE_READER || port->status != VALID_NODE) continue;
+    if (writer->nextActiveId.find(port->super->cppId) != writer->nextActiveId.end()) readers[port->super->cppId].push_back(port);
+  }
+  std::set<int> uncondId;
+  for (int id : writer->nextActiveId) {
+    if (readers.find(id) == readers.end()) uncondId.insert(id);
+  }
+  if (!uncondId.empty()) activateUncondNext(writer, uncondId, false, flagName, indent);
+  for (auto iter : readers) {
+    std::string cond;
+    for (Node* reader : iter.second) {
+      cond += format("%s%s == %s", cond.empty() ? "" : " || ", MEM_ADDR(reader).c_str(), MEM_ADDR(writer).c_str());
+    }
+    emitBodyLock(indent, "if (%s) {\n", cond.c_str());
+    activateUncondNext(writer, std::set<int>{iter.first}, false, flagName, indent + 1);
+    emitBodyLock(indent, "}\n");
+  }
+}
+
 void graph::genSuperEval(SuperNode* super, std::string flagName, int indent) { // current indent = 2
   if (super->superType == SUPER_EXTMOD) { // TODO: normalize
     /* save old EXT_OUT*/
@@ -794,7 +1355,8 @@ void graph::genSuperEval(SuperNode* super, std::string flagName, int indent) { /
           break;
         case SUPER_INFO_ASSIGN_END:
           if (inst.node->isLocal() || !inst.node->needActivate()) break;
-          if (inst.node->isArray() || inst.node->type == NODE_WRITER) activateUncondNext(inst.node, inst.node->nextActiveId, false, flagName, indent);
+          if (inst.node->type == NODE_WRITER && inst.node->parent->isAddrTracked()) activateReaders(inst.node, flagName, indent);
+          else if (inst.node->isArray() || inst.node->type == NODE_WRITER) activateUncondNext(inst.node, inst.node->nextActiveId, false, flagName, indent);
           else activateNext(inst.node, inst.node->nextActiveId, oldName(inst.node), false, flagName, indent);
           break;
         default:
@@ -806,53 +1368,95 @@ void graph::genSuperEval(SuperNode* super, std::string flagName, int indent) { /
 }
 
 
-int graph::genActivate() {
-    emitFuncDecl(0, "void S%s::subStep0() {\n", name.c_str());
+int graph::genActivate(int tid) {
+    std::string funcName = multiThread() ? format("subStep%d_", tid) : "subStep";
+    emitFuncDecl(0, "void S%s::%s0() {\n", name.c_str(), funcName.c_str());
     int indent = 1;
     int nextSubStepIdx = 1;
-    std::string nextFuncDef = format("void S%s::subStep%d()", name.c_str(), nextSubStepIdx);
+    std::string nextFuncDef = format("void S%s::%s%d()", name.c_str(), funcName.c_str(), nextSubStepIdx);
     bool prevActiveWhole = false;
-    for (int idx = 0; idx < superId; idx ++) {
-      int id;
-      uint64_t mask;
-      std::tie(id, mask) = setIdxMask(idx);
-      int offset = idx % ACTIVE_WIDTH;
-      if (offset == 0) {
+    bool regionOpen = false;
+    size_t rangeIdx = 0;
+    for (int epoch = 0; epoch < epochNum; epoch ++) {
+      if (epoch != 0) { // wait for all threads to finish the previous epoch
         if (prevActiveWhole) {
           indent --;
           emitBodyLock(indent, "}\n");
+          prevActiveWhole = false;
         }
-        prevActiveWhole = true;
-        for (int j = 0; j < ACTIVE_WIDTH && idx + j < superId; j ++) {
-          if (isAlwaysActive(idx + j)) prevActiveWhole = false;
-        }
-        if (prevActiveWhole) {
-          bool newFile = __emitSrc(indent, true, false, nextFuncDef.c_str(), "if(unlikely(activeFlags[%d] != 0)) {\n", id);
-          indent ++;
-          if (newFile) {
-            nextFuncDef = format("void S%s::subStep%d()", name.c_str(), ++ nextSubStepIdx);
+        emitBodyLock(indent, "threadSync();\n");
+      }
+      for (; rangeIdx < threadRanges[tid].size() && RANGE_EPOCH(threadRanges[tid][rangeIdx]) == epoch; rangeIdx ++) {
+        int rangeEnd = RANGE_END(threadRanges[tid][rangeIdx]);
+        for (int idx = RANGE_BEG(threadRanges[tid][rangeIdx]); idx < rangeEnd; idx ++) {
+          int id;
+          uint64_t mask;
+          std::tie(id, mask) = setIdxMask(idx);
+          int offset = idx % ACTIVE_WIDTH;
+          if (offset == 0) {
+            if (prevActiveWhole) {
+              indent --;
+              emitBodyLock(indent, "}\n");
+            }
+            /* regions containing always active superNodes are not skipped */
+            if (summaryMode() && id % SUMMARY_REGION == 0) {
+              if (regionOpen) {
+                indent --;
+                emitBodyLock(indent, "}\n");
+              }
+              int region = id / SUMMARY_REGION;
+              regionOpen = true;
+              for (int j = 0; j < SUMMARY_REGION * ACTIVE_WIDTH && idx + j < rangeEnd; j ++) {
+                if (isAlwaysActive(idx + j)) regionOpen = false;
+              }
+              if (regionOpen) {
+                bool newFile = __emitSrc(indent, true, false, nextFuncDef.c_str(), "if(unlikely(activeSummary[%d] & 0x%lxUL)) {\n", region / 64, (uint64_t)1 << (region % 64));
+                indent ++;
+                if (newFile) {
+                  nextFuncDef = format("void S%s::%s%d()", name.c_str(), funcName.c_str(), ++ nextSubStepIdx);
+                }
+                emitBodyLock(indent, "activeSummary[%d] &= ~0x%lxUL;\n", region / 64, (uint64_t)1 << (region % 64));
+              }
+            }
+            prevActiveWhole = true;
+            for (int j = 0; j < ACTIVE_WIDTH && idx + j < rangeEnd; j ++) {
+              if (isAlwaysActive(idx + j)) prevActiveWhole = false;
+            }
+            if (prevActiveWhole) {
+              /* a new file can not start inside a region */
+              bool newFile = __emitSrc(indent, !regionOpen, false, nextFuncDef.c_str(), "if(unlikely(activeFlags[%d] != 0)) {\n", id);
+              indent ++;
+              if (newFile) {
+                nextFuncDef = format("void S%s::%s%d()", name.c_str(), funcName.c_str(), ++ nextSubStepIdx);
+              }
+              emitBodyLock(indent, "uint%d_t oldFlag = activeFlags[%d];\n", ACTIVE_WIDTH, id);
+              emitBodyLock(indent, "activeFlags[%d] = 0;\n", id);
+            }
           }
-          emitBodyLock(indent, "uint%d_t oldFlag = activeFlags[%d];\n", ACTIVE_WIDTH, id);
-          emitBodyLock(indent, "activeFlags[%d] = 0;\n", id);
+          if (cppId2Super.find(idx) == cppId2Super.end()) continue; // padding between threads
+          SuperNode* super = cppId2Super[idx];
+          std::string flagName = prevActiveWhole ? "oldFlag" : format("activeFlags[%d]", id);
+          indent = genNodeStepStart(super, mask, idx, flagName, indent);
+          indent = laneLoopBegin(indent);
+          genSuperEval(super, flagName, indent);
+          indent = laneLoopEnd(indent);
+          indent = genNodeStepEnd(super, indent);
         }
       }
-      SuperNode* super = cppId2Super[idx];
-      std::string flagName = prevActiveWhole ? "oldFlag" : format("activeFlags[%d]", id);
-      indent = genNodeStepStart(super, mask, idx, flagName, indent);
-      genSuperEval(super, flagName, indent);
-      indent = genNodeStepEnd(super, indent);
     }
     indent --;
     emitBodyLock(indent, "}\n");
     if (prevActiveWhole) emitBodyLock(indent, "}\n");
+    if (regionOpen) emitBodyLock(indent, "}\n");
 
     return nextSubStepIdx - 1; // return the maxinum subStepIdx currently used
 }
 
 void graph::genResetDef(SuperNode* super, bool isUIntReset, int indent) {
-  emitBodyLock(indent, "void S%s::subReset%d(){\n", name.c_str(), resetFuncNum);
+  emitBodyLock(indent, "void S%s::subReset%d(%s){\n", name.c_str(), resetFuncNum, batchMode() ? "int lane$" : "");
   indent ++;
   resetFuncNum ++;
+  laneScope = batchMode();
   if (isUIntReset) {
     for (Node* node : super->member) {
       for (std::string str : node->resetInsts) {
@@ -873,6 +1477,7 @@ void graph::genResetDef(SuperNode* super, bool isUIntReset, int indent) {
       }
     }
   }
+  laneScope = false;
   indent --;
   emitBodyLock(indent, "}\n");
 }
@@ -902,7 +1507,8 @@ void graph::genResetActivation(SuperNode* super, bool isUIntReset, int indent, i
       emitBodyLock(indent, "%s // %s\n", updateActiveStr(iter.first, ACTIVE_MASK(iter.second)).c_str(), ACTIVE_COMMENT(iter.second).c_str());
     }
   }
-  emitBodyLock(indent, "subReset%d();\n", resetId);
+  if (traceMode()) emitBodyLock(indent, "traceAll = true;\n");
+  emitBodyLock(indent, "subReset%d(%s);\n", resetId, batchMode() ? "lane$" : "");
   indent --;
   emitBodyLock(indent, "}\n");
 }
@@ -926,9 +1532,11 @@ void graph::genResetAll() {
   }
 
   emitFuncDecl(0, "void S%s::resetAll(){\n", name.c_str());
+  int indent = laneLoopBegin(1);
   for (size_t i = 0; i < resetSuper.size(); i ++) {
-    genResetActivation(resetSuper[i], true, 1, i);
+    genResetActivation(resetSuper[i], true, indent, i);
   }
+  laneLoopEnd(indent);
   emitBodyLock(0, "}\n");
 }
 
@@ -960,25 +1568,532 @@ void graph::saveDiffRegs() {
 #endif
 }
 
-void graph::genStep(int subStepIdxMax) {
+void graph::genStep(std::vector<int>& subStepIdxMax) {
   emitFuncDecl(0, "void S%s::step() {\n", name.c_str());
 
+  int indent = laneLoopBegin(1);
   for (SuperNode* super : sortedSuper) {
     for (Node* member : super->member) {
       if (member->isReset() && member->type == NODE_REG_SRC) {
-        emitBodyLock(1, "%s = %s;\n", RESET_NAME(member).c_str(), member->name.c_str());
+        emitBodyLock(indent, "%s = %s;\n", RESET_NAME(member).c_str(), member->name.c_str());
       }
     }
   }
+  laneLoopEnd(indent);
 #if defined(DIFFTEST_PER_SIG) && defined(VERILATOR_DIFF)
   emitBodyLock(1, "saveDiffRegs();\n");
 #endif
-  for (int i = 0; i <= subStepIdxMax; i ++) {
-    emitBodyLock(1, "subStep%d();\n", i);
+  std::string funcName = multiThread() ? "subStep0_" : "subStep";
+  if (workSteal()) emitBodyLock(1, "pendingSink.store(%d, std::memory_order_relaxed);\n", taskSinkNum);
+  if (multiThread()) emitBodyLock(1, "threadSync(); // start all threads\n");
+  if (workSteal()) emitBodyLock(1, "taskLoop(0);\n");
+  else {
+    for (int i = 0; i <= subStepIdxMax[0]; i ++) {
+      emitBodyLock(1, "%s%d();\n", funcName.c_str(), i);
+    }
   }
+  if (multiThread()) emitBodyLock(1, "threadSync(); // wait for all threads\n");
   emitBodyLock(1, "resetAll();\n");
+  if (traceMode()) emitBodyLock(1, "if (tracer) traceCapture();\n");
   emitBodyLock(1, "cycles ++;\n");
   emitBodyLock(0, "}\n");
+
+  /*
+    quiescence: no superNode is active after a cycle and no input has changed since, so that all following
+    cycles only increase cycles. Always active superNodes are evaluated in every cycle and prevent it.
+  */
+  emitFuncDecl(0, "bool S%s::isQuiescent() {\n", name.c_str());
+  if (!alwaysActive.empty()) emitBodyLock(1, "return false;\n");
+  else if (superId == 0) emitBodyLock(1, "return true;\n");
+  else {
+    /* flags out of all superNodes may be set by activateAll() but are never cleared */
+    int wordNum, lastBits;
+    std::string words;
+    if (summaryMode()) {
+      int regionNum = (superId + SUMMARY_REGION * ACTIVE_WIDTH - 1) / (SUMMARY_REGION * ACTIVE_WIDTH);
+      wordNum = (regionNum + 63) / 64;
+      lastBits = regionNum % 64;
+      words = "activeSummary";
+    } else {
+      wordNum = (superId + 63) / 64;
+      lastBits = superId % 64;
+      words = "((const uint64_t*)activeFlags)";
+    }
+    uint64_t lastMask = lastBits == 0 ? (uint64_t)-1 : ((uint64_t)1 << lastBits) - 1;
+    emitBodyLock(1, "uint64_t flags = %s[%d] & 0x%lxUL;\n", words.c_str(), wordNum - 1, lastMask);
+    emitBodyLock(1, "for (int i = 0; i < %d; i ++) flags |= %s[i];\n", wordNum - 1, words.c_str());
+    emitBodyLock(1, "return flags == 0;\n");
+  }
+  emitBodyLock(0, "}\n");
+
+  /* evaluate n cycles, the remaining cycles are skipped once the model is quiescent */
+  emitFuncDecl(0, "uint64_t S%s::step(uint64_t n) {\n"
+               "  for (uint64_t i = 0; i < n; i ++) {\n"
+               "    if (isQuiescent()) {\n"
+               "      cycles += n - i;\n"
+               "      return n - i;\n"
+               "    }\n"
+               "    step();\n"
+               "  }\n"
+               "  return 0;\n"
+               "}\n", name.c_str());
+}
+
+/* sense-free spin barrier and the evaluation loop of worker threads, the main thread serves as thread 0 */
+void graph::genThreadRuntime(std::vector<int>& subStepIdxMax) {
+  emitFuncDecl(0, "void S%s::threadSync() {\n", name.c_str());
+  emitBodyLock(1, "uint32_t gen = syncGen.load(std::memory_order_relaxed);\n");
+  emitBodyLock(1, "if (syncCount.fetch_add(1, std::memory_order_acq_rel) == %d) {\n", globalConfig.threadNum - 1);
+  emitBodyLock(2, "syncCount.store(0, std::memory_order_relaxed);\n");
+  emitBodyLock(2, "syncGen.store(gen + 1, std::memory_order_release);\n");
+  emitBodyLock(1, "} else {\n");
+  emitBodyLock(2, "for (int spin = 0; syncGen.load(std::memory_order_acquire) == gen; spin ++) {\n");
+  emitBodyLock(3, "threadPause(spin);\n");
+  emitBodyLock(2, "}\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(0, "}\n");
+
+  emitFuncDecl(0, "void S%s::threadLoop(int tid) {\n", name.c_str());
+  emitBodyLock(1, "while (true) {\n");
+  emitBodyLock(2, "threadSync();\n");
+  emitBodyLock(2, "if (threadStop) return;\n");
+  if (workSteal()) emitBodyLock(2, "taskLoop(tid);\n");
+  else {
+    emitBodyLock(2, "switch (tid) {\n");
+    for (int tid = 1; tid < globalConfig.threadNum; tid ++) {
+      emitBodyLock(3, "case %d:\n", tid);
+      for (int i = 0; i <= subStepIdxMax[tid]; i ++) emitBodyLock(4, "subStep%d_%d();\n", tid, i);
+      emitBodyLock(4, "break;\n");
+    }
+    emitBodyLock(2, "}\n");
+  }
+  emitBodyLock(2, "threadSync();\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(0, "}\n");
+}
+
+static void emitIntArray(std::string& str, std::vector<int>& val) {
+  if (val.empty()) val.push_back(0);
+  for (size_t i = 0; i < val.size(); i ++) {
+    str += format(i % 16 == 0 ? "\n  %d," : " %d,", val[i]);
+  }
+  str += "\n};\n";
+}
+
+/*
+  dispatch mode: every superNode is evaluated by superN(), and subStep0() iterates the set bits of 64-bit
+  words of active flags in topological order, calling superNodes through a function-pointer table.
+  Flags set in the current word after the evaluated bit are merged into the scanned word, other flags
+  remain in activeFlags for the next cycle.
+*/
+void graph::genDispatch(FILE* header) {
+  int wordNum = activeFlagNum * ACTIVE_WIDTH / 64;
+  std::string always;
+  bool anyAlways = false;
+  for (int id = 0; id < superId; id ++) {
+    SuperNode* super = cppId2Super[id];
+    int flagIdx;
+    uint64_t mask;
+    std::tie(flagIdx, mask) = setIdxMask(id);
+    fprintf(header, "void super%d();\n", id);
+    emitFuncDecl(0, "void S%s::super%d() {\n", name.c_str(), id);
+    int indent = genNodeStepStart(super, mask, id, "", 1);
+    indent = laneLoopBegin(indent);
+    genSuperEval(super, format("activeFlags[%d]", flagIdx), indent);
+    indent = laneLoopEnd(indent);
+    genNodeStepEnd(super, indent, false);
+    emitBodyLock(0, "}\n");
+  }
+  fprintf(header, "void superNop() {}\n");
+  for (int i = 0; i < wordNum; i ++) {
+    uint64_t flag = 0;
+    for (int j = 0; j < 64; j ++) {
+      if (isAlwaysActive(i * 64 + j)) flag |= (uint64_t)1 << j;
+    }
+    anyAlways |= flag != 0;
+    always += format(i % 8 == 0 ? "\n  0x%lxUL," : " 0x%lxUL,", flag);
+  }
+
+  std::string tables = format("static void (S%s::* const superFunc[])() = {", name.c_str());
+  for (int id = 0; id < wordNum * 64; id ++) {
+    std::string func = id < superId ? format("super%d", id) : "superNop";
+    tables += format(id % 8 == 0 ? "\n  &S%s::%s," : " &S%s::%s,", name.c_str(), func.c_str());
+  }
+  tables += "\n};\n";
+  if (anyAlways) tables += format("static const uint64_t alwaysWords[] = {%s\n};\n", always.c_str());
+  emitFuncDecl(0, "%s", tables.c_str());
+
+  emitFuncDecl(0, "void S%s::subStep0() {\n", name.c_str());
+  emitBodyLock(1, "uint64_t* words = (uint64_t*)activeFlags;\n");
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) {\n", wordNum);
+  emitBodyLock(2, "uint64_t flags = words[i]%s;\n", anyAlways ? " | alwaysWords[i]" : "");
+  emitBodyLock(2, "if (likely(flags == 0)) continue;\n");
+  emitBodyLock(2, "words[i] = 0;\n");
+  emitBodyLock(2, "do {\n");
+  emitBodyLock(3, "int bit = __builtin_ctzll(flags);\n");
+  emitBodyLock(3, "flags &= flags - 1;\n");
+  emitBodyLock(3, "(this->*superFunc[i * 64 + bit])();\n");
+  emitBodyLock(3, "uint64_t next = words[i] & (~(uint64_t)1 << bit);\n");
+  emitBodyLock(3, "words[i] ^= next;\n");
+  emitBodyLock(3, "flags |= next;\n");
+  emitBodyLock(2, "} while (flags != 0);\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(0, "}\n");
+}
+
+/*
+  work-stealing runtime: every superNode is a task, which is ready when all its predecessors in the task graph have finished.
+  Ready tasks are pushed into the deque of the current thread if active, otherwise they finish immediately.
+*/
+void graph::genTaskRuntime(FILE* header) {
+  std::vector<int> depNum, succBeg, succ, root;
+  std::string always;
+  for (int id = 0; id < superId; id ++) {
+    SuperNode* super = cppId2Super[id];
+    int flagIdx;
+    uint64_t mask;
+    std::tie(flagIdx, mask) = setIdxMask(id);
+    fprintf(header, "void task%d();\n", id);
+    emitFuncDecl(0, "void S%s::task%d() {\n", name.c_str(), id);
+    if (!isAlwaysActive(id)) emitBodyLock(1, "uint%d_t oldFlag = __atomic_fetch_and(&activeFlags[%d], 0x%lx, __ATOMIC_RELAXED);\n", ACTIVE_WIDTH, flagIdx, ~mask & MAX_U8);
+    int indent = genNodeStepStart(super, mask, id, "oldFlag", 1);
+    genSuperEval(super, format("activeFlags[%d]", flagIdx), indent);
+    indent = genNodeStepEnd(super, indent);
+    emitBodyLock(0, "}\n");
+
+    depNum.push_back(super->taskDepNum);
+    succBeg.push_back(succ.size());
+    for (SuperNode* next : super->taskNext) succ.push_back(next->cppId);
+    if (super->taskDepNum == 0) root.push_back(id);
+    if (super->taskNext.empty()) taskSinkNum ++;
+  }
+  succBeg.push_back(succ.size());
+  for (int i = 0; i < activeFlagNum; i ++) {
+    uint64_t flag = 0;
+    for (int j = 0; j < ACTIVE_WIDTH; j ++) {
+      if (isAlwaysActive(i * ACTIVE_WIDTH + j)) flag |= (uint64_t)1 << j;
+    }
+    always += format(i % 16 == 0 ? "\n  0x%lx," : " 0x%lx,", flag);
+  }
+
+  std::string tables = format("static const int taskDepNum[] = {");
+  emitIntArray(tables, depNum);
+  tables += "static const int taskSuccBeg[] = {";
+  emitIntArray(tables, succBeg);
+  tables += "static const int taskSucc[] = {";
+  emitIntArray(tables, succ);
+  tables += "static const int taskRoot[] = {";
+  emitIntArray(tables, root);
+  tables += format("static const uint%d_t alwaysFlags[] = {%s\n};\n", ACTIVE_WIDTH, always.c_str());
+  tables += format("static void (S%s::* const taskFunc[])() = {", name.c_str());
+  for (int id = 0; id < superId; id ++) tables += format(id % 8 == 0 ? "\n  &S%s::task%d," : " &S%s::task%d,", name.c_str(), id);
+  tables += "\n};\n";
+  emitFuncDecl(0, "%s", tables.c_str());
+
+  emitBodyLock(0, "static inline bool taskActive(uint%d_t* activeFlags, int task) {\n", ACTIVE_WIDTH);
+  emitBodyLock(1, "int idx = task / %d;\n", ACTIVE_WIDTH);
+  emitBodyLock(1, "return ((__atomic_load_n(&activeFlags[idx], __ATOMIC_RELAXED) | alwaysFlags[idx]) >> (task %% %d)) & 1;\n", ACTIVE_WIDTH);
+  emitBodyLock(0, "}\n");
+
+  fprintf(header, "void taskInit();\n");
+  emitBodyLock(0, "void S%s::taskInit() {\n", name.c_str());
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) taskDepCount[i].store(taskDepNum[i], std::memory_order_relaxed);\n", superId);
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) {\n", globalConfig.threadNum);
+  emitBodyLock(2, "taskDeque[i].top = 0;\n");
+  emitBodyLock(2, "taskDeque[i].bottom = 0;\n");
+  emitBodyLock(2, "taskStack[i].reserve(%d);\n", superId);
+  emitBodyLock(1, "}\n");
+  emitBodyLock(0, "}\n");
+
+  fprintf(header, "void taskFinish(int tid, int task);\n");
+  emitBodyLock(0, "void S%s::taskFinish(int tid, int task) {\n", name.c_str());
+  emitBodyLock(1, "std::vector<int>& stack = taskStack[tid];\n");
+  emitBodyLock(1, "stack.push_back(task);\n");
+  emitBodyLock(1, "while (!stack.empty()) {\n");
+  emitBodyLock(2, "int cur = stack.back();\n");
+  emitBodyLock(2, "stack.pop_back();\n");
+  emitBodyLock(2, "if (taskSuccBeg[cur] == taskSuccBeg[cur + 1]) pendingSink.fetch_sub(1, std::memory_order_release);\n");
+  emitBodyLock(2, "for (int i = taskSuccBeg[cur]; i < taskSuccBeg[cur + 1]; i ++) {\n");
+  emitBodyLock(3, "int next = taskSucc[i];\n");
+  emitBodyLock(3, "if (taskDepCount[next].fetch_sub(1, std::memory_order_acq_rel) != 1) continue;\n");
+  emitBodyLock(3, "taskDepCount[next].store(taskDepNum[next], std::memory_order_relaxed); // for the next cycle\n");
+  emitBodyLock(3, "if (taskActive(activeFlags, next)) taskDeque[tid].push(next);\n");
+  emitBodyLock(3, "else stack.push_back(next);\n");
+  emitBodyLock(2, "}\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(0, "}\n");
+
+  fprintf(header, "void taskLoop(int tid);\n");
+  emitBodyLock(0, "void S%s::taskLoop(int tid) {\n", name.c_str());
+  emitBodyLock(1, "for (int i = tid; i < %ld; i += %d) {\n", root.size(), globalConfig.threadNum);
+  emitBodyLock(2, "if (taskActive(activeFlags, taskRoot[i])) taskDeque[tid].push(taskRoot[i]);\n");
+  emitBodyLock(2, "else taskFinish(tid, taskRoot[i]);\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(1, "for (int spin = 0; pendingSink.load(std::memory_order_acquire) != 0; ) {\n");
+  emitBodyLock(2, "int task = taskDeque[tid].pop();\n");
+  emitBodyLock(2, "for (int i = 1; task < 0 && i < %d; i ++) task = taskDeque[(tid + i) %% %d].steal();\n", globalConfig.threadNum, globalConfig.threadNum);
+  emitBodyLock(2, "if (task < 0) {\n");
+  emitBodyLock(3, "threadPause(spin ++);\n");
+  emitBodyLock(3, "continue;\n");
+  emitBodyLock(2, "}\n");
+  emitBodyLock(2, "spin = 0;\n");
+  emitBodyLock(2, "(this->*taskFunc[task])();\n");
+  emitBodyLock(2, "taskFinish(tid, task);\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(0, "}\n");
+}
+
+/*
+  checkpoint: cycles, activeFlags and all state variables in [_var_start, _var_end), which include memories.
+  The file starts with a magic number, the layout fingerprint, the size of the state variables and the size of
+  activeFlags. Allocated pages of sparse memories follow the state variables.
+  The fingerprint also covers the superNode of every flag, since models of the same state may number their
+  superNodes differently (--threads pads the range of every thread, --profile reorders them).
+*/
+void graph::genCheckpoint(FILE* header) {
+  fingerprintAdd(format("lanes %d", globalConfig.batchLanes));
+  fingerprintAdd(format("flags %d", activeFlagNum));
+  for (auto iter : cppId2Super) fingerprintAdd(format("%d %s;", iter.first, iter.second->member.empty() ? "" : iter.second->member[0]->name.c_str()));
+  std::string saveMem, restoreMem;
+  for (Node* mem : memory) {
+    if (!mem->isSparseMemory()) continue;
+    saveMem += format("  ok = ok && %s.save(fp);\n", mem->name.c_str());
+    restoreMem += format("  ok = ok && %s.restore(fp);\n", mem->name.c_str());
+  }
+  fprintf(header, "static const uint64_t layoutFingerprint = 0x%lxUL;\n", layoutFingerprint);
+  fprintf(header, "bool saveCheckpoint(const char* path);\n");
+  fprintf(header, "bool loadCheckpoint(const char* path);\n");
+  emitFuncDecl(0, "bool S%s::saveCheckpoint(const char* path) {\n"
+               "  FILE* fp = fopen(path, \"wb\");\n"
+               "  if (fp == NULL) return false;\n"
+               "  uint64_t info[5] = {CHECKPOINT_MAGIC, layoutFingerprint, (uint64_t)((char*)&_var_end - (char*)&_var_start), sizeof(activeFlags), cycles};\n"
+               "  bool ok = fwrite(info, sizeof(info), 1, fp) == 1 &&\n"
+               "            fwrite(activeFlags, sizeof(activeFlags), 1, fp) == 1 &&\n"
+               "            fwrite(&_var_start, info[2], 1, fp) == 1;\n"
+               "%s"
+               "  return fclose(fp) == 0 && ok;\n"
+               "}\n", name.c_str(), saveMem.c_str());
+  emitFuncDecl(0, "bool S%s::loadCheckpoint(const char* path) {\n"
+               "  FILE* fp = fopen(path, \"rb\");\n"
+               "  if (fp == NULL) return false;\n"
+               "  uint64_t info[5];\n"
+               "  bool ok = fread(info, sizeof(info), 1, fp) == 1 && info[0] == CHECKPOINT_MAGIC && info[1] == layoutFingerprint &&\n"
+               "            info[2] == (uint64_t)((char*)&_var_end - (char*)&_var_start) && info[3] == sizeof(activeFlags);\n"
+               "  if (!ok) fprintf(stderr, \"checkpoint %%s does not match the model\\n\", path);\n"
+               "  ok = ok && fread(activeFlags, sizeof(activeFlags), 1, fp) == 1 && fread(&_var_start, info[2], 1, fp) == 1;\n"
+               "%s"
+               "  if (ok) cycles = info[4];\n"
+               "%s"
+               "  fclose(fp);\n"
+               "  return ok;\n"
+               "}\n", name.c_str(), restoreMem.c_str(), (std::string(summaryMode() ? "  memset(activeSummary, 0xff, sizeof(activeSummary));\n" : "") +
+                                     (traceMode() ? "  traceAll = true;\n" : "")).c_str());
+}
+
+/*
+  signals written by a superNode are recorded when it is evaluated, signals written outside superNodes
+  (inputs) are recorded in every cycle, and all signals are recorded after reset or activateAll()
+*/
+void graph::genTraceRuntime(FILE* header) {
+  std::vector<Node*> sigs;
+  std::vector<std::vector<int>> superSig(superId);
+  std::vector<int> alwaysSig;
+  for (SuperNode* super : sortedSuper) {
+    for (Node* member : super->member) {
+      if (definedNode.find(member) == definedNode.end() || member->isArray()) continue;
+      Node* writer = member;
+      if (member->type == NODE_REG_SRC) writer = member->regSplit ? member->regUpdate : member->getDst();
+      int cppId = writer ? writer->super->cppId : -1;
+      if (cppId >= 0) superSig[cppId].push_back(sigs.size());
+      else alwaysSig.push_back(sigs.size());
+      sigs.push_back(member);
+    }
+  }
+  std::vector<int> superBeg, superSigFlat;
+  for (int id = 0; id < superId; id ++) {
+    superBeg.push_back(superSigFlat.size());
+    superSigFlat.insert(superSigFlat.end(), superSig[id].begin(), superSig[id].end());
+  }
+  superBeg.push_back(superSigFlat.size());
+  std::string tables = "static const int traceSuperBeg[] = {";
+  emitIntArray(tables, superBeg);
+  tables += "static const int traceSuperSig[] = {";
+  emitIntArray(tables, superSigFlat);
+  tables += "static const int traceAlwaysSig[] = {";
+  emitIntArray(tables, alwaysSig);
+  emitFuncDecl(0, "%s", tables.c_str());
+
+  fprintf(header, "bool traceOpen(const char* path, uint64_t begin = 0, uint64_t end = UINT64_MAX, const char* scope = \"\");\n");
+  emitBodyLock(0, "bool S%s::traceOpen(const char* path, uint64_t begin, uint64_t end, const char* scope) {\n", name.c_str());
+  emitBodyLock(1, "traceClose();\n");
+  emitBodyLock(1, "tracer = new TraceWriter();\n");
+  for (Node* sig : sigs) {
+    emitBodyLock(1, "tracer->sigs.push_back({&%s, sizeof(%s), %d, \"%s\"});\n", sig->name.c_str(), sig->name.c_str(), sig->width, sig->name.c_str());
+  }
+  emitBodyLock(1, "if (!tracer->open(path, begin, end, scope)) {\n");
+  emitBodyLock(2, "delete tracer;\n");
+  emitBodyLock(2, "tracer = NULL;\n");
+  emitBodyLock(2, "return false;\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(1, "traceAll = true;\n");
+  emitBodyLock(1, "return true;\n");
+  emitBodyLock(0, "}\n");
+
+  fprintf(header, "void traceClose();\n");
+  emitBodyLock(0, "void S%s::traceClose() {\n", name.c_str());
+  emitBodyLock(1, "if (tracer == NULL) return;\n");
+  emitBodyLock(1, "tracer->close();\n");
+  emitBodyLock(1, "delete tracer;\n");
+  emitBodyLock(1, "tracer = NULL;\n");
+  emitBodyLock(0, "}\n");
+
+  fprintf(header, "void traceCapture();\n");
+  emitBodyLock(0, "void S%s::traceCapture() {\n", name.c_str());
+  emitBodyLock(1, "if (cycles >= tracer->begin && cycles < tracer->end) {\n");
+  emitBodyLock(2, "if (traceAll) {\n");
+  emitBodyLock(3, "for (int i = 0; i < %ld; i ++) tracer->record(i);\n", sigs.size());
+  emitBodyLock(2, "} else {\n");
+  emitBodyLock(3, "for (int i = 0; i < %ld; i ++) tracer->record(traceAlwaysSig[i]);\n", alwaysSig.size());
+  emitBodyLock(3, "for (int i = 0; i < %d; i ++) {\n", activeFlagNum);
+  emitBodyLock(4, "for (uint%d_t flag = traceFlags[i]; flag != 0; flag &= flag - 1) {\n", ACTIVE_WIDTH);
+  emitBodyLock(5, "int id = i * %d + __builtin_ctz(flag);\n", ACTIVE_WIDTH);
+  emitBodyLock(5, "for (int j = traceSuperBeg[id]; j < traceSuperBeg[id + 1]; j ++) tracer->record(traceSuperSig[j]);\n");
+  emitBodyLock(4, "}\n");
+  emitBodyLock(3, "}\n");
+  emitBodyLock(2, "}\n");
+  emitBodyLock(2, "tracer->commit(cycles);\n");
+  emitBodyLock(2, "traceAll = false;\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(1, "memset(traceFlags, 0, sizeof(traceFlags));\n");
+  emitBodyLock(0, "}\n");
+}
+
+/*
+  cost profile: the ticks and evaluations of every profiled superNode, costDump() writes them sorted by the total ticks
+  with the names of the members. The ticks include the overhead of reading the counter, which is estimated in the dump.
+*/
+/* the valid members of the superNode numbered id, which key the activity of the superNode in --profile */
+static std::string memberNames(int id) {
+  std::string names;
+  if (cppId2Super.find(id) == cppId2Super.end()) return names;
+  for (Node* member : cppId2Super[id]->member) {
+    if (member->status != VALID_NODE) continue;
+    names += (names.empty() ? "" : " ") + member->name;
+  }
+  return names;
+}
+
+void graph::genCostProfile(FILE* header) {
+  std::string tables = "static const char* const costMembers[] = {";
+  for (int id = 0; id < superId; id ++) {
+    tables += format("\n  \"%s\",", isCostProfiled(id) ? memberNames(id).c_str() : "");
+  }
+  tables += "\n  \"\"\n};\n";
+  emitFuncDecl(0, "%s", tables.c_str());
+
+  fprintf(header, "void costReset();\n");
+  emitBodyLock(0, "void S%s::costReset() {\n", name.c_str());
+  emitBodyLock(1, "memset(costTicks, 0, sizeof(costTicks));\n");
+  emitBodyLock(1, "memset(costCalls, 0, sizeof(costCalls));\n");
+  emitBodyLock(1, "memset(costValid, 0, sizeof(costValid));\n");
+  emitBodyLock(0, "}\n");
+
+  fprintf(header, "bool costDump(const char* path);\n");
+  emitBodyLock(0, "bool S%s::costDump(const char* path) {\n", name.c_str());
+  emitBodyLock(1, "FILE* fp = fopen(path, \"w\");\n");
+  emitBodyLock(1, "if (fp == NULL) return false;\n");
+  emitBodyLock(1, "uint64_t overhead = UINT64_MAX;\n");
+  emitBodyLock(1, "for (int i = 0; i < 1000; i ++) {\n");
+  emitBodyLock(2, "uint64_t start = COST_TICKS();\n");
+  emitBodyLock(2, "overhead = std::min<uint64_t>(overhead, COST_TICKS() - start);\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(1, "std::vector<int> order;\n");
+  emitBodyLock(1, "uint64_t total = 0, calls = 0;\n");
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) {\n", superId);
+  emitBodyLock(2, "if (costCalls[i] == 0) continue;\n");
+  emitBodyLock(2, "order.push_back(i);\n");
+  emitBodyLock(2, "total += costTicks[i];\n");
+  emitBodyLock(2, "calls += costCalls[i];\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(1, "std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return costTicks[a] > costTicks[b]; });\n");
+  emitBodyLock(1, "fprintf(fp, \"# 1 in %d of %d superNodes, %%ld cycles, %%ld evaluations, %%ld ticks, about %%ld ticks of overhead per evaluation\\n\", cycles, calls, total, overhead);\n",
+               globalConfig.costProfile, superId);
+  emitBodyLock(1, "fprintf(fp, \"# cppId calls valid ticks meanTicks share members\\n\");\n");
+  emitBodyLock(1, "for (int id : order) {\n");
+  emitBodyLock(2, "fprintf(fp, \"%%d %%ld %%ld %%ld %%.1f %%.2f%%%% %%s\\n\", id, costCalls[id], costValid[id], costTicks[id], (double)costTicks[id] / costCalls[id],\n");
+  emitBodyLock(2, "        total == 0 ? 0.0 : 100.0 * costTicks[id] / total, costMembers[id]);\n");
+  emitBodyLock(1, "}\n");
+  emitBodyLock(1, "fclose(fp);\n");
+  emitBodyLock(1, "return true;\n");
+  emitBodyLock(0, "}\n");
+}
+
+/* the instance of a signal is the longest prefix separated by sep_module which is an instance */
+static std::string instanceOf(const std::string& nodeName, std::map<std::string, std::string>& instanceModule) {
+  const std::string& sepModule = globalConfig.sep_module;
+  const std::string& sepAggr = globalConfig.sep_aggr;
+  std::string ret;
+  size_t pos = 0;
+  while ((pos = nodeName.find(sepModule, pos)) != std::string::npos) {
+    if (nodeName.compare(pos, sepAggr.length(), sepAggr) == 0) {
+      pos += sepAggr.length();
+      continue;
+    }
+    std::string prefix = nodeName.substr(0, pos);
+    if (instanceModule.find(prefix) != instanceModule.end()) ret = prefix;
+    pos += sepModule.length();
+  }
+  return ret;
+}
+
+static std::string jsonStr(const std::string& str) {
+  std::string ret = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') ret += std::string("\\") + c;
+    else ret += c;
+  }
+  return ret + "\"";
+}
+
+/*
+  source map [dir]/[top].srcmap.json for attributing profiles of the emitted model back to the FIRRTL source:
+  the emitted lines of every superNode, and its members grouped by instance and line in the FIRRTL input
+*/
+void graph::genSrcMap() {
+  std::string path = globalConfig.OutputDir + "/" + name + ".srcmap.json";
+  FILE* fp = fopen(path.c_str(), "w");
+  Assert(fp, "can not open %s", path.c_str());
+  fprintf(fp, "{\n  \"top\": %s,\n  \"sepModule\": %s,\n  \"sepAggr\": %s,\n  \"files\": [", jsonStr(name).c_str(),
+          jsonStr(globalConfig.sep_module).c_str(), jsonStr(globalConfig.sep_aggr).c_str());
+  for (int i = 0; i < srcFileIdx; i ++) fprintf(fp, "%s%s", i ? ", " : "", jsonStr(format("%s%d.cpp", name.c_str(), i)).c_str());
+  fprintf(fp, "],\n  \"instances\": {");
+  bool first = true;
+  for (auto& iter : instanceModule) {
+    fprintf(fp, "%s\n    %s: %s", first ? "" : ",", jsonStr(iter.first).c_str(), jsonStr(iter.second).c_str());
+    first = false;
+  }
+  fprintf(fp, "\n  },\n  \"superNodes\": [");
+  first = true;
+  for (SuperNode* super : sortedSuper) {
+    if (super->cppId < 0) continue;
+    /* (instance, lineno) -> members */
+    std::map<std::pair<std::string, int>, int> src;
+    for (Node* member : super->member) {
+      if (member->status == VALID_NODE) src[std::make_pair(instanceOf(member->name, instanceModule), member->lineno)] ++;
+    }
+    std::string lines, members;
+    for (auto& range : superSrcLines[super->cppId]) {
+      lines += format("%s[%d, %d, %d]", lines.empty() ? "" : ", ", std::get<0>(range), std::get<1>(range), std::get<2>(range));
+    }
+    for (auto& iter : src) {
+      members += format("%s[%s, %d, %d]", members.empty() ? "" : ", ", jsonStr(iter.first.first).c_str(), iter.first.second, iter.second);
+    }
+    fprintf(fp, "%s\n    {\"id\": %d, \"lines\": [%s], \"members\": [%s]}", first ? "" : ",", super->cppId, lines.c_str(), members.c_str());
+    first = false;
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  fclose(fp);
+  printStat("[cppEmitter] source map of %d superNodes to %s\n", superId, path.c_str());
 }
 
 bool SuperNode::instsEmpty() {
@@ -996,18 +2111,27 @@ bool graph::__emitSrc(int indent, bool canNewFile, bool alreadyEndFunc, const ch
     srcFileIdx ++;
     assert(srcFp != NULL);
     srcFileBytes = fprintf(srcFp, "#include \"%s.h\"\n", name.c_str());
+    srcFileLine = 1;
     if (nextFuncDef != NULL) {
       srcFileBytes += fprintf(srcFp, "%s {\n", nextFuncDef);
+      srcFileLine ++;
     }
     newFile = true;
   }
   for (int i = 0; i < indent; i ++) fprintf(srcFp, "  ");
   va_list args;
   va_start(args, fmt);
-  int bytes = vfprintf(srcFp, fmt, args);
-  assert(bytes > 0);
+  va_list argsCopy;
+  va_copy(argsCopy, args);
+  std::string str(vsnprintf(NULL, 0, fmt, argsCopy), '\0');
+  va_end(argsCopy);
+  vsnprintf(&str[0], str.length() + 1, fmt, args);
   va_end(args);
+  if (laneScope) str = laneRewrite(str);
+  int bytes = fprintf(srcFp, "%s", str.c_str());
+  assert(bytes > 0);
   srcFileBytes += bytes;
+  srcFileLine += std::count(str.begin(), str.end(), '\n');
   return newFile;
 }
 
@@ -1044,21 +2168,175 @@ void graph::emitPrintf() {
   );
 }
 
-void graph::cppEmitter() {
-  for (SuperNode* super : sortedSuper) {
-    if (!super->instsEmpty() || super->superType == SUPER_EXTMOD) {
-      super->cppId = superId ++;
-      cppId2Super[super->cppId] = super;
-      if (super->superType == SUPER_EXTMOD) {
-        alwaysActive.insert(super->cppId);
+static double superRate(SuperNode* super) {
+  double rate = -1;
+  for (Node* member : super->member) {
+    NodeActivity* activity = nodeActivity(member);
+    if (activity) rate = MAX(rate, activity->rate());
+  }
+  return rate;
+}
+
+/*
+  hot superNodes (--profile): superNodes activated in more than --always-active of the profiled cycles are always
+  active if checking and storing their activations costs more than their idle evaluations. Their flags are never
+  tested or cleared, no superNode activates them, and nodes only read by them skip the change detection.
+  Printf and assert are still evaluated only when activated.
+*/
+#define ALWAYS_CHECK_COST 2.0 // the cost of an activation check or store, in evaluations of nodes
+
+static bool isHot(SuperNode* super) {
+  if (!hasProfile() || super->superType != SUPER_VALID) return false;
+  double rate = superRate(super);
+  if (rate <= globalConfig.alwaysActiveRate) return false;
+  int ops = 0;
+  for (Node* member : super->member) {
+    if (member->type == NODE_SPECIAL) return false;
+    ops += member->ops;
+  }
+  return (1 - MIN(rate, 1.0)) * ops < ALWAYS_CHECK_COST * (1 + super->prev.size());
+}
+
+static bool alwaysEvaluated(SuperNode* super) {
+  return super->superType == SUPER_EXTMOD || isHot(super);
+}
+
+static void setCppId(SuperNode* super) {
+  super->cppId = superId ++;
+  cppId2Super[super->cppId] = super;
+  if (alwaysEvaluated(super)) alwaysActive.insert(super->cppId);
+}
+
+/*
+  activity order (--profile): superNodes are numbered in a topological order that groups superNodes of similar
+  activation rates into the same words of activeFlags, so that the words of rarely activated superNodes are
+  usually zero and skipped as a whole. The relative order of superNodes ordered by orderDepend (the dependencies
+  used by threadPartition) is kept.
+*/
+#define ACTIVITY_LEVELS 15
+static double prevActiveWords = 0, sortedActiveWords = 0;
+
+/*
+  0 for never activated, then by the power of two of the rate, then always active superNodes, which share words
+  that are never skipped, and the last level for superNodes without profile
+*/
+static int activityLevel(SuperNode* super) {
+  if (alwaysEvaluated(super)) return ACTIVITY_LEVELS - 2;
+  double rate = superRate(super);
+  if (rate < 0) return ACTIVITY_LEVELS - 1;
+  if (rate == 0) return 0;
+  return MIN(ACTIVITY_LEVELS - 3, MAX(1, (int)floor(log2(rate)) + ACTIVITY_LEVELS - 3));
+}
+
+/* the expected number of non-zero words in a cycle, assuming independent activations */
+static double activeWords(std::vector<SuperNode*>& supers) {
+  double ret = 0;
+  for (size_t beg = 0; beg < supers.size(); beg += ACTIVE_WIDTH) {
+    double idle = 1;
+    for (size_t i = beg; i < MIN(beg + ACTIVE_WIDTH, supers.size()); i ++) idle *= alwaysEvaluated(supers[i]) ? 0 : 1 - MAX(superRate(supers[i]), 0.0);
+    ret += 1 - idle;
+  }
+  return ret;
+}
+
+static void activityOrder(std::vector<SuperNode*>& supers, std::map<SuperNode*, std::set<SuperNode*>>& depend) {
+  std::map<SuperNode*, int> pos;
+  for (size_t i = 0; i < supers.size(); i ++) pos[supers[i]] = i;
+  std::vector<std::set<int>> succ(supers.size());
+  std::vector<int> depNum(supers.size(), 0);
+  for (size_t i = 0; i < supers.size(); i ++) {
+    for (SuperNode* dep : depend[supers[i]]) {
+      auto iter = pos.find(dep);
+      if (iter == pos.end() || iter->second >= (int)i) continue;
+      if (succ[iter->second].insert(i).second) depNum[i] ++;
+    }
+  }
+  std::vector<std::priority_queue<int, std::vector<int>, std::greater<int>>> ready(ACTIVITY_LEVELS);
+  std::vector<int> level(supers.size());
+  std::vector<size_t> remain(ACTIVITY_LEVELS, 0);
+  for (size_t i = 0; i < supers.size(); i ++) {
+    level[i] = activityLevel(supers[i]);
+    remain[level[i]] ++;
+    if (depNum[i] == 0) ready[level[i]].push(i);
+  }
+  prevActiveWords += activeWords(supers);
+  std::vector<SuperNode*> sorted;
+  int cur = 0;
+  while (sorted.size() < supers.size()) {
+    if (sorted.size() % ACTIVE_WIDTH == 0) {
+      /* a new word starts with the first ready superNode of a level which fills the word, or whose superNodes are all
+         ready; otherwise of the level with the most superNodes left, so that the other levels gather more ready ones */
+      int first = INT_MAX;
+      for (int l = 0; l < ACTIVITY_LEVELS; l ++) {
+        if ((ready[l].size() >= ACTIVE_WIDTH || (!ready[l].empty() && ready[l].size() == remain[l])) && ready[l].top() < first) {
+          first = ready[l].top();
+          cur = l;
+        }
       }
-#if 0
-      if (super->member.size() == 1 && super->member[0]->ops < 1) {
-        alwaysActive.insert(super->cppId);
-        printf("alwaysActive %d\n", super->cppId);
+      if (first == INT_MAX) {
+        size_t most = 0;
+        for (int l = 0; l < ACTIVITY_LEVELS; l ++) {
+          if (!ready[l].empty() && remain[l] > most) {
+            most = remain[l];
+            cur = l;
+          }
+        }
+      }
+    } else if (ready[cur].empty()) {
+      /* fill the word with superNodes of the nearest level */
+      for (int dist = 1; dist < ACTIVITY_LEVELS; dist ++) {
+        if (cur - dist >= 0 && !ready[cur - dist].empty()) { cur -= dist; break; }
+        if (cur + dist < ACTIVITY_LEVELS && !ready[cur + dist].empty()) { cur += dist; break; }
+      }
+    }
+    Assert(!ready[cur].empty(), "no ready superNode");
+    int idx = ready[cur].top();
+    ready[cur].pop();
+    remain[cur] --;
+    sorted.push_back(supers[idx]);
+    for (int next : succ[idx]) {
+      if (-- depNum[next] == 0) ready[level[next]].push(next);
+    }
+  }
+  supers.swap(sorted);
+  sortedActiveWords += activeWords(supers);
+}
+
+void graph::cppEmitter() {
+  Assert(!batchMode() || !multiThread(), "batch mode can not be combined with multi-thread evaluation");
+  Assert(!batchMode() || !traceMode(), "batch mode can not be combined with tracing");
+  Assert(!dispatchMode() || !multiThread(), "dispatch mode can not be combined with multi-thread evaluation");
+  threadRanges.resize(globalConfig.threadNum);
+  std::map<SuperNode*, std::set<SuperNode*>> depend;
+  if (hasProfile()) orderDepend(depend);
+  if (multiThread()) {
+    /* superNodes evaluated by the same thread in the same epoch occupy individual flags */
+    std::map<std::pair<int, int>, std::vector<SuperNode*>> threadSuper;
+    for (SuperNode* super : sortedSuper) {
+      if (!super->instsEmpty() || super->superType == SUPER_EXTMOD) {
+        threadSuper[std::make_pair(super->epoch, super->threadId)].push_back(super);
+        epochNum = MAX(epochNum, super->epoch + 1);
       }
-#endif
     }
+    for (auto iter : threadSuper) {
+      if (hasProfile()) activityOrder(iter.second, depend);
+      int beg = superId;
+      for (SuperNode* super : iter.second) setCppId(super);
+      if (!workSteal()) superId = ROUNDUP(superId, ACTIVE_WIDTH); // all superNodes form a single group in work-stealing mode
+      threadRanges[iter.first.second].push_back(std::make_tuple(iter.first.first, beg, superId));
+    }
+  } else {
+    std::vector<SuperNode*> supers;
+    for (SuperNode* super : sortedSuper) {
+      if (!super->instsEmpty() || super->superType == SUPER_EXTMOD) supers.push_back(super);
+    }
+    if (hasProfile()) activityOrder(supers, depend);
+    for (SuperNode* super : supers) setCppId(super);
+    threadRanges[0].push_back(std::make_tuple(0, 0, superId));
+  }
+  if (hasProfile()) {
+    printStat("[cppEmitter] activity order: %.1f -> %.1f expected active flag words per cycle\n", prevActiveWords, sortedActiveWords);
+    printStat("[cppEmitter] %ld always active superNodes\n", alwaysActive.size());
   }
   activeFlagNum = (superId + ACTIVE_WIDTH - 1) / ACTIVE_WIDTH;
   // avoid buffer overflow when accessing the last elements as uint64_t
@@ -1085,7 +2363,30 @@ void graph::cppEmitter() {
   fprintf(header, "class S%s {\npublic:\n", name.c_str());
   fprintf(header, "uint64_t cycles;\n");
   fprintf(header, "uint64_t LOG_START, LOG_END;\n");
-  fprintf(header, "uint%d_t activeFlags[%d];\n", ACTIVE_WIDTH, activeFlagNum); // or super.size() if id == idx
+  fprintf(header, "%suint%d_t activeFlags[%d];\n", multiThread() ? "alignas(64) " : "", ACTIVE_WIDTH, activeFlagNum); // or super.size() if id == idx
+  if (multiThread()) {
+    fprintf(header, "alignas(64) std::atomic<uint32_t> syncCount;\n");
+    fprintf(header, "alignas(64) std::atomic<uint32_t> syncGen;\n");
+    fprintf(header, "bool threadStop;\n");
+    fprintf(header, "std::vector<std::thread> threads;\n");
+  }
+  if (summaryMode()) fprintf(header, "uint64_t activeSummary[%d];\n", (activeFlagNum / SUMMARY_REGION + 64) / 64);
+  if (traceMode()) {
+    fprintf(header, "%suint%d_t traceFlags[%d];\n", multiThread() ? "alignas(64) " : "", ACTIVE_WIDTH, activeFlagNum);
+    fprintf(header, "bool traceAll;\n");
+    fprintf(header, "TraceWriter* tracer;\n");
+  }
+  if (costMode()) {
+    fprintf(header, "uint64_t costTicks[%d];\n", MAX(superId, 1));
+    fprintf(header, "uint64_t costCalls[%d];\n", MAX(superId, 1));
+    fprintf(header, "uint64_t costValid[%d];\n", MAX(superId, 1));
+  }
+  if (workSteal()) {
+    fprintf(header, "TaskDeque taskDeque[%d];\n", globalConfig.threadNum);
+    fprintf(header, "std::vector<int> taskStack[%d];\n", globalConfig.threadNum);
+    fprintf(header, "std::atomic<int> taskDepCount[%d];\n", MAX(superId, 1));
+    fprintf(header, "alignas(64) std::atomic<int> pendingSink;\n");
+  }
 #ifdef PERF
   fprintf(header, "size_t activeTimes[%d];\n", superId);
 #if ENABLE_ACTIVATOR
@@ -1093,6 +2394,12 @@ void graph::cppEmitter() {
 #endif
   fprintf(header, "size_t validActive[%d];\n", superId);
   fprintf(header, "size_t nodeNum[%d];\n", superId);
+  /* written to ACTIVE_FILE by the emulator, which --profile reads */
+  fprintf(header, "static const char* const activeMembers[%d];\n", superId);
+  std::string members = format("const char* const S%s::activeMembers[%d] = {", name.c_str(), superId);
+  for (int id = 0; id < superId; id ++) members += format("\n  \"%s\",", memberNames(id).c_str());
+  members += "\n};\n";
+  emitFuncDecl(0, "%s", members.c_str());
 #endif
   emitPrintf();
   /* constrcutor */
@@ -1100,16 +2407,38 @@ void graph::cppEmitter() {
                "  cycles = 0;\n"
                "  LOG_START = 1;\n"
                "  LOG_END = 0;\n"
-               "  init();\n"
-               "}\n", name.c_str(), name.c_str());
+               "  init();\n", name.c_str(), name.c_str());
+  if (traceMode()) {
+    emitBodyLock(1, "memset(traceFlags, 0, sizeof(traceFlags));\n");
+    emitBodyLock(1, "tracer = NULL;\n");
+  }
+  if (costMode()) emitBodyLock(1, "costReset();\n");
+  if (multiThread()) {
+    emitBodyLock(1, "syncCount = 0;\n");
+    emitBodyLock(1, "syncGen = 0;\n");
+    emitBodyLock(1, "threadStop = false;\n");
+    if (workSteal()) emitBodyLock(1, "taskInit();\n");
+    emitBodyLock(1, "for (int i = 1; i < %d; i ++) threads.emplace_back(&S%s::threadLoop, this, i);\n", globalConfig.threadNum, name.c_str());
+  }
+  emitBodyLock(0, "}\n");
+  if (multiThread() || traceMode()) {
+    emitFuncDecl(0, "S%s::~S%s() {\n", name.c_str(), name.c_str());
+    if (traceMode()) emitBodyLock(1, "traceClose();\n");
+    if (multiThread()) {
+      emitBodyLock(1, "threadStop = true;\n");
+      emitBodyLock(1, "threadSync();\n");
+      emitBodyLock(1, "for (std::thread& t : threads) t.join();\n");
+    }
+    emitBodyLock(0, "}\n");
+  }
 
   /* initialization */
   emitFuncDecl(0, "void S%s::init() {\n", name.c_str());
   emitBodyLock(1, "activateAll();\n");
 #ifdef PERF
-  emitBodyLock("  for (int i = 0; i < %d; i ++) activeTimes[i] = 0;\n", superId);
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) activeTimes[i] = 0;\n", superId);
   #if ENABLE_ACTIVATOR
-  emitBodyLock("  for (int i = 0; i < %d; i ++) activator[i] = std::map<int, int>();\n", superId);
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) activator[i] = std::map<int, int>();\n", superId);
   #endif
   for (SuperNode* super : sortedSuper) {
     if (super->cppId >= 0) {
@@ -1117,10 +2446,10 @@ void graph::cppEmitter() {
       for (Node* member : super->member) {
         if (member->anyNextActive()) num ++;
       }
-      emitBodyLock("  nodeNum[%d] = %ld; // memberNum=%ld\n", super->cppId, num, super->member.size());
+      emitBodyLock(1, "nodeNum[%d] = %ld; // memberNum=%ld\n", super->cppId, num, super->member.size());
     }
   }
-  emitBodyLock("  for (int i = 0; i < %d; i ++) validActive[i] = 0;\n", superId);
+  emitBodyLock(1, "for (int i = 0; i < %d; i ++) validActive[i] = 0;\n", superId);
 #endif
   emitBodyLock(0, "#ifdef RANDOMIZE_INIT\n"
                "  srand((unsigned int)time(NULL));\n"
@@ -1131,6 +2460,7 @@ void graph::cppEmitter() {
 
   // header: node definition; src: node evaluation
   fprintf(header, "uint32_t _var_start;\n");
+  int indent = laneLoopBegin(1);
   for (SuperNode* super : sortedSuper) {
     // std::string insts;
     if (super->superType == SUPER_VALID || super->superType == SUPER_ASYNC_RESET) {
@@ -1141,47 +2471,76 @@ void graph::cppEmitter() {
     }
   }
   /* memory definition */
-  for (Node* mem : memory) genNodeDef(header, mem);
+  for (Node* mem : memory) {
+    if (!mem->isSparseMemory()) genNodeDef(header, mem);
+    if (!mem->isAddrTracked()) continue;
+    for (Node* port : mem->member) {
+      if (port->status != VALID_NODE) continue;
+      fprintf(header, "uint64_t %s;\n", MEM_ADDR(port).c_str());
+      fingerprintAdd(MEM_ADDR(port) + ";");
+    }
+  }
+  indent = laneLoopEnd(indent);
   fprintf(header, "uint32_t _var_end;\n");
+  /* sparse memories are not initialized with other variables, their pages are zero when allocated */
+  for (Node* mem : memory) {
+    if (!mem->isSparseMemory()) continue;
+    std::string type = format("SparseMem<%s, %d, %d>", widthUType(mem->width).c_str(), upperPower2(mem->depth), sparsePageShift(mem));
+    fprintf(header, "%s %s; // width = %d, lineno = %d\n", type.c_str(), mem->name.c_str(), mem->width, mem->lineno);
+    fingerprintAdd(type + " " + mem->name + ";");
+  }
 
   emitBodyLock(0, "// initialize registers with reset value 0 to overwrite the rand() results\n" );
   emitBodyLock(1, "memset(&_var_start, 0, &_var_end - &_var_start);\n");
+  indent = laneLoopBegin(indent);
   for (SuperNode* super : sortedSuper) {
     if (super->superType != SUPER_VALID && super->superType != SUPER_ASYNC_RESET) continue;
     for (Node* member : super->member) {
       genNodeInit(member, 0);
     }
   }
+  indent = laneLoopEnd(indent);
 
   emitBodyLock(0, "#else\n" // RANDOMIZE_INIT
                "  memset(&_var_start, 0, &_var_end - &_var_start);\n"
                "#endif\n");
 
   fprintf(header, "S%s();\n", name.c_str());
+  if (multiThread() || traceMode()) fprintf(header, "~S%s();\n", name.c_str());
   fprintf(header, "void init();\n");
 
+  indent = laneLoopBegin(indent);
   for (SuperNode* super : sortedSuper) {
     if (super->superType != SUPER_VALID && super->superType != SUPER_ASYNC_RESET) continue;
     for (Node* member : super->member) {
       genNodeInit(member, 1);
     }
   }
+  laneLoopEnd(indent);
 
   emitBodyLock(0, "}\n");
 
   /* activation all nodes for reset */
   fprintf(header, "void activateAll();\n");
   emitFuncDecl(0, "void S%s::activateAll() {\n"
-               "  memset(activeFlags, 0xff, sizeof(activeFlags));\n"
-               "}\n", name.c_str());
+               "  memset(activeFlags, 0xff, sizeof(activeFlags));\n", name.c_str());
+  if (summaryMode()) emitBodyLock(1, "memset(activeSummary, 0xff, sizeof(activeSummary));\n");
+  if (traceMode()) emitBodyLock(1, "traceAll = true;\n");
+  emitBodyLock(0, "}\n");
+
+  genCheckpoint(header);
+  if (traceMode()) genTraceRuntime(header);
+  if (costMode()) genCostProfile(header);
 
    /* input/output interface */
   for (Node* node : input) {
     fprintf(header, "void set_%s(%s val);\n", node->name.c_str(), widthUType(node->width).c_str());
+    if (batchMode()) fprintf(header, "void set_%s(int lane, %s val);\n", node->name.c_str(), widthUType(node->width).c_str());
     genInterfaceInput(node);
   }
   for (Node* node : output) {
     fprintf(header, "%s get_%s();\n", widthUType(node->width).c_str(), node->name.c_str());
+    if (batchMode()) fprintf(header, "%s get_%s(int lane);\n", widthUType(node->width).c_str(), node->name.c_str());
     genInterfaceOutput(node);
   }
 
@@ -1189,18 +2548,36 @@ void graph::cppEmitter() {
   fprintf(header, "void resetAll();\n");
   genResetAll();
   for (int i = 0; i < resetFuncNum; i ++) {
-    fprintf(header, "void subReset%d();\n", i);
+    fprintf(header, "void subReset%d(%s);\n", i, batchMode() ? "int lane" : "");
   }
 
   /* main evaluation loop (step) */
-  int subStepIdxMax = genActivate();
-  for (int i = 0; i <= subStepIdxMax; i ++) {
-    fprintf(header, "void subStep%d();\n", i);
+  std::vector<int> subStepIdxMax;
+  if (workSteal()) genTaskRuntime(header);
+  else if (dispatchMode()) {
+    genDispatch(header);
+    subStepIdxMax.push_back(0);
+    fprintf(header, "void subStep0();\n");
+  } else {
+    for (int tid = 0; tid < globalConfig.threadNum; tid ++) {
+      subStepIdxMax.push_back(genActivate(tid));
+      for (int i = 0; i <= subStepIdxMax[tid]; i ++) {
+        if (multiThread()) fprintf(header, "void subStep%d_%d();\n", tid, i);
+        else fprintf(header, "void subStep%d();\n", i);
+      }
+    }
   }
 
   /* step wrapper */
   fprintf(header, "void step();\n");
+  fprintf(header, "bool isQuiescent();\n");
+  fprintf(header, "uint64_t step(uint64_t n);\n");
   genStep(subStepIdxMax);
+  if (multiThread()) {
+    fprintf(header, "void threadSync();\n");
+    fprintf(header, "void threadLoop(int tid);\n");
+    genThreadRuntime(subStepIdxMax);
+  }
 
 #if defined(DIFFTEST_PER_SIG) && defined(VERILATOR_DIFF)
   fprintf(header, "void saveDiffRegs();\n");
@@ -1216,6 +2593,7 @@ void graph::cppEmitter() {
   fclose(sigFile);
 #endif
 
-  printf("[cppEmitter] define %ld nodes %d superNodes\n", definedNode.size(), superId);
+  if (globalConfig.srcMap) genSrcMap();
+  printStat("[cppEmitter] define %ld nodes %d superNodes\n", definedNode.size(), superId);
   std::cout << "[cppEmitter] finish writing " << srcFileIdx << " cpp files to " + globalConfig.OutputDir + "/" << std::endl;
 }
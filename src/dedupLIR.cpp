@@ -0,0 +1,217 @@
+/*
+  dedupLIR: share the body of structurally identical superNodes, which are mostly the copies of identical
+  module instances after flattening. Two functions are identical if they only differ in the variables they
+  access and the superNodes they activate; every group keeps one body in LIRProgram::shared and its members
+  bind the parameters of the body to their own vars and ids.
+  The vars of sibling instances are laid out in the same order, so that a shared body addresses its vars at
+  fixed distances from the instance base, as a function of a module evaluated on the state of an instance.
+  Only the llvm and interp backends share code: the cpp backend is not lowered from the LIR (see LIR.h), so
+  the emitted C++ keeps one copy per instance. Shared bodies activate through tables, which may be slower
+  than the copies when the code of the model fits in the caches.
+*/
+
+#include "common.h"
+#include <unordered_map>
+
+/* functions smaller than this are not worth a call with bound parameters */
+#define DEDUP_MIN_INSTS 8
+
+class DedupGroup {
+public:
+  std::vector<LIRFunc*> members;
+  std::vector<std::vector<LIRVar*>> vars;
+  std::vector<std::vector<int>> ids;
+  std::vector<int> varParams;
+  std::vector<int> idParams;
+  size_t saved() { return (members.size() - 1) * members[0]->insts.size(); }
+};
+
+/* the structure of func with vars and ids numbered in the order of their first use */
+static std::string funcKey(LIRFunc* func, std::vector<LIRVar*>& vars, std::vector<int>& ids) {
+  std::map<LIRVar*, int> varIdx;
+  std::map<int, int> idIdx;
+  std::string key;
+  auto append = [&key](int64_t val) { key.append((const char*)&val, sizeof(val)); };
+  for (int width : func->tmpWidth) append(width);
+  for (const LIRInst& inst : func->insts) {
+    append(inst.op);
+    append(inst.dst);
+    for (int src : inst.src) append(src);
+    append(inst.width);
+    append(inst.sign);
+    append(inst.imm);
+    if (inst.var) {
+      if (varIdx.find(inst.var) == varIdx.end()) {
+        varIdx[inst.var] = vars.size();
+        vars.push_back(inst.var);
+      }
+      append(varIdx[inst.var]);
+      append(inst.var->width);
+      append(inst.var->sign);
+      append(inst.var->entryNum);
+    }
+    append(inst.cons.size());
+    for (uint64_t word : inst.cons) append(word);
+    append(inst.ids.size());
+    for (int id : inst.ids) {
+      if (idIdx.find(id) == idIdx.end()) {
+        idIdx[id] = ids.size();
+        ids.push_back(id);
+      }
+      append(idIdx[id]);
+    }
+    append(inst.args.size());
+    for (int arg : inst.args) append(arg);
+    append(inst.str.length());
+    key += inst.str;
+  }
+  return key;
+}
+
+/* parameters bound to the same var or id in all members are not parameters */
+template <typename T>
+static std::vector<int> memberParams(std::vector<std::vector<T>>& args) {
+  std::vector<int> ret;
+  for (size_t i = 0; i < args[0].size(); i ++) {
+    for (size_t j = 1; j < args.size(); j ++) {
+      if (args[j][i] != args[0][i]) {
+        ret.push_back(i);
+        break;
+      }
+    }
+  }
+  return ret;
+}
+
+static int elemBytes(LIRVar* var) { return widthBits(var->width) / 8; }
+
+/* the longest prefix of the names of vars ending with the module separator, "" if there is none */
+static std::string instancePrefix(std::vector<LIRVar*>& vars) {
+  std::string ret = vars[0]->name;
+  for (LIRVar* var : vars) {
+    size_t len = 0;
+    while (len < ret.length() && len < var->name.length() && ret[len] == var->name[len]) len ++;
+    ret.resize(len);
+  }
+  size_t pos = ret.rfind(globalConfig.sep_module);
+  return pos == std::string::npos ? "" : ret.substr(0, pos + globalConfig.sep_module.length());
+}
+
+/* byte offsets of vars laid out in order with natural alignment, the layout of the state in the backends */
+static std::vector<uint64_t> varOffsets(std::vector<LIRVar*>& vars) {
+  std::vector<uint64_t> ret(vars.size());
+  uint64_t offset = 0;
+  for (LIRVar* var : vars) {
+    uint64_t align = MIN(elemBytes(var), 8);
+    offset = (offset + align - 1) / align * align;
+    ret[var->id] = offset;
+    offset += (uint64_t)elemBytes(var) * var->entryNum;
+  }
+  return ret;
+}
+
+/*
+  sibling instances take blocks of all their vars ordered by the names without the prefixes, vars missing in
+  some instances are padded. Vars with larger elements come first, so that the blocks have no inner padding
+*/
+static void layoutInstances(LIRProgram* program, std::vector<std::string>& prefixes, std::set<LIRVar*>& placed, std::vector<LIRVar*>& blockVars) {
+  std::map<std::string, LIRVar*> suffixVar;
+  std::vector<std::vector<LIRVar*>> instVars(prefixes.size());
+  for (size_t i = 0; i < prefixes.size(); i ++) {
+    for (auto iter = program->varMap.lower_bound(prefixes[i]); iter != program->varMap.end() && iter->first.compare(0, prefixes[i].length(), prefixes[i]) == 0; iter ++) {
+      if (placed.find(iter->second) != placed.end()) return;
+      instVars[i].push_back(iter->second);
+      suffixVar.emplace(iter->first.substr(prefixes[i].length()), iter->second);
+    }
+  }
+  std::vector<std::pair<std::string, LIRVar*>> suffixes(suffixVar.begin(), suffixVar.end());
+  std::stable_sort(suffixes.begin(), suffixes.end(), [](const std::pair<std::string, LIRVar*>& a, const std::pair<std::string, LIRVar*>& b) {
+    return elemBytes(a.second) > elemBytes(b.second);
+  });
+  for (std::string& prefix : prefixes) {
+    for (auto& suffix : suffixes) {
+      LIRVar* proto = suffix.second;
+      LIRVar* var = program->getVar(prefix + suffix.first, proto->width, proto->sign, proto->entryNum, nullptr);
+      blockVars.push_back(var);
+      placed.insert(var);
+    }
+  }
+}
+
+void graph::dedupLIR() {
+  LIRProgram* program = lir;
+  size_t prevInsts = program->instNum();
+  std::unordered_map<std::string, DedupGroup> groupMap;
+  std::vector<DedupGroup*> groups;
+  for (LIRFunc* func : program->supers) {
+    if (!func || func->insts.size() < DEDUP_MIN_INSTS) continue;
+    std::vector<LIRVar*> vars;
+    std::vector<int> ids;
+    DedupGroup& group = groupMap[funcKey(func, vars, ids)];
+    if (group.members.empty()) groups.push_back(&group);
+    group.members.push_back(func);
+    group.vars.push_back(vars);
+    group.ids.push_back(ids);
+  }
+  groups.erase(std::remove_if(groups.begin(), groups.end(), [](DedupGroup* group) { return group->members.size() < 2; }), groups.end());
+  /* groups saving more instructions decide the layout of their instances first */
+  std::stable_sort(groups.begin(), groups.end(), [](DedupGroup* a, DedupGroup* b) { return a->saved() > b->saved(); });
+  std::set<LIRVar*> placed;
+  std::vector<LIRVar*> blockVars;
+  for (DedupGroup* group : groups) {
+    group->varParams = memberParams(group->vars);
+    group->idParams = memberParams(group->ids);
+    if (group->varParams.empty()) continue;
+    std::vector<std::string> prefixes;
+    for (std::vector<LIRVar*>& vars : group->vars) {
+      std::vector<LIRVar*> paramVars;
+      for (int param : group->varParams) paramVars.push_back(vars[param]);
+      prefixes.push_back(instancePrefix(paramVars));
+    }
+    std::set<std::string> uniquePrefixes(prefixes.begin(), prefixes.end());
+    if (uniquePrefixes.size() != prefixes.size() || uniquePrefixes.count("")) continue;
+    layoutInstances(program, prefixes, placed, blockVars);
+  }
+  std::vector<LIRVar*> vars;
+  for (LIRVar* var : program->vars) {
+    if (placed.find(var) == placed.end()) vars.push_back(var);
+  }
+  vars.insert(vars.end(), blockVars.begin(), blockVars.end());
+  program->vars = vars;
+  for (size_t i = 0; i < vars.size(); i ++) vars[i]->id = i;
+
+  /* members share a body if their vars are at the same distances as in the most common layout of the group */
+  std::vector<uint64_t> offsets = varOffsets(program->vars);
+  size_t sharedNum = 0;
+  for (DedupGroup* group : groups) {
+    std::map<std::vector<uint64_t>, std::vector<size_t>> layouts;
+    for (size_t i = 0; i < group->members.size(); i ++) {
+      std::vector<uint64_t> dist;
+      for (int param : group->varParams) dist.push_back(offsets[group->vars[i][param]->id] - offsets[group->vars[i][group->varParams[0]]->id]);
+      layouts[dist].push_back(i);
+    }
+    std::vector<size_t>* valid = nullptr;
+    for (auto& iter : layouts) {
+      if (!valid || iter.second.size() > valid->size()) valid = &iter.second;
+    }
+    if (valid->size() < 2) continue;
+    LIRFunc* rep = group->members[(*valid)[0]];
+    LIRFunc* body = new LIRFunc();
+    body->name = format("shared%ld", program->shared.size());
+    body->insts = rep->insts;
+    body->tmpWidth = rep->tmpWidth;
+    for (int param : group->varParams) body->varParams.push_back(group->vars[(*valid)[0]][param]);
+    for (int param : group->idParams) body->idParams.push_back(group->ids[(*valid)[0]][param]);
+    program->shared.push_back(body);
+    for (size_t i : *valid) {
+      LIRFunc* func = group->members[i];
+      func->proto = body;
+      for (int param : group->varParams) func->varArgs.push_back(group->vars[i][param]);
+      for (int param : group->idParams) func->idArgs.push_back(group->ids[i][param]);
+      func->insts.clear();
+      func->tmpWidth.clear();
+    }
+    sharedNum += valid->size();
+  }
+  printStat("[dedupLIR] %ld shared bodies for %ld superNodes, insts %ld -> %ld\n", program->shared.size(), sharedNum, prevInsts, program->instNum());
+}
@@ -0,0 +1,402 @@
+/*
+  graphCache: save the graph at the end of the front end (parsing and the passes that only depend on the
+  input and the separators) and resume from it, so that reruns with other partition or emitter options skip
+  the front end. Objects are numbered per class and pointers are saved as numbers, so that shared objects
+  stay shared; nodes, ENodes and superNodes keep their ids, which appear in the names of the emitted code.
+*/
+
+#include "common.h"
+#include <unordered_map>
+#include <type_traits>
+
+#define GRAPH_CACHE_MAGIC 0x52475347 // GSGR
+/* increase it whenever the saved fields change */
+#define GRAPH_CACHE_VERSION 2
+
+enum ArchiveMode { ARCHIVE_COLLECT, ARCHIVE_SAVE, ARCHIVE_LOAD };
+
+/*
+  the same field lists collect the reachable objects, save them and load them. Collecting numbers every
+  object on its first reference, saving writes the numbers of pointers, loading maps them back
+*/
+class GraphArchive {
+public:
+  ArchiveMode mode;
+  std::vector<Node*> nodes;
+  std::vector<SuperNode*> supers;
+  std::vector<ExpTree*> trees;
+  std::vector<ENode*> enodes;
+  std::vector<valInfo*> infos;
+  std::unordered_map<const void*, int64_t> index;
+  std::vector<std::pair<int, void*>> worklist;
+  FILE* fp = nullptr;
+  std::vector<char> buf;
+  size_t pos = 0;
+
+  GraphArchive(ArchiveMode _mode) { mode = _mode; }
+
+  void raw(void* data, size_t size) {
+    if (mode == ARCHIVE_SAVE) fwrite(data, 1, size, fp);
+    else if (mode == ARCHIVE_LOAD) {
+      Assert(pos + size <= buf.size(), "truncated graph cache");
+      memcpy(data, &buf[pos], size);
+      pos += size;
+    }
+  }
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type io(T& val) { raw(&val, sizeof(val)); }
+  void io(std::string& str) {
+    size_t len = str.length();
+    io(len);
+    if (mode == ARCHIVE_LOAD) str.resize(len);
+    raw(&str[0], len);
+  }
+  void io(mpz_t val) {
+    std::string str;
+    if (mode == ARCHIVE_SAVE) {
+      char* hex = mpz_get_str(NULL, 16, val);
+      str = hex;
+      free(hex);
+    }
+    io(str);
+    if (mode == ARCHIVE_LOAD) mpz_set_str(val, str.c_str(), 16);
+  }
+  template <typename T>
+  void io(std::vector<T>& vec) {
+    size_t num = vec.size();
+    io(num);
+    if (mode == ARCHIVE_LOAD) vec.resize(num);
+    for (T& elem : vec) io(elem);
+  }
+  template <typename T>
+  void io(std::set<T>& elems) {
+    size_t num = elems.size();
+    io(num);
+    if (mode == ARCHIVE_LOAD) {
+      for (size_t i = 0; i < num; i ++) {
+        T elem{};
+        io(elem);
+        elems.insert(elem);
+      }
+    } else {
+      for (T elem : elems) io(elem);
+    }
+  }
+  template <typename K, typename V>
+  void io(std::map<K, V>& elems) {
+    size_t num = elems.size();
+    io(num);
+    if (mode == ARCHIVE_LOAD) {
+      for (size_t i = 0; i < num; i ++) {
+        K key{};
+        io(key);
+        io(elems[key]);
+      }
+    } else {
+      for (auto& iter : elems) {
+        K key = iter.first;
+        io(key);
+        io(iter.second);
+      }
+    }
+  }
+  std::vector<Node*>& table(Node*) { return nodes; }
+  std::vector<SuperNode*>& table(SuperNode*) { return supers; }
+  std::vector<ExpTree*>& table(ExpTree*) { return trees; }
+  std::vector<ENode*>& table(ENode*) { return enodes; }
+  std::vector<valInfo*>& table(valInfo*) { return infos; }
+  int kind(Node*) { return 0; }
+  int kind(SuperNode*) { return 1; }
+  int kind(ExpTree*) { return 2; }
+  int kind(ENode*) { return 3; }
+  int kind(valInfo*) { return 4; }
+  template <typename T>
+  void io(T*& ptr) {
+    if (mode == ARCHIVE_COLLECT) {
+      if (ptr && index.find(ptr) == index.end()) {
+        index[ptr] = table(ptr).size();
+        table(ptr).push_back(ptr);
+        worklist.push_back(std::make_pair(kind(ptr), (void*)ptr));
+      }
+      return;
+    }
+    int64_t idx = (mode == ARCHIVE_SAVE && ptr) ? index.at(ptr) : -1;
+    io(idx);
+    if (mode == ARCHIVE_LOAD) {
+      Assert(idx < (int64_t)table(ptr).size(), "invalid object %ld in graph cache", idx);
+      ptr = idx < 0 ? nullptr : table(ptr)[idx];
+    }
+  }
+
+  void fields(Node* node);
+  void fields(SuperNode* super);
+  void fields(ENode* enode);
+  void fields(valInfo* info);
+  void fields(ExpTree* tree) {
+    ENode* root = tree->getRoot();
+    ENode* lvalue = tree->getlval();
+    io(root);
+    io(lvalue);
+    if (mode == ARCHIVE_LOAD) {
+      tree->setRoot(root);
+      tree->setlval(lvalue);
+    }
+  }
+  void fields(graph* g);
+  void collect(graph* g);
+  void renumber();
+  void header(uint64_t& key);
+  void allocate();
+  int counter[3];
+  size_t num[5];
+};
+
+void GraphArchive::fields(Node* node) {
+  io(node->name);
+  io(node->extraInfo);
+  io(node->id);
+  io(node->type);
+  io(node->width);
+  io(node->sign);
+  io(node->usedBit);
+  io(node->status);
+  io(node->dimension);
+  io(node->order);
+  io(node->orderInSuper);
+  io(node->ops);
+  io(node->lineno);
+  io(node->next);
+  io(node->prev);
+  io(node->depPrev);
+  io(node->depNext);
+  io(node->assignTree);
+  io(node->valTree);
+  io(node->memTree);
+  io(node->resetCond);
+  io(node->resetVal);
+  io(node->invalidIdx);
+  io(node->super);
+  io(node->rlatency);
+  io(node->wlatency);
+  io(node->depth);
+  io(node->member);
+  io(node->parent);
+  io(node->regNext);
+  io(node->regUpdate);
+  io(node->updateTree);
+  io(node->resetTree);
+  io(node->regSplit);
+  io(node->computeInfo);
+  io(node->arrayMember);
+  io(node->arrayIdx);
+  io(node->arrayParent);
+  io(node->clock);
+  io(node->isClock);
+  io(node->reset);
+  io(node->asReset);
+  io(node->isArrayMember);
+  io(node->inAggr);
+  io(node->whenDepth);
+  io(node->fullyUpdated);
+  io(node->nodeIsRoot);
+  io(node->nextActiveId);
+  io(node->nextNeedActivate);
+  io(node->insts);
+  io(node->resetInsts);
+  io(node->initInsts);
+}
+
+void GraphArchive::fields(SuperNode* super) {
+  Assert(super->insts.empty() && !super->stmtTree, "superNode %d is saved after generateStmtTree", super->id);
+  io(super->name);
+  io(super->prev);
+  io(super->next);
+  io(super->depPrev);
+  io(super->depNext);
+  io(super->member);
+  io(super->id);
+  io(super->order);
+  io(super->cppId);
+  io(super->superType);
+  io(super->resetNode);
+  io(super->localTmpNum);
+  io(super->threadId);
+  io(super->epoch);
+  io(super->taskNext);
+  io(super->taskDepNum);
+}
+
+void GraphArchive::fields(ENode* enode) {
+  io(enode->nodePtr);
+  io(enode->child);
+  io(enode->opType);
+  io(enode->width);
+  io(enode->sign);
+  io(enode->isClock);
+  io(enode->reset);
+  io(enode->usedBit);
+  io(enode->memoryNode);
+  io(enode->id);
+  io(enode->values);
+  io(enode->strVal);
+  io(enode->computeInfo);
+}
+
+void GraphArchive::fields(valInfo* info) {
+  io(info->valStr);
+  io(info->opNum);
+  io(info->status);
+  io(info->type);
+  io(info->insts);
+  io(info->consVal);
+  io(info->width);
+  io(info->sign);
+  io(info->typeWidth);
+  io(info->consLength);
+  io(info->beg);
+  io(info->end);
+  io(info->memberInfo);
+  io(info->sameConstant);
+  io(info->assignmentCons);
+  io(info->fullyUpdated);
+  io(info->directUpdate);
+}
+
+void GraphArchive::fields(graph* g) {
+  io(g->allNodes);
+  io(g->input);
+  io(g->output);
+  io(g->regsrc);
+  io(g->sorted);
+  io(g->memory);
+  io(g->external);
+  io(g->halfConstantArray);
+  io(g->specialNodes);
+  io(g->supersrc);
+  io(g->sortedSuper);
+  io(g->uintReset);
+  io(g->splittedArray);
+  io(g->extDecl);
+  io(g->name);
+  io(g->instanceModule);
+  io(g->nodeNum);
+}
+
+void GraphArchive::collect(graph* g) {
+  fields(g);
+  while (!worklist.empty()) {
+    std::pair<int, void*> top = worklist.back();
+    worklist.pop_back();
+    switch (top.first) {
+      case 0: fields((Node*)top.second); break;
+      case 1: fields((SuperNode*)top.second); break;
+      case 2: fields((ExpTree*)top.second); break;
+      case 3: fields((ENode*)top.second); break;
+      case 4: fields((valInfo*)top.second); break;
+      default: Panic();
+    }
+  }
+}
+
+/* objects with ids are numbered in the order of ids, so that they are allocated in the same order on loading */
+void GraphArchive::renumber() {
+  std::sort(nodes.begin(), nodes.end(), [](Node* a, Node* b) { return a->id < b->id; });
+  std::sort(supers.begin(), supers.end(), [](SuperNode* a, SuperNode* b) { return a->id < b->id; });
+  std::sort(enodes.begin(), enodes.end(), [](ENode* a, ENode* b) { return a->id < b->id; });
+  for (size_t i = 0; i < nodes.size(); i ++) index[nodes[i]] = i;
+  for (size_t i = 0; i < supers.size(); i ++) index[supers[i]] = i;
+  for (size_t i = 0; i < enodes.size(); i ++) index[enodes[i]] = i;
+}
+
+/* the counters of ids go on from their saved values, so that the ids of later objects do not change either */
+void GraphArchive::header(uint64_t& key) {
+  uint32_t magic = GRAPH_CACHE_MAGIC, version = GRAPH_CACHE_VERSION;
+  io(magic);
+  io(version);
+  Assert(magic == GRAPH_CACHE_MAGIC && version == GRAPH_CACHE_VERSION, "invalid graph cache version %d (expected %d)", version, GRAPH_CACHE_VERSION);
+  io(key);
+  counter[0] = Node::counter;
+  counter[1] = ENode::counter;
+  counter[2] = SuperNode::counter;
+  for (int& n : counter) io(n);
+  num[0] = nodes.size();
+  num[1] = supers.size();
+  num[2] = trees.size();
+  num[3] = enodes.size();
+  num[4] = infos.size();
+  for (size_t& n : num) io(n);
+}
+
+void GraphArchive::allocate() {
+  for (size_t i = 0; i < num[0]; i ++) nodes.push_back(new Node());
+  for (size_t i = 0; i < num[1]; i ++) supers.push_back(new SuperNode());
+  for (size_t i = 0; i < num[3]; i ++) enodes.push_back(new ENode());
+  for (size_t i = 0; i < num[4]; i ++) infos.push_back(new valInfo());
+  /* any root keeps the constructor from allocating one, the saved root is set later */
+  for (size_t i = 0; i < num[2]; i ++) trees.push_back(new ExpTree(enodes[0], (ENode*)nullptr));
+  Node::counter = counter[0];
+  ENode::counter = counter[1];
+  SuperNode::counter = counter[2];
+}
+
+/* the key of the front end: the input and the options that the front end depends on */
+uint64_t graphCacheKey(const char* input, size_t size) {
+  uint64_t key = 0xcbf29ce484222325UL;
+  auto hash = [&key](const char* data, size_t len) {
+    for (size_t i = 0; i < len; i ++) key = (key ^ (uint8_t)data[i]) * 0x100000001b3UL;
+  };
+  hash(input, size);
+  std::string opts = globalConfig.sep_module + '\0' + globalConfig.sep_aggr + '\0' + std::to_string(GRAPH_CACHE_VERSION);
+  hash(opts.c_str(), opts.length());
+  return key;
+}
+
+void saveGraph(graph* g, std::string fileName, uint64_t key) {
+  GraphArchive archive(ARCHIVE_COLLECT);
+  archive.collect(g);
+  archive.renumber();
+  archive.mode = ARCHIVE_SAVE;
+  std::string tmpName = fileName + ".tmp";
+  archive.fp = fopen(tmpName.c_str(), "wb");
+  Assert(archive.fp, "can not open %s", tmpName.c_str());
+  archive.header(key);
+  for (ExpTree* tree : archive.trees) archive.fields(tree);
+  for (Node* node : archive.nodes) archive.fields(node);
+  for (SuperNode* super : archive.supers) archive.fields(super);
+  for (ENode* enode : archive.enodes) archive.fields(enode);
+  for (valInfo* info : archive.infos) archive.fields(info);
+  archive.fields(g);
+  fclose(archive.fp);
+  /* a complete file replaces the old one at once, so that an interrupted run never leaves a broken cache */
+  Assert(rename(tmpName.c_str(), fileName.c_str()) == 0, "can not rename %s", tmpName.c_str());
+  printStat("[graphCache] save %ld nodes, %ld superNodes, %ld ENodes to %s\n", archive.nodes.size(), archive.supers.size(), archive.enodes.size(), fileName.c_str());
+}
+
+/* return nullptr if the file does not exist or is saved for another key; the key 0 matches any file */
+graph* loadGraph(std::string fileName, uint64_t key) {
+  GraphArchive archive(ARCHIVE_LOAD);
+  FILE* fp = fopen(fileName.c_str(), "rb");
+  if (!fp) return nullptr;
+  fseek(fp, 0, SEEK_END);
+  archive.buf.resize(ftell(fp));
+  fseek(fp, 0, SEEK_SET);
+  Assert(fread(archive.buf.data(), 1, archive.buf.size(), fp) == archive.buf.size(), "can not read %s", fileName.c_str());
+  fclose(fp);
+  uint64_t savedKey = key;
+  archive.header(savedKey);
+  if (key != 0 && savedKey != key) {
+    printStat("[graphCache] %s is saved for another input or options\n", fileName.c_str());
+    return nullptr;
+  }
+  archive.allocate();
+  for (ExpTree* tree : archive.trees) archive.fields(tree);
+  for (Node* node : archive.nodes) archive.fields(node);
+  for (SuperNode* super : archive.supers) archive.fields(super);
+  for (ENode* enode : archive.enodes) archive.fields(enode);
+  for (valInfo* info : archive.infos) archive.fields(info);
+  graph* g = new graph();
+  archive.fields(g);
+  Assert(archive.pos == archive.buf.size(), "trailing data in graph cache %s", fileName.c_str());
+  printStat("[graphCache] load %ld nodes, %ld superNodes, %ld ENodes from %s\n", archive.nodes.size(), archive.supers.size(), archive.enodes.size(), fileName.c_str());
+  return g;
+}
@@ -61,7 +61,7 @@ void graph::graphCoarsen() {
 // initial partition
 
 void graph::graphInitPartition() {
-  printf("[graphPartition] Setting the maximum size of a superNode to %d\n", globalConfig.SuperNodeMaxSize);
+  printStat("[graphPartition] Setting the maximum size of a superNode to %d\n", globalConfig.SuperNodeMaxSize);
   /*
   Kernighan’s algorithm: new part start at x
   * cost：C(x) = sum(i<x<=j)(cij)
@@ -122,6 +122,7 @@ void graph::graphInitPartition() {
       if (i + 1 < sortedSuper.size()) cut.insert(i + 1);
     }
   }
+  if (hasProfile()) profilePartition(cut);
   // for (int i : cut) printf("cut %d\n", i);
   
   int cutBeg = 0;
@@ -141,6 +142,105 @@ void graph::graphInitPartition() {
   reconnectSuper();
 }
 
+/*
+  profile-guided partition (--profile): parts whose evaluations rarely activate others are split into the
+  superNodes of the coarsen phase, and adjacent parts which are likely activated in the same cycles are merged
+  when evaluating them together is cheaper than checking their activation separately.
+  Parts are contiguous in the topological order, so merging them never creates loops.
+*/
+#define PROFILE_VALID_LOW 0.1   // split parts whose evaluations activate others less often than this
+#define PROFILE_MIN_RATE 0.01   // ... and which are activated in more cycles than this
+#define PROFILE_CHECK_COST 2.0  // the cost of checking and clearing an activation, in evaluations of nodes
+#define PROFILE_MERGE_SIZE 2    // merged parts are at most this times the maximum size of a superNode
+
+class PartActivity {
+public:
+  size_t size = 0;
+  double rate = -1; // probability of being activated in a cycle, -1 if unknown
+  uint64_t calls = 0;
+  uint64_t valid = 0;
+  std::set<int> groups; // superNodes of the profiled model
+  bool fixed = false;
+  void add(SuperNode* super) {
+    size += super->member.size();
+    if (super->superType != SUPER_VALID) fixed = true;
+    for (Node* member : super->member) {
+      NodeActivity* activity = nodeActivity(member);
+      if (!activity) continue;
+      rate = MAX(rate, activity->rate());
+      if (groups.insert(activity->group).second) {
+        calls += activity->calls;
+        valid += activity->valid;
+      }
+    }
+  }
+};
+
+void graph::profilePartition(std::set<int>& cut) {
+  int splitNum = 0, mergeNum = 0;
+  std::vector<std::pair<int, int>> parts;
+  int beg = 0;
+  for (int end : cut) {
+    if (end > beg) parts.push_back(std::make_pair(beg, end));
+    beg = end;
+  }
+  /* split */
+  std::vector<PartActivity> activity;
+  for (auto part : parts) {
+    PartActivity total;
+    bool anyNext = false; // the evaluations of sinks never activate others
+    for (int i = part.first; i < part.second; i ++) {
+      total.add(sortedSuper[i]);
+      for (SuperNode* next : sortedSuper[i]->next) anyNext |= next->order >= part.second;
+    }
+    bool split = !total.fixed && anyNext && part.second - part.first > 1 && total.rate >= PROFILE_MIN_RATE && total.valid < PROFILE_VALID_LOW * total.calls;
+    if (!split) {
+      activity.push_back(total);
+      continue;
+    }
+    splitNum ++;
+    for (int i = part.first; i < part.second; i ++) {
+      cut.insert(i + 1);
+      activity.push_back(PartActivity());
+      activity.back().add(sortedSuper[i]);
+      activity.back().fixed = true;
+    }
+  }
+  /* merge */
+  parts.clear();
+  beg = 0;
+  for (int end : cut) {
+    if (end > beg) parts.push_back(std::make_pair(beg, end));
+    beg = end;
+  }
+  Assert(parts.size() == activity.size(), "invalid parts %ld %ld", parts.size(), activity.size());
+  PartActivity cur = activity[0];
+  for (size_t i = 1; i < parts.size(); i ++) {
+    PartActivity& next = activity[i];
+    bool merge = !cur.fixed && !next.fixed && cur.rate >= 0 && next.rate >= 0 && cur.size + next.size <= (size_t)globalConfig.SuperNodeMaxSize * PROFILE_MERGE_SIZE;
+    double unionRate = 0;
+    if (merge) {
+      bool sameGroup = std::any_of(next.groups.begin(), next.groups.end(), [&cur](int group) { return cur.groups.find(group) != cur.groups.end(); });
+      double both = sameGroup ? MIN(cur.rate, next.rate) : MAX(0.0, cur.rate + next.rate - 1);
+      unionRate = cur.rate + next.rate - both;
+      double mergedCost = unionRate * (cur.size + next.size) + PROFILE_CHECK_COST;
+      double separateCost = cur.rate * cur.size + next.rate * next.size + 2 * PROFILE_CHECK_COST;
+      merge = mergedCost < separateCost;
+    }
+    if (!merge) {
+      cur = next;
+      continue;
+    }
+    mergeNum ++;
+    cut.erase(parts[i].first);
+    cur.size += next.size;
+    cur.rate = unionRate;
+    cur.calls += next.calls;
+    cur.valid += next.valid;
+    cur.groups.insert(next.groups.begin(), next.groups.end());
+  }
+  printStat("[profilePartition] split %d superNodes, merge %d pairs of superNodes\n", splitNum, mergeNum);
+}
 
 #define REFINE_TYPE std::tuple<Node*, SuperNode*, int>
 #define REFINE_NODE(gain) std::get<0>(gain)
@@ -373,15 +473,15 @@ void graph::graphPartition() {
   graphCoarsen();
   resort();
   orderAllNodes();
-  printf("[graphCoarsen] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[graphCoarsen] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
 
 /* initial partition */
   phaseSuper = sortedSuper.size();
   graphInitPartition();
   orderAllNodes();
-  printf("[InitPartition] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
+  printStat("[InitPartition] remove %ld superNodes (%ld -> %ld)\n", phaseSuper - sortedSuper.size(), phaseSuper, sortedSuper.size());
 /* refine & uncoarsen phase */
   // graphRefine();
   phaseSuper = sortedSuper.size();
-  printf("[graphPartition] remove %ld superNodes (%ld -> %ld)\n", totalSuper - phaseSuper, totalSuper, phaseSuper);
+  printStat("[graphPartition] remove %ld superNodes (%ld -> %ld)\n", totalSuper - phaseSuper, totalSuper, phaseSuper);
 }
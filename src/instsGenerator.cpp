@@ -1463,7 +1463,10 @@ valInfo* ENode::instsReadMem(Node* node, std::string lvalue, bool isRoot) {
   valInfo* ret = computeInfo;
   Assert(node->type == NODE_READER || node->type == NODE_READWRITER, "invalid type %d", node->type);
   Node* memory = memoryNode;
-  ret->valStr = memory->name + "[" + ChildInfo(0, valStr) + "]";
+  std::string addrStr = ChildInfo(0, valStr);
+  if (memory->isAddrTracked() && node->status == VALID_NODE) addrStr = format("(%s = %s)", MEM_ADDR(node).c_str(), addrStr.c_str());
+  if (memory->isSparseMemory()) ret->valStr = memory->name + ".read(" + addrStr + ")";
+  else ret->valStr = memory->name + "[" + addrStr + "]";
   for (size_t i = 0; i < memory->dimension.size(); i ++) {
     computeInfo->valStr += "[i" + std::to_string(i) + "]";
   }
@@ -1489,10 +1492,14 @@ valInfo* ENode::instsWriteMem(Node* node, std::string lvalue, bool isRoot) {
     std::string arraylvalue = format("%s[%s]%s", memory->name.c_str(), ChildInfo(0, valStr).c_str(), indexStr.c_str());
     ret->valStr = arrayCopy(arraylvalue, node, Child(1, computeInfo), countArrayIndex(arraylvalue) - 1);
   } else {
+    std::string addrStr = ChildInfo(0, valStr);
+    if (memory->isAddrTracked() && node->status == VALID_NODE) addrStr = format("(%s = %s)", MEM_ADDR(node).c_str(), addrStr.c_str());
+    std::string dstStr = memory->isSparseMemory() ? format("%s.write(%s)", memory->name.c_str(), addrStr.c_str()) :
+                                                      format("%s[%s]%s", memory->name.c_str(), addrStr.c_str(), indexStr.c_str());
     if (memory->width < width) {
-      ret->valStr = format("%s[%s]%s = %s & %s;", memory->name.c_str(), ChildInfo(0, valStr).c_str(), indexStr.c_str(), ChildInfo(1, valStr).c_str(), bitMask(memory->width).c_str());
+      ret->valStr = format("%s = %s & %s;", dstStr.c_str(), ChildInfo(1, valStr).c_str(), bitMask(memory->width).c_str());
     } else {
-      ret->valStr = format("%s[%s]%s = %s;", memory->name.c_str(), ChildInfo(0, valStr).c_str(), indexStr.c_str(), ChildInfo(1, valStr).c_str());
+      ret->valStr = format("%s = %s;", dstStr.c_str(), ChildInfo(1, valStr).c_str());
     }
   }
   ret->opNum = -1;
@@ -2319,7 +2326,7 @@ void graph::instsGenerator() {
 
   size_t optimizeNodes = countNodes();
   size_t optimizeSuper = sortedSuper.size();
-  printf("[instGenerator] remove %ld constantNodes (%ld -> %ld)\n", totalNodes - optimizeNodes, totalNodes, optimizeNodes);
-  printf("[instGenerator] remove %ld superNodes (%ld -> %ld)\n",  totalSuper - optimizeSuper, totalSuper, optimizeSuper);
+  printStat("[instGenerator] remove %ld constantNodes (%ld -> %ld)\n", totalNodes - optimizeNodes, totalNodes, optimizeNodes);
+  printStat("[instGenerator] remove %ld superNodes (%ld -> %ld)\n",  totalSuper - optimizeSuper, totalSuper, optimizeSuper);
 
 }
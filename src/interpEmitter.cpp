@@ -0,0 +1,422 @@
+/*
+  interpEmitter: serialize the LIR of the model into the bytecode of include/bytecode.h for the interpreter in
+  emu/interp.cpp, so that the model runs without compiling it. Emits [dir]/[top].gbc and [dir]/[top].h, which
+  declares class S[top] on top of the interpreter with the interface of the C++ model.
+  Temporaries of a function are allocated to distinct register slots, functions share the register file.
+*/
+
+#include <climits>
+#include "common.h"
+#include "bytecode.h"
+
+#define NARROW_WIDTH 64
+
+static LIRProgram* program;
+static LIRFunc* curFunc;
+static std::vector<uint32_t> code;
+static std::vector<std::string> strs;
+static std::vector<uint32_t> varOffset;
+static std::vector<uint32_t> tmpReg;
+static uint32_t regNum;
+static uint32_t funcRegNum;
+
+static bool isWide(int width) { return width > NARROW_WIDTH; }
+
+static uint32_t slotNum(int width) { return (MAX(width, 1) + 63) / 64; }
+
+/* 1/2/4/8 bytes for variables of at most 64 bits, 8 bytes per 64 bits otherwise */
+static uint32_t storageSize(LIRVar* var) { return widthBits(var->width) / 8; }
+
+/* operands are checked against the signature of the opcode, W takes the low and high words of one operand */
+static void emitOp(BCOp op, std::initializer_list<uint64_t> args) {
+  const char* sig = bcOpSig[op];
+  Assert(strlen(sig) == args.size(), "%ld operands for signature %s", args.size(), sig);
+  code.push_back(op);
+  const uint64_t* arg = args.begin();
+  for (const char* kind = sig; *kind; kind ++, arg ++) {
+    code.push_back((uint32_t)*arg);
+    if (*kind == 'W') code.push_back((uint32_t)(*arg >> 32));
+  }
+}
+
+static uint32_t strIdx(const std::string& str) {
+  strs.push_back(str);
+  return strs.size() - 1;
+}
+
+static uint32_t reg(int tmp) { return tmpReg[tmp]; }
+
+static int tmpWidth(int tmp) { return curFunc->tmpWidth[tmp]; }
+
+static uint32_t scratchReg(int width) {
+  uint32_t ret = funcRegNum;
+  funcRegNum += slotNum(width);
+  return ret;
+}
+
+/* byte offset of var[imm], the variable part of the index is scaled by the interpreter */
+static uint32_t varAddr(const LIRInst& inst) {
+  return varOffset[inst.var->id] + inst.imm * storageSize(inst.var);
+}
+
+static BCOp sizedOp(BCOp op1, uint32_t size) {
+  switch (size) {
+    case 1: return op1;
+    case 2: return (BCOp)(op1 + 1);
+    case 4: return (BCOp)(op1 + 2);
+    case 8: return (BCOp)(op1 + 3);
+    default: Panic();
+  }
+  return op1;
+}
+
+static void emitConst(uint32_t dst, const std::vector<uint64_t>& cons, int width) {
+  if (!isWide(width)) {
+    emitOp(BC_CONST, {dst, cons.empty() ? 0 : cons[0]});
+    return;
+  }
+  code.push_back(BC_CONSTW);
+  code.push_back(dst);
+  code.push_back(slotNum(width));
+  for (uint32_t i = 0; i < slotNum(width); i ++) {
+    uint64_t word = i < cons.size() ? cons[i] : 0;
+    code.push_back((uint32_t)word);
+    code.push_back((uint32_t)(word >> 32));
+  }
+}
+
+static void emitLoad(const LIRInst& inst) {
+  LIRVar* var = inst.var;
+  uint32_t dst = reg(inst.dst);
+  if (isWide(var->width)) {
+    if (inst.src[0] < 0) emitOp(BC_LOADW, {dst, varAddr(inst), slotNum(var->width)});
+    else emitOp(BC_LOADXW, {dst, varAddr(inst), reg(inst.src[0]), slotNum(var->width)});
+  } else {
+    if (inst.src[0] < 0) emitOp(sizedOp(BC_LOAD1, storageSize(var)), {dst, varAddr(inst)});
+    else emitOp(sizedOp(BC_LOADX1, storageSize(var)), {dst, varAddr(inst), reg(inst.src[0])});
+  }
+}
+
+static void emitStore(const LIRInst& inst) {
+  LIRVar* var = inst.var;
+  uint32_t val = reg(inst.src[1]);
+  if (isWide(var->width)) {
+    if (inst.src[0] < 0) emitOp(BC_STOREW, {varAddr(inst), val, slotNum(var->width)});
+    else emitOp(BC_STOREXW, {varAddr(inst), reg(inst.src[0]), val, slotNum(var->width)});
+  } else {
+    if (inst.src[0] < 0) emitOp(sizedOp(BC_STORE1, storageSize(var)), {varAddr(inst), val});
+    else emitOp(sizedOp(BC_STOREX1, storageSize(var)), {varAddr(inst), reg(inst.src[0]), val});
+  }
+}
+
+static void emitExt(const LIRInst& inst) {
+  int srcWidth = tmpWidth(inst.src[0]);
+  uint32_t dst = reg(inst.dst), src = reg(inst.src[0]);
+  if (isWide(inst.width) || isWide(srcWidth)) emitOp(BC_EXTW, {dst, (uint64_t)inst.width, src, (uint64_t)srcWidth, inst.sign});
+  else if (inst.sign && inst.width > srcWidth) emitOp(BC_SEXT, {dst, src, (uint64_t)srcWidth, (uint64_t)inst.width});
+  else emitOp(BC_MASK, {dst, src, (uint64_t)inst.width});
+}
+
+static void emitArith(const LIRInst& inst) {
+  uint32_t dst = reg(inst.dst), left = reg(inst.src[0]), right = reg(inst.src[1]);
+  uint64_t width = inst.width;
+  bool wide = isWide(inst.width);
+  switch (inst.op) {
+    case LIR_ADD: emitOp(wide ? BC_ADDW : BC_ADD, {dst, left, right, width}); break;
+    case LIR_SUB: emitOp(wide ? BC_SUBW : BC_SUB, {dst, left, right, width}); break;
+    case LIR_MUL: emitOp(wide ? BC_MULW : BC_MUL, {dst, left, right, width}); break;
+    case LIR_DIV:
+    case LIR_REM:
+      if (wide) emitOp(inst.op == LIR_DIV ? BC_DIVW : BC_REMW, {dst, left, right, width, inst.sign});
+      else if (inst.sign) emitOp(inst.op == LIR_DIV ? BC_DIVS : BC_REMS, {dst, left, right, width, width});
+      else emitOp(inst.op == LIR_DIV ? BC_DIVU : BC_REMU, {dst, left, right});
+      break;
+    case LIR_AND: if (wide) emitOp(BC_ANDW, {dst, left, right, width}); else emitOp(BC_AND, {dst, left, right}); break;
+    case LIR_OR: if (wide) emitOp(BC_ORW, {dst, left, right, width}); else emitOp(BC_OR, {dst, left, right}); break;
+    case LIR_XOR: if (wide) emitOp(BC_XORW, {dst, left, right, width}); else emitOp(BC_XOR, {dst, left, right}); break;
+    default: Panic();
+  }
+}
+
+static void emitCompare(const LIRInst& inst) {
+  uint32_t dst = reg(inst.dst), left = reg(inst.src[0]), right = reg(inst.src[1]);
+  uint64_t width = tmpWidth(inst.src[0]);
+  int cmp = inst.op - LIR_LT;
+  if (isWide(width)) {
+    emitOp(BC_CMPW, {dst, left, right, width, (uint64_t)(cmp | (inst.sign ? BC_CMP_SIGN : 0))});
+  } else if (inst.op == LIR_EQ || inst.op == LIR_NEQ) {
+    emitOp(inst.op == LIR_EQ ? BC_EQ : BC_NE, {dst, left, right});
+  } else if (inst.sign) {
+    emitOp((BCOp)(BC_LTS + cmp), {dst, left, right, width});
+  } else {
+    emitOp((BCOp)(BC_LTU + cmp), {dst, left, right});
+  }
+}
+
+/* shift amounts wider than 64 bits saturate, wide values are shifted by an amount in a register */
+static void emitShift(const LIRInst& inst) {
+  uint32_t dst = reg(inst.dst), val = reg(inst.src[0]);
+  uint64_t width = inst.width;
+  bool left = inst.op == LIR_SHL;
+  bool arith = !left && inst.sign;
+  uint32_t amount = 0;
+  if (inst.src[1] >= 0) {
+    amount = reg(inst.src[1]);
+    int amountWidth = tmpWidth(inst.src[1]);
+    if (isWide(amountWidth)) {
+      uint32_t sat = scratchReg(NARROW_WIDTH);
+      emitOp(BC_SATW, {sat, amount, slotNum(amountWidth)});
+      amount = sat;
+    }
+  } else if (isWide(width)) {
+    amount = scratchReg(NARROW_WIDTH);
+    emitOp(BC_CONST, {amount, (uint64_t)inst.imm});
+  }
+  if (isWide(width)) {
+    if (left) emitOp(BC_SHLW, {dst, val, amount, width});
+    else emitOp(BC_SHRW, {dst, val, amount, width, arith});
+    return;
+  }
+  if (inst.src[1] >= 0) {
+    if (left) emitOp(BC_SHL, {dst, val, amount, width});
+    else if (arith) emitOp(BC_SHRS, {dst, val, amount, width, width});
+    else emitOp(BC_SHRU, {dst, val, amount});
+    return;
+  }
+  if (arith) emitOp(BC_SHRSI, {dst, val, (uint64_t)MIN(inst.imm, (int64_t)63), width, width});
+  else if (inst.imm >= (int64_t)width) emitOp(BC_CONST, {dst, 0});
+  else if (left) emitOp(BC_SHLI, {dst, val, (uint64_t)inst.imm, width});
+  else emitOp(BC_SHRUI, {dst, val, (uint64_t)inst.imm});
+}
+
+static void emitReduce(const LIRInst& inst) {
+  uint32_t dst = reg(inst.dst), src = reg(inst.src[0]);
+  uint64_t width = tmpWidth(inst.src[0]);
+  bool wide = isWide(width);
+  switch (inst.op) {
+    case LIR_ANDR: emitOp(wide ? BC_ANDRW : BC_ANDR, {dst, src, width}); break;
+    case LIR_ORR: if (wide) emitOp(BC_ORRW, {dst, src, width}); else emitOp(BC_ORR, {dst, src}); break;
+    case LIR_XORR: if (wide) emitOp(BC_XORRW, {dst, src, width}); else emitOp(BC_XORR, {dst, src}); break;
+    default: Panic();
+  }
+}
+
+/* activation of ids is split into the bytes of active flags */
+static void emitActivate(const std::vector<int>& ids, int cond) {
+  std::map<int, uint32_t> masks;
+  for (int id : ids) masks[id / 8] |= 1 << (id % 8);
+  for (auto iter : masks) {
+    if (cond >= 0) emitOp(BC_ACTC, {reg(cond), (uint64_t)iter.first, iter.second});
+    else emitOp(BC_ACT, {(uint64_t)iter.first, iter.second});
+  }
+}
+
+static void emitInst(const LIRInst& inst, std::vector<size_t>& fixups) {
+  switch (inst.op) {
+    case LIR_CONST: emitConst(reg(inst.dst), inst.cons, inst.width); break;
+    case LIR_LOAD: emitLoad(inst); break;
+    case LIR_STORE: emitStore(inst); break;
+    case LIR_EXT: emitExt(inst); break;
+    case LIR_ADD: case LIR_SUB: case LIR_MUL: case LIR_DIV: case LIR_REM:
+    case LIR_AND: case LIR_OR: case LIR_XOR:
+      emitArith(inst);
+      break;
+    case LIR_LT: case LIR_LEQ: case LIR_GT: case LIR_GEQ: case LIR_EQ: case LIR_NEQ:
+      emitCompare(inst);
+      break;
+    case LIR_NOT:
+      if (isWide(inst.width)) emitOp(BC_NOTW, {reg(inst.dst), reg(inst.src[0]), (uint64_t)inst.width});
+      else emitOp(BC_NOT, {reg(inst.dst), reg(inst.src[0]), (uint64_t)inst.width});
+      break;
+    case LIR_SHL:
+    case LIR_SHR: emitShift(inst); break;
+    case LIR_ANDR: case LIR_ORR: case LIR_XORR: emitReduce(inst); break;
+    case LIR_MUX:
+      if (isWide(inst.width)) emitOp(BC_MUXW, {reg(inst.dst), reg(inst.src[0]), reg(inst.src[1]), reg(inst.src[2]), (uint64_t)inst.width});
+      else emitOp(BC_MUX, {reg(inst.dst), reg(inst.src[0]), reg(inst.src[1]), reg(inst.src[2])});
+      break;
+    /* the targets of jumps are patched by ELSE and ENDIF */
+    case LIR_IF:
+      emitOp(BC_JZ, {reg(inst.src[0]), 0});
+      fixups.push_back(code.size() - 1);
+      break;
+    case LIR_ELSE:
+      emitOp(BC_JMP, {0});
+      code[fixups.back()] = code.size();
+      fixups.back() = code.size() - 1;
+      break;
+    case LIR_ENDIF:
+      code[fixups.back()] = code.size();
+      fixups.pop_back();
+      break;
+    /* loops jump back to the first instruction of the body, which is kept in fixups */
+    case LIR_LOOP:
+      emitConst(reg(inst.dst), {0}, LIR_IDX_WIDTH);
+      fixups.push_back(code.size());
+      break;
+    case LIR_ENDLOOP:
+      emitOp(BC_LOOP, {reg(inst.src[0]), (uint64_t)inst.imm, fixups.back()});
+      fixups.pop_back();
+      break;
+    case LIR_ACTIVATE: emitActivate(inst.ids, inst.src[0]); break;
+    case LIR_ACTIVATE_ALL:
+      if (inst.src[0] >= 0) emitOp(BC_ACTALLC, {reg(inst.src[0])});
+      else emitOp(BC_ACTALL, {});
+      break;
+    case LIR_PRINTF:
+      code.push_back(BC_PRINTF);
+      code.push_back(strIdx(inst.str));
+      code.push_back(inst.args.size());
+      for (int arg : inst.args) code.push_back(reg(arg));
+      break;
+    case LIR_ASSERT:
+      if (inst.src[1] >= 0) emitOp(BC_ASSERTC, {reg(inst.src[0]), reg(inst.src[1]), strIdx(inst.str)});
+      else emitOp(BC_ASSERT, {reg(inst.src[0]), strIdx(inst.str)});
+      break;
+    case LIR_EXIT: emitOp(BC_EXIT, {reg(inst.src[0]), (uint64_t)(uint32_t)inst.imm}); break;
+    default: Panic();
+  }
+}
+
+static uint32_t emitFunc(LIRFunc& func) {
+  curFunc = &func;
+  uint32_t entry = code.size();
+  tmpReg.resize(func.tmpWidth.size());
+  funcRegNum = 0;
+  for (size_t i = 0; i < func.tmpWidth.size(); i ++) {
+    tmpReg[i] = funcRegNum;
+    funcRegNum += slotNum(func.tmpWidth[i]);
+  }
+  std::vector<size_t> fixups;
+  for (const LIRInst& inst : func.insts) emitInst(inst, fixups);
+  Assert(fixups.empty(), "unbalanced if in %s", func.name.c_str());
+  emitOp(BC_RET, {});
+  regNum = MAX(regNum, funcRegNum);
+  return entry;
+}
+
+static void put(FILE* fp, uint32_t word) {
+  fwrite(&word, sizeof(word), 1, fp);
+}
+
+static void putStr(FILE* fp, const std::string& str) {
+  put(fp, str.length());
+  std::string padded = str;
+  padded.resize((str.length() + 3) & ~3, '\0');
+  fwrite(padded.data(), 1, padded.length(), fp);
+}
+
+static void putActivation(FILE* fp, const std::vector<int>& ids) {
+  std::map<int, uint32_t> masks;
+  for (int id : ids) masks[id / 8] |= 1 << (id % 8);
+  put(fp, masks.size());
+  for (auto iter : masks) {
+    put(fp, iter.first);
+    put(fp, iter.second);
+  }
+}
+
+static void emitHeader(std::string headerName, std::string bcName) {
+  FILE* fp = std::fopen(headerName.c_str(), "w");
+  Assert(fp, "can not open %s", headerName.c_str());
+  std::string name = program->name;
+  char* path = realpath(bcName.c_str(), nullptr);
+  Assert(path, "can not find %s", bcName.c_str());
+  fprintf(fp, "#ifndef %s_H\n#define %s_H\n", name.c_str(), name.c_str());
+  fprintf(fp, "#include \"interp.h\"\n\n");
+  fprintf(fp, "class S%s : public GSimInterp {\n", name.c_str());
+  fprintf(fp, "public:\n");
+  fprintf(fp, "S%s(const char* path = \"%s\") : GSimInterp(path) {}\n", name.c_str(), path);
+  free(path);
+  for (size_t i = 0; i < program->inputs.size(); i ++) {
+    LIRPort& port = program->inputs[i];
+    fprintf(fp, "void set_%s(%s val) { uint64_t words[%d] = {0}; memcpy(words, &val, sizeof(val)); setInput(%ld, words); }\n",
+      port.name.c_str(), widthUType(port.width).c_str(), slotNum(port.width), i);
+  }
+  for (size_t i = 0; i < program->outputs.size(); i ++) {
+    LIRPort& port = program->outputs[i];
+    std::string type = widthUType(port.width);
+    fprintf(fp, "%s get_%s() { uint64_t words[%d]; getOutput(%ld, words); %s ret; memcpy(&ret, words, sizeof(ret)); return ret; }\n",
+      type.c_str(), port.name.c_str(), slotNum(port.width), i, type.c_str());
+  }
+  fprintf(fp, "};\n#endif\n");
+  fclose(fp);
+}
+
+void graph::interpEmitter() {
+  program = lir;
+  Assert(program, "genLIR should be called before interpEmitter");
+  Assert(program->unsupported.empty(), "the interpreter does not support %s, use --backend=cpp", program->unsupported.c_str());
+  code.clear();
+  strs.clear();
+  regNum = 0;
+
+  /* variables are aligned to their storage sizes */
+  uint64_t stateSize = 0;
+  varOffset.resize(program->vars.size());
+  for (LIRVar* var : program->vars) {
+    uint32_t align = MIN(storageSize(var), 8u);
+    stateSize = (stateSize + align - 1) / align * align;
+    varOffset[var->id] = stateSize;
+    stateSize += (uint64_t)storageSize(var) * var->entryNum;
+    Assert(stateSize < UINT_MAX, "the state of the model exceeds 4 GB");
+  }
+
+  std::vector<uint32_t> superEntry(program->superNum, BC_NONE);
+  /* operands are resolved to addresses when the bytecode is loaded, so shared bodies are bound here */
+  for (int id = 0; id < program->superNum; id ++) {
+    if (program->supers[id]) superEntry[id] = emitFunc(*program->instantiate(program->supers[id]));
+  }
+  uint32_t initEntry = emitFunc(program->init);
+  uint32_t prologueEntry = emitFunc(program->prologue);
+  std::vector<uint32_t> resetEntry;
+  for (LIRReset& reset : program->resets) resetEntry.push_back(emitFunc(reset.func));
+
+  std::string prefix = globalConfig.OutputDir + "/" + name;
+  FILE* fp = std::fopen((prefix + ".gbc").c_str(), "wb");
+  Assert(fp, "can not open %s.gbc", prefix.c_str());
+  put(fp, BC_MAGIC);
+  put(fp, BC_VERSION);
+  put(fp, stateSize);
+  put(fp, MAX((program->superNum + 7) / 8, 1));
+  put(fp, regNum);
+  put(fp, program->superNum);
+  put(fp, code.size());
+  fwrite(code.data(), sizeof(uint32_t), code.size(), fp);
+  put(fp, strs.size());
+  for (const std::string& str : strs) putStr(fp, str);
+  for (uint32_t entry : superEntry) put(fp, entry);
+  put(fp, initEntry);
+  put(fp, prologueEntry);
+  put(fp, program->resets.size());
+  for (size_t i = 0; i < program->resets.size(); i ++) {
+    LIRReset& reset = program->resets[i];
+    put(fp, varOffset[reset.cond->id]);
+    put(fp, storageSize(reset.cond));
+    put(fp, resetEntry[i]);
+    put(fp, reset.activateAll);
+    putActivation(fp, reset.ids);
+  }
+  put(fp, program->inputs.size());
+  for (LIRPort& port : program->inputs) {
+    putStr(fp, port.name);
+    put(fp, port.var->width);
+    put(fp, varOffset[port.var->id]);
+    putActivation(fp, port.ids);
+  }
+  put(fp, program->outputs.size());
+  for (LIRPort& port : program->outputs) {
+    putStr(fp, port.name);
+    put(fp, port.var ? port.var->width : MAX(port.width, 1));
+    put(fp, port.var ? varOffset[port.var->id] : BC_NONE);
+    put(fp, port.cons.size());
+    for (uint64_t word : port.cons) {
+      put(fp, (uint32_t)word);
+      put(fp, (uint32_t)(word >> 32));
+    }
+  }
+  fclose(fp);
+
+  emitHeader(prefix + ".h", prefix + ".gbc");
+  printStat("[interpEmitter] %ld code words, %d registers, %ld bytes of state\n", code.size(), regNum, stateSize);
+}
@@ -0,0 +1,603 @@
+/*
+  llvmEmitter: compile the LIR of the model into a native object file with the LLVM libraries
+  The model state is one struct of the active flags (one bit per superNode, as cppEmitter) and all LIR
+  variables. Every superNode becomes a function, step() evaluates the active ones in cppId order and then
+  the resets. [dir]/[top].o exports C functions on the state, [dir]/[top].h wraps them in class S[top]
+  with the interface of the C++ model (set_*, get_*, step(), cycles).
+*/
+
+#ifdef GSIM_LLVM
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#endif
+
+#include "common.h"
+
+#ifndef GSIM_LLVM
+
+void graph::llvmEmitter() {
+  Assert(0, "gsim is built without LLVM, rebuild it with LLVM=1 to use --backend=llvm");
+}
+
+#else
+
+#define FLAG_FIELD 0
+#define VAR_FIELD(var) ((var)->id + 1)
+/* widths of division supported by the code generator of LLVM */
+#define MAX_DIV_WIDTH 128
+
+static LIRProgram* program;
+static llvm::LLVMContext* ctx;
+static llvm::Module* mod;
+static llvm::IRBuilder<>* builder;
+static llvm::StructType* stateType;
+static llvm::Value* state;
+static std::vector<llvm::Value*> tmps;
+static int flagNum;
+/* parameters of the shared body being emitted: offsets of vars from the instance base, flag bytes and masks of ids */
+static llvm::Value* instBase = nullptr;
+static std::map<LIRVar*, uint64_t> varDelta;
+static std::map<int, std::pair<llvm::Value*, llvm::Value*>> idParam;
+
+class BranchInfo {
+public:
+  llvm::BasicBlock* elseBB;
+  llvm::BasicBlock* endBB;
+  bool hasElse = false;
+  /* loops branch back to the header, which takes the next index */
+  llvm::BasicBlock* headerBB = nullptr;
+  llvm::PHINode* index = nullptr;
+};
+
+static llvm::IntegerType* intType(int width) { return builder->getIntNTy(width); }
+
+static llvm::IntegerType* storageType(LIRVar* var) { return intType(widthBits(var->width)); }
+
+static int wordNum(int width) { return (MAX(width, 1) + 63) / 64; }
+
+static llvm::Value* fit(llvm::Value* val, int width, bool sign) {
+  int valWidth = val->getType()->getIntegerBitWidth();
+  if (valWidth == width) return val;
+  if (valWidth > width) return builder->CreateTrunc(val, intType(width));
+  return sign ? builder->CreateSExt(val, intType(width)) : builder->CreateZExt(val, intType(width));
+}
+
+static llvm::Function* newFunc(std::string funcName, bool exported, std::vector<llvm::Type*> extraArgs = {}) {
+  std::vector<llvm::Type*> args = {stateType->getPointerTo()};
+  args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+  llvm::FunctionType* type = llvm::FunctionType::get(builder->getVoidTy(), args, false);
+  llvm::Function* func = llvm::Function::Create(type, exported ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage, funcName, mod);
+  func->addFnAttr(llvm::Attribute::NoUnwind);
+  builder->SetInsertPoint(llvm::BasicBlock::Create(*ctx, "entry", func));
+  state = func->getArg(0);
+  return func;
+}
+
+static llvm::Value* flagAddr(int idx) {
+  return builder->CreateInBoundsGEP(stateType, state, {builder->getInt32(0), builder->getInt32(FLAG_FIELD), builder->getInt32(idx)});
+}
+
+static llvm::Value* varAddr(LIRVar* var, llvm::Value* idx) {
+  if (instBase && varDelta.find(var) != varDelta.end()) {
+    llvm::Value* base = builder->CreateInBoundsGEP(builder->getInt8Ty(), instBase, builder->getInt64(varDelta[var]));
+    return builder->CreateInBoundsGEP(storageType(var), builder->CreateBitCast(base, storageType(var)->getPointerTo()), idx);
+  }
+  return builder->CreateInBoundsGEP(stateType, state, {builder->getInt32(0), builder->getInt32(VAR_FIELD(var)), idx});
+}
+
+static llvm::Value* instAddr(const LIRInst& inst) {
+  llvm::Value* idx = builder->getInt64(inst.imm);
+  if (inst.src[0] >= 0) idx = builder->CreateAdd(builder->CreateZExt(tmps[inst.src[0]], builder->getInt64Ty()), idx);
+  return varAddr(inst.var, idx);
+}
+
+static llvm::Value* loadVar(LIRVar* var, llvm::Value* addr) {
+  return fit(builder->CreateLoad(storageType(var), addr), var->width, false);
+}
+
+static void storeVar(LIRVar* var, llvm::Value* addr, llvm::Value* val) {
+  builder->CreateStore(fit(val, widthBits(var->width), false), addr);
+}
+
+/* the body of if (cond), closed by endIf() */
+static llvm::BasicBlock* beginIf(llvm::Value* cond) {
+  llvm::Function* func = builder->GetInsertBlock()->getParent();
+  llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(*ctx, "then", func);
+  llvm::BasicBlock* endBB = llvm::BasicBlock::Create(*ctx, "endif", func);
+  builder->CreateCondBr(cond, thenBB, endBB);
+  builder->SetInsertPoint(thenBB);
+  return endBB;
+}
+
+static void endIf(llvm::BasicBlock* endBB) {
+  builder->CreateBr(endBB);
+  builder->SetInsertPoint(endBB);
+}
+
+static void activateAll() {
+  builder->CreateMemSet(flagAddr(0), builder->getInt8(0xff), flagNum, llvm::MaybeAlign(1));
+}
+
+static void orFlag(llvm::Value* addr, llvm::Value* mask, llvm::Value* cond) {
+  if (cond) mask = builder->CreateSelect(cond, mask, builder->getInt8(0));
+  builder->CreateStore(builder->CreateOr(builder->CreateLoad(builder->getInt8Ty(), addr), mask), addr);
+}
+
+/* flags |= -cond & mask, as the activation in cppEmitter, idParams are activated by their bytes and masks */
+static void activate(const std::vector<int>& ids, llvm::Value* cond) {
+  std::map<int, uint8_t> masks;
+  for (int id : ids) {
+    if (idParam.find(id) == idParam.end()) {
+      masks[id / 8] |= 1 << (id % 8);
+      continue;
+    }
+    llvm::Value* addr = builder->CreateInBoundsGEP(stateType, state, {builder->getInt32(0), builder->getInt32(FLAG_FIELD), idParam[id].first});
+    orFlag(addr, idParam[id].second, cond);
+  }
+  for (auto iter : masks) orFlag(flagAddr(iter.first), builder->getInt8(iter.second), cond);
+}
+
+static llvm::FunctionCallee libFunc(const char* funcName, llvm::Type* ret, std::vector<llvm::Type*> args, bool varArg = false) {
+  return mod->getOrInsertFunction(funcName, llvm::FunctionType::get(ret, args, varArg));
+}
+
+static llvm::Value* stderrFile() {
+  llvm::Type* ptrType = builder->getInt8PtrTy();
+  return builder->CreateLoad(ptrType, mod->getOrInsertGlobal("stderr", ptrType));
+}
+
+static llvm::FunctionCallee fprintfFunc() {
+  return libFunc("fprintf", builder->getInt32Ty(), {builder->getInt8PtrTy(), builder->getInt8PtrTy()}, true);
+}
+
+/* %d/%x/%c of gprintf are mapped to the conversions of 64-bit arguments in fprintf */
+static void emitPrintf(const LIRInst& inst) {
+  std::string fmt;
+  std::vector<llvm::Value*> args = {stderrFile(), nullptr};
+  size_t argIdx = 0;
+  for (size_t i = 0; i < inst.str.length(); i ++) {
+    fmt += inst.str[i];
+    if (inst.str[i] != '%' || i + 1 == inst.str.length()) continue;
+    char c = inst.str[++ i];
+    if (c == '%' || argIdx >= inst.args.size()) {
+      fmt += c;
+      continue;
+    }
+    llvm::Value* val = fit(tmps[inst.args[argIdx ++]], 64, false);
+    switch (c) {
+      case 'c': fmt += 'c'; val = builder->CreateTrunc(val, builder->getInt32Ty()); break;
+      case 'x': fmt += "lx"; break;
+      default: fmt += "ld"; break;
+    }
+    args.push_back(val);
+  }
+  args[1] = builder->CreateGlobalStringPtr(fmt);
+  builder->CreateCall(fprintfFunc(), args);
+}
+
+static void emitAssert(const LIRInst& inst) {
+  llvm::Value* fail = builder->CreateNot(tmps[inst.src[0]]);
+  if (inst.src[1] >= 0) fail = builder->CreateAnd(fail, tmps[inst.src[1]]);
+  llvm::BasicBlock* endBB = beginIf(fail);
+  builder->CreateCall(fprintfFunc(), {stderrFile(), builder->CreateGlobalStringPtr(ANSI_FMT("%s", ANSI_FG_RED) "\n"), builder->CreateGlobalStringPtr(inst.str)});
+  builder->CreateCall(libFunc("abort", builder->getVoidTy(), {}));
+  endIf(endBB);
+}
+
+static void emitExit(const LIRInst& inst) {
+  llvm::BasicBlock* endBB = beginIf(tmps[inst.src[0]]);
+  builder->CreateCall(libFunc("exit", builder->getVoidTy(), {builder->getInt32Ty()}), {builder->getInt32(inst.imm)});
+  endIf(endBB);
+}
+
+/* x / 0 = 0 and x % 0 = 0 */
+static llvm::Value* emitDiv(const LIRInst& inst, llvm::Value* left, llvm::Value* right) {
+  Assert(inst.width <= MAX_DIV_WIDTH, "%d-bit division is not supported by the LLVM backend", inst.width);
+  llvm::Value* zero = llvm::ConstantInt::get(right->getType(), 0);
+  llvm::Value* isZero = builder->CreateICmpEQ(right, zero);
+  llvm::Value* divisor = builder->CreateSelect(isZero, llvm::ConstantInt::get(right->getType(), 1), right);
+  llvm::Value* ret;
+  if (inst.op == LIR_DIV) ret = inst.sign ? builder->CreateSDiv(left, divisor) : builder->CreateUDiv(left, divisor);
+  else ret = inst.sign ? builder->CreateSRem(left, divisor) : builder->CreateURem(left, divisor);
+  return builder->CreateSelect(isZero, zero, ret);
+}
+
+/* shifts by at least the width give 0 (or the sign for arithmetic right shifts) instead of poison */
+static llvm::Value* emitShift(const LIRInst& inst, llvm::Value* val) {
+  int width = inst.width;
+  llvm::Type* type = val->getType();
+  bool arith = inst.op == LIR_SHR && inst.sign;
+  if (inst.src[1] < 0) {
+    if (inst.imm >= width) return arith ? builder->CreateAShr(val, width - 1) : llvm::ConstantInt::get(type, 0);
+    if (inst.op == LIR_SHL) return builder->CreateShl(val, inst.imm);
+    return arith ? builder->CreateAShr(val, inst.imm) : builder->CreateLShr(val, inst.imm);
+  }
+  llvm::Value* amount = tmps[inst.src[1]];
+  int amountWidth = amount->getType()->getIntegerBitWidth();
+  llvm::Value* overflow = nullptr;
+  if (amountWidth >= 31 || ((int64_t)1 << amountWidth) > width) {
+    overflow = builder->CreateICmpUGE(amount, llvm::ConstantInt::get(amount->getType(), width));
+  }
+  amount = fit(amount, width, false);
+  llvm::Value* ret;
+  if (inst.op == LIR_SHL) ret = builder->CreateShl(val, amount);
+  else ret = arith ? builder->CreateAShr(val, amount) : builder->CreateLShr(val, amount);
+  if (!overflow) return ret;
+  llvm::Value* saturated = arith ? builder->CreateAShr(val, width - 1) : llvm::ConstantInt::get(type, 0);
+  return builder->CreateSelect(overflow, saturated, ret);
+}
+
+static llvm::CmpInst::Predicate comparePred(LIROp op, bool sign) {
+  switch (op) {
+    case LIR_LT: return sign ? llvm::CmpInst::ICMP_SLT : llvm::CmpInst::ICMP_ULT;
+    case LIR_LEQ: return sign ? llvm::CmpInst::ICMP_SLE : llvm::CmpInst::ICMP_ULE;
+    case LIR_GT: return sign ? llvm::CmpInst::ICMP_SGT : llvm::CmpInst::ICMP_UGT;
+    case LIR_GEQ: return sign ? llvm::CmpInst::ICMP_SGE : llvm::CmpInst::ICMP_UGE;
+    case LIR_EQ: return llvm::CmpInst::ICMP_EQ;
+    case LIR_NEQ: return llvm::CmpInst::ICMP_NE;
+    default: Panic();
+  }
+  return llvm::CmpInst::ICMP_EQ;
+}
+
+static void emitInst(const LIRInst& inst, std::vector<BranchInfo>& branches) {
+  llvm::Value* src[3] = {nullptr, nullptr, nullptr};
+  for (int i = 0; i < 3; i ++) {
+    if (inst.src[i] >= 0) src[i] = tmps[inst.src[i]];
+  }
+  llvm::Value* ret = nullptr;
+  switch (inst.op) {
+    case LIR_CONST: ret = llvm::ConstantInt::get(*ctx, llvm::APInt(inst.width, inst.cons)); break;
+    case LIR_LOAD: ret = loadVar(inst.var, instAddr(inst)); break;
+    case LIR_STORE: storeVar(inst.var, instAddr(inst), src[1]); break;
+    case LIR_EXT: ret = fit(src[0], inst.width, inst.sign); break;
+    case LIR_ADD: ret = builder->CreateAdd(src[0], src[1]); break;
+    case LIR_SUB: ret = builder->CreateSub(src[0], src[1]); break;
+    case LIR_MUL: ret = builder->CreateMul(src[0], src[1]); break;
+    case LIR_DIV:
+    case LIR_REM: ret = emitDiv(inst, src[0], src[1]); break;
+    case LIR_LT: case LIR_LEQ: case LIR_GT: case LIR_GEQ: case LIR_EQ: case LIR_NEQ:
+      ret = builder->CreateICmp(comparePred(inst.op, inst.sign), src[0], src[1]);
+      break;
+    case LIR_AND: ret = builder->CreateAnd(src[0], src[1]); break;
+    case LIR_OR: ret = builder->CreateOr(src[0], src[1]); break;
+    case LIR_XOR: ret = builder->CreateXor(src[0], src[1]); break;
+    case LIR_NOT: ret = builder->CreateNot(src[0]); break;
+    case LIR_SHL:
+    case LIR_SHR: ret = emitShift(inst, src[0]); break;
+    case LIR_ANDR: ret = builder->CreateICmpEQ(src[0], llvm::ConstantInt::get(src[0]->getType(), -1, true)); break;
+    case LIR_ORR: ret = builder->CreateICmpNE(src[0], llvm::ConstantInt::get(src[0]->getType(), 0)); break;
+    case LIR_XORR: ret = builder->CreateTrunc(builder->CreateUnaryIntrinsic(llvm::Intrinsic::ctpop, src[0]), builder->getInt1Ty()); break;
+    case LIR_MUX: ret = builder->CreateSelect(src[0], src[1], src[2]); break;
+    case LIR_IF: {
+      llvm::Function* func = builder->GetInsertBlock()->getParent();
+      BranchInfo info;
+      llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(*ctx, "then", func);
+      info.elseBB = llvm::BasicBlock::Create(*ctx, "else", func);
+      info.endBB = llvm::BasicBlock::Create(*ctx, "endif", func);
+      builder->CreateCondBr(src[0], thenBB, info.elseBB);
+      builder->SetInsertPoint(thenBB);
+      branches.push_back(info);
+      break;
+    }
+    case LIR_ELSE:
+      builder->CreateBr(branches.back().endBB);
+      builder->SetInsertPoint(branches.back().elseBB);
+      branches.back().hasElse = true;
+      break;
+    case LIR_ENDIF:
+      builder->CreateBr(branches.back().endBB);
+      if (!branches.back().hasElse) {
+        builder->SetInsertPoint(branches.back().elseBB);
+        builder->CreateBr(branches.back().endBB);
+      }
+      builder->SetInsertPoint(branches.back().endBB);
+      branches.pop_back();
+      break;
+    case LIR_LOOP: {
+      llvm::Function* func = builder->GetInsertBlock()->getParent();
+      BranchInfo info;
+      llvm::BasicBlock* preBB = builder->GetInsertBlock();
+      info.headerBB = llvm::BasicBlock::Create(*ctx, "loop", func);
+      info.endBB = llvm::BasicBlock::Create(*ctx, "endloop", func);
+      builder->CreateBr(info.headerBB);
+      builder->SetInsertPoint(info.headerBB);
+      info.index = builder->CreatePHI(intType(LIR_IDX_WIDTH), 2);
+      info.index->addIncoming(builder->getIntN(LIR_IDX_WIDTH, 0), preBB);
+      branches.push_back(info);
+      ret = info.index;
+      break;
+    }
+    case LIR_ENDLOOP: {
+      BranchInfo& info = branches.back();
+      llvm::Value* next = builder->CreateAdd(info.index, builder->getIntN(LIR_IDX_WIDTH, 1));
+      info.index->addIncoming(next, builder->GetInsertBlock());
+      builder->CreateCondBr(builder->CreateICmpULT(next, builder->getIntN(LIR_IDX_WIDTH, inst.imm)), info.headerBB, info.endBB);
+      builder->SetInsertPoint(info.endBB);
+      branches.pop_back();
+      break;
+    }
+    case LIR_ACTIVATE: activate(inst.ids, src[0]); break;
+    case LIR_ACTIVATE_ALL:
+      if (src[0]) {
+        llvm::BasicBlock* endBB = beginIf(src[0]);
+        activateAll();
+        endIf(endBB);
+      } else {
+        activateAll();
+      }
+      break;
+    case LIR_PRINTF: emitPrintf(inst); break;
+    case LIR_ASSERT: emitAssert(inst); break;
+    case LIR_EXIT: emitExit(inst); break;
+    default: Panic();
+  }
+  if (inst.dst >= 0) tmps[inst.dst] = ret;
+}
+
+static void emitBody(LIRFunc& func) {
+  tmps.assign(func.tmpWidth.size(), nullptr);
+  std::vector<BranchInfo> branches;
+  for (const LIRInst& inst : func.insts) emitInst(inst, branches);
+  Assert(branches.empty(), "unbalanced if in %s", func.name.c_str());
+  builder->CreateRetVoid();
+}
+
+static llvm::Function* emitFunc(LIRFunc& func) {
+  llvm::Function* ret = newFunc(func.name, false);
+  emitBody(func);
+  return ret;
+}
+
+static uint64_t varOffset(LIRVar* var) {
+  return mod->getDataLayout().getStructLayout(stateType)->getElementOffset(VAR_FIELD(var));
+}
+
+/*
+  a body shared by deduplicated superNodes takes a constant table of its parameters: the offset of the instance
+  base, which is the first var of the member in varParams, then the flag byte and mask of every idParam
+*/
+static llvm::Function* emitShared(LIRFunc& func) {
+  llvm::Type* wordType = builder->getInt64Ty();
+  llvm::Function* ret = newFunc(func.name, false, {wordType->getPointerTo()});
+  llvm::Value* table = ret->getArg(1);
+  int idx = 0;
+  auto param = [&]() { return builder->CreateLoad(wordType, builder->CreateInBoundsGEP(wordType, table, builder->getInt64(idx ++))); };
+  instBase = builder->CreateInBoundsGEP(builder->getInt8Ty(), builder->CreateBitCast(state, builder->getInt8PtrTy()), param());
+  for (LIRVar* var : func.varParams) varDelta[var] = varOffset(var) - varOffset(func.varParams[0]);
+  /* loaded at the entry since stores to the state may alias the table */
+  for (int id : func.idParams) {
+    llvm::Value* byte = param();
+    idParam[id] = std::make_pair(byte, builder->CreateTrunc(param(), builder->getInt8Ty()));
+  }
+  emitBody(func);
+  instBase = nullptr;
+  varDelta.clear();
+  idParam.clear();
+  return ret;
+}
+
+/* nullptr if the block of func is not laid out as the one of the shared body */
+static llvm::Function* emitMember(LIRFunc& func, llvm::Function* body) {
+  LIRFunc* proto = func.proto;
+  for (size_t i = 0; i < func.varArgs.size(); i ++) {
+    if (varOffset(func.varArgs[i]) - varOffset(func.varArgs[0]) != varOffset(proto->varParams[i]) - varOffset(proto->varParams[0])) return nullptr;
+  }
+  std::vector<llvm::Constant*> words = {builder->getInt64(func.varArgs.empty() ? 0 : varOffset(func.varArgs[0]))};
+  for (int id : func.idArgs) {
+    words.push_back(builder->getInt64(id / 8));
+    words.push_back(builder->getInt64(1 << (id % 8)));
+  }
+  llvm::ArrayType* type = llvm::ArrayType::get(builder->getInt64Ty(), words.size());
+  llvm::GlobalVariable* table = new llvm::GlobalVariable(*mod, type, true, llvm::GlobalValue::InternalLinkage, llvm::ConstantArray::get(type, words), func.name + "_args");
+  llvm::Function* ret = newFunc(func.name, false);
+  builder->CreateCall(body, {state, builder->CreateInBoundsGEP(type, table, {builder->getInt32(0), builder->getInt32(0)})});
+  builder->CreateRetVoid();
+  return ret;
+}
+
+/* the same evaluation order as the subSteps of cppEmitter: a byte of flags is skipped if no superNode in it is active */
+static void emitStep(std::vector<llvm::Function*>& superFuncs, llvm::Function* prologue, std::vector<llvm::Function*>& resetFuncs) {
+  newFunc(program->name + "_step", true);
+  builder->CreateCall(prologue, {state});
+  for (int idx = 0; idx < program->superNum; idx += 8) {
+    llvm::BasicBlock* byteEnd = beginIf(builder->CreateICmpNE(builder->CreateLoad(builder->getInt8Ty(), flagAddr(idx / 8)), builder->getInt8(0)));
+    for (int id = idx; id < idx + 8 && id < program->superNum; id ++) {
+      if (!superFuncs[id]) continue;
+      llvm::Value* addr = flagAddr(id / 8);
+      llvm::Value* flag = builder->CreateLoad(builder->getInt8Ty(), addr);
+      llvm::Value* bit = builder->getInt8(1 << (id % 8));
+      llvm::BasicBlock* superEnd = beginIf(builder->CreateICmpNE(builder->CreateAnd(flag, bit), builder->getInt8(0)));
+      builder->CreateStore(builder->CreateAnd(flag, builder->CreateNot(bit)), addr);
+      builder->CreateCall(superFuncs[id], {state});
+      endIf(superEnd);
+    }
+    endIf(byteEnd);
+  }
+  /* resetAll */
+  for (size_t i = 0; i < program->resets.size(); i ++) {
+    LIRReset& reset = program->resets[i];
+    llvm::Value* cond = builder->CreateICmpNE(loadVar(reset.cond, varAddr(reset.cond, builder->getInt64(0))), builder->getIntN(reset.cond->width, 0));
+    llvm::BasicBlock* endBB = beginIf(cond);
+    if (reset.activateAll) activateAll();
+    else activate(reset.ids, nullptr);
+    builder->CreateCall(resetFuncs[i], {state});
+    endIf(endBB);
+  }
+  builder->CreateRetVoid();
+}
+
+static void emitInit(llvm::Function* initFunc) {
+  newFunc(program->name + "_init", true);
+  const llvm::DataLayout& layout = mod->getDataLayout();
+  builder->CreateMemSet(state, builder->getInt8(0), layout.getTypeAllocSize(stateType).getFixedSize(), llvm::MaybeAlign(1));
+  activateAll();
+  builder->CreateCall(initFunc, {state});
+  builder->CreateRetVoid();
+}
+
+/* ports pass their values as little-endian 64-bit words */
+static void emitPorts() {
+  llvm::Type* wordPtr = builder->getInt64Ty()->getPointerTo();
+  for (LIRPort& port : program->inputs) {
+    int bits = wordNum(port.width) * 64;
+    llvm::Function* func = newFunc(program->name + "_set_" + port.name, true, {wordPtr});
+    llvm::Value* val = fit(builder->CreateLoad(intType(bits), builder->CreateBitCast(func->getArg(1), intType(bits)->getPointerTo())), port.var->width, false);
+    llvm::Value* addr = varAddr(port.var, builder->getInt64(0));
+    llvm::BasicBlock* endBB = beginIf(builder->CreateICmpNE(loadVar(port.var, addr), val));
+    storeVar(port.var, addr, val);
+    activate(port.ids, nullptr);
+    endIf(endBB);
+    builder->CreateRetVoid();
+  }
+  for (LIRPort& port : program->outputs) {
+    int bits = wordNum(port.width) * 64;
+    llvm::Function* func = newFunc(program->name + "_get_" + port.name, true, {wordPtr});
+    llvm::Value* val;
+    if (port.var) val = fit(loadVar(port.var, varAddr(port.var, builder->getInt64(0))), bits, false);
+    else val = llvm::ConstantInt::get(*ctx, llvm::APInt(bits, port.cons));
+    builder->CreateStore(val, builder->CreateBitCast(func->getArg(1), intType(bits)->getPointerTo()));
+    builder->CreateRetVoid();
+  }
+}
+
+static void emitHeader(std::string headerName, uint64_t stateSize) {
+  FILE* fp = std::fopen(headerName.c_str(), "w");
+  Assert(fp, "can not open %s", headerName.c_str());
+  std::string name = program->name;
+  fprintf(fp, "#ifndef %s_H\n#define %s_H\n", name.c_str(), name.c_str());
+  fprintf(fp, "#include <cstdint>\n#include <cstdlib>\n#include <cstring>\n\n");
+  fprintf(fp, "extern \"C\" {\n");
+  fprintf(fp, "void %s_init(void* state);\n", name.c_str());
+  fprintf(fp, "void %s_step(void* state);\n", name.c_str());
+  for (LIRPort& port : program->inputs) fprintf(fp, "void %s_set_%s(void* state, const uint64_t* val);\n", name.c_str(), port.name.c_str());
+  for (LIRPort& port : program->outputs) fprintf(fp, "void %s_get_%s(void* state, uint64_t* val);\n", name.c_str(), port.name.c_str());
+  fprintf(fp, "}\n\n");
+  fprintf(fp, "class S%s {\n", name.c_str());
+  fprintf(fp, "public:\n");
+  fprintf(fp, "uint64_t cycles;\n");
+  fprintf(fp, "alignas(64) uint8_t state[%ld];\n", stateSize);
+  fprintf(fp, "S%s() { init(); }\n", name.c_str());
+  fprintf(fp, "void init() { cycles = 0; %s_init(state); }\n", name.c_str());
+  fprintf(fp, "void step() { %s_step(state); cycles ++; }\n", name.c_str());
+  for (LIRPort& port : program->inputs) {
+    fprintf(fp, "void set_%s(%s val) { uint64_t words[%d] = {0}; memcpy(words, &val, sizeof(val)); %s_set_%s(state, words); }\n",
+      port.name.c_str(), widthUType(port.width).c_str(), wordNum(port.width), name.c_str(), port.name.c_str());
+  }
+  for (LIRPort& port : program->outputs) {
+    std::string type = widthUType(port.width);
+    fprintf(fp, "%s get_%s() { uint64_t words[%d]; %s_get_%s(state, words); %s ret; memcpy(&ret, words, sizeof(ret)); return ret; }\n",
+      type.c_str(), port.name.c_str(), wordNum(port.width), name.c_str(), port.name.c_str(), type.c_str());
+  }
+  fprintf(fp, "};\n#endif\n");
+  fclose(fp);
+}
+
+static llvm::TargetMachine* targetMachine() {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string error;
+  const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+  Assert(target, "%s", error.c_str());
+  llvm::TargetMachine* machine = target->createTargetMachine(triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_);
+  /* the scheduler of SelectionDAG is quadratic in the size of basic blocks, which are large in superNodes */
+  machine->setFastISel(true);
+  mod->setTargetTriple(triple);
+  mod->setDataLayout(machine->createDataLayout());
+  return machine;
+}
+
+static void optimize(llvm::TargetMachine* machine) {
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder builder(machine);
+  builder.registerModuleAnalyses(MAM);
+  builder.registerCGSCCAnalyses(CGAM);
+  builder.registerFunctionAnalyses(FAM);
+  builder.registerLoopAnalyses(LAM);
+  builder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  llvm::ModulePassManager MPM = builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+  MPM.run(*mod, MAM);
+}
+
+static void emitObject(llvm::TargetMachine* machine, std::string objName) {
+  std::error_code err;
+  llvm::raw_fd_ostream out(objName, err, llvm::sys::fs::OF_None);
+  Assert(!err, "can not open %s: %s", objName.c_str(), err.message().c_str());
+  llvm::legacy::PassManager passes;
+  Assert(!machine->addPassesToEmitFile(passes, out, nullptr, llvm::CGFT_ObjectFile), "can not emit object files for %s", machine->getTargetTriple().str().c_str());
+  passes.run(*mod);
+  out.flush();
+}
+
+void graph::llvmEmitter() {
+  program = lir;
+  Assert(program, "genLIR should be called before llvmEmitter");
+  Assert(program->unsupported.empty(), "the LLVM backend does not support %s, use --backend=cpp", program->unsupported.c_str());
+  ctx = new llvm::LLVMContext();
+  mod = new llvm::Module(name, *ctx);
+  builder = new llvm::IRBuilder<>(*ctx);
+  llvm::TargetMachine* machine = targetMachine();
+
+  flagNum = MAX((program->superNum + 7) / 8, 1);
+  std::vector<llvm::Type*> fields = {llvm::ArrayType::get(builder->getInt8Ty(), flagNum)};
+  for (LIRVar* var : program->vars) fields.push_back(llvm::ArrayType::get(storageType(var), var->entryNum));
+  stateType = llvm::StructType::create(*ctx, fields, "S" + name);
+
+  /* members only pass their tables to shared bodies, inlining would copy the bodies back */
+  std::map<LIRFunc*, llvm::Function*> sharedFuncs;
+  for (LIRFunc* func : program->shared) {
+    sharedFuncs[func] = emitShared(*func);
+    sharedFuncs[func]->addFnAttr(llvm::Attribute::NoInline);
+  }
+  std::vector<llvm::Function*> superFuncs(program->superNum, nullptr);
+  for (int id = 0; id < program->superNum; id ++) {
+    LIRFunc* func = program->supers[id];
+    if (!func) continue;
+    /* members only pass their tables and are inlined into step() */
+    if (func->proto) superFuncs[id] = emitMember(*func, sharedFuncs[func->proto]);
+    if (superFuncs[id]) continue;
+    superFuncs[id] = emitFunc(*program->instantiate(func));
+    /* superNodes are kept as functions as in --dispatch, inlining all of them into step() makes GVN slow */
+    superFuncs[id]->addFnAttr(llvm::Attribute::NoInline);
+  }
+  std::vector<llvm::Function*> resetFuncs;
+  for (LIRReset& reset : program->resets) resetFuncs.push_back(emitFunc(reset.func));
+  llvm::Function* initFunc = emitFunc(program->init);
+  llvm::Function* prologue = emitFunc(program->prologue);
+  emitStep(superFuncs, prologue, resetFuncs);
+  emitInit(initFunc);
+  emitPorts();
+
+  std::string error;
+  llvm::raw_string_ostream errStream(error);
+  Assert(!llvm::verifyModule(*mod, &errStream), "invalid LLVM module: %s", errStream.str().c_str());
+  optimize(machine);
+
+  std::string prefix = globalConfig.OutputDir + "/" + name;
+  emitObject(machine, prefix + ".o");
+  uint64_t stateSize = mod->getDataLayout().getTypeAllocSize(stateType).getFixedSize();
+  emitHeader(prefix + ".h", stateSize);
+  printStat("[llvmEmitter] %ld functions, %ld bytes of state\n", mod->size(), stateSize);
+
+  delete builder;
+  delete mod;
+  delete machine;
+  delete ctx;
+}
+
+#endif
@@ -18,6 +18,9 @@ PNode* parseFIR(char *strbuf);
 void preorder_traversal(PNode* root);
 graph* AST2Graph(PNode* root);
 void inferAllWidth();
+uint64_t graphCacheKey(const char* input, size_t size);
+void saveGraph(graph* g, std::string fileName, uint64_t key);
+graph* loadGraph(std::string fileName, uint64_t key);
 
 Config::Config() {
   EnableDumpGraph = false;
@@ -26,6 +29,24 @@ Config::Config() {
   cppMaxSizeKB = -1;
   sep_module = "$";
   sep_aggr = "$$";
+  threadNum = 1;
+  workSteal = false;
+  repcut = false;
+  batchLanes = 1;
+  trace = false;
+  dispatch = false;
+  sparseMemKB = 0;
+  dumpLIR = false;
+  backend = "cpp";
+  dedup = false;
+  reroll = false;
+  graphCacheDir = "";
+  resumeFrom = "";
+  reportFile = "";
+  costProfile = 0;
+  srcMap = false;
+  profileFile = "";
+  alwaysActiveRate = 0.9;
 }
 Config globalConfig;
 
@@ -33,9 +54,11 @@ Config globalConfig;
 #define FUNC_WRAPPER_INTERNAL(func, name, dumpCond) \
   do { \
     struct timeval start = getTime(); \
+    PassReport report(#func); \
     func; \
     struct timeval end = getTime(); \
     showTime("{" #func "}", start, end); \
+    report.end(g); \
     if (dumpCond && globalConfig.EnableDumpGraph) g->dump(std::to_string(dumpIdx ++) + name); \
   } while(0)
 
@@ -52,6 +75,29 @@ static void printUsage(const char* ProgName) {
             << "      --cpp-max-size-KB=[num]      Specify the maximum size (approximate) of a generated C++ file.\n"
             << "      --sep-mod=[str]              Specify the seperator for submodule (default: $).\n"
             << "      --sep-aggr=[str]             Specify the seperator for aggregate member (default: $$).\n"
+            << "      --threads=[num]              Specify the number of threads to evaluate the model (default: 1).\n"
+            << "      --work-steal                 Evaluate active superNodes with a work-stealing runtime (requires --threads > 1).\n"
+            << "      --repcut                     Partition the graph among threads at register boundaries by replication (requires --threads > 1).\n"
+            << "      --batch=[num]                Evaluate [num] independent instances of the model in lockstep (default: 1).\n"
+            << "      --trace                      Emit waveform tracing of the signals evaluated in each cycle.\n"
+            << "      --dispatch                   Evaluate every superNode in its own function, dispatched by scanning the active flags.\n"
+            << "      --sparse-mem=[KB]            Back memories of at least [KB] KB by lazily allocated pages (default: 0, disabled).\n"
+            << "      --dump-lir                   Dump the low-level IR of the model to [dir]/[top].lir (llvm and interp backends only).\n"
+            << "      --backend=[cpp|llvm|interp]  Emit the model as C++ sources (default), compile it to [dir]/[top].o with LLVM,\n"
+            << "                                   or serialize it to [dir]/[top].gbc for the interpreter in emu/interp.cpp.\n"
+            << "      --dedup                      Share the code of identical superNodes, e.g. of identical module instances (llvm and interp backends only,\n"
+            << "                                   the cpp backend does not support it).\n"
+            << "      --reroll                     Roll the code of arrays of identical logic into loops over arrays (llvm and interp backends only,\n"
+            << "                                   the cpp backend does not support it).\n"
+            << "      --graph-cache=[dir]          Save the graph after the front end to [dir], keyed by the input and --sep-mod/--sep-aggr,\n"
+            << "                                   and load it instead of parsing and optimizing the same input again.\n"
+            << "      --resume-from=[file]         Load the graph saved by --graph-cache from [file]; the input file may be omitted.\n"
+            << "      --report=[file]              Write the time, memory and graph size after every pass to [file] in JSON.\n"
+            << "      --cost-profile=[num]         Time every [num]-th superNode by the time-stamp counter, costDump() writes the table (cpp backend).\n"
+            << "      --srcmap                     Write the emitted lines and the FIRRTL instances and lines of every superNode to [dir]/[top].srcmap.json.\n"
+            << "      --profile=[file]             Repartition by the activity in [file], written by costDump() of a model built with --cost-profile=1,\n"
+            << "                                   or the activity file of the emulator of a PERF=1 build.\n"
+            << "      --always-active=[rate]       With --profile, evaluate superNodes activated in more than [rate] of the cycles without checking (default 0.9, 1 to disable).\n"
             ;
 }
 
@@ -69,6 +115,24 @@ static char* parseCommandLine(int argc, char** argv) {
       {"cpp-max-size-KB", required_argument, nullptr, 0},
       {"sep-mod", required_argument, nullptr, 0},
       {"sep-aggr", required_argument, nullptr, 0},
+      {"threads", required_argument, nullptr, 0},
+      {"work-steal", no_argument, nullptr, 0},
+      {"repcut", no_argument, nullptr, 0},
+      {"batch", required_argument, nullptr, 0},
+      {"trace", no_argument, nullptr, 0},
+      {"dispatch", no_argument, nullptr, 0},
+      {"sparse-mem", required_argument, nullptr, 0},
+      {"dump-lir", no_argument, nullptr, 0},
+      {"backend", required_argument, nullptr, 0},
+      {"dedup", no_argument, nullptr, 0},
+      {"reroll", no_argument, nullptr, 0},
+      {"graph-cache", required_argument, nullptr, 0},
+      {"resume-from", required_argument, nullptr, 0},
+      {"report", required_argument, nullptr, 0},
+      {"cost-profile", required_argument, nullptr, 0},
+      {"srcmap", no_argument, nullptr, 0},
+      {"profile", required_argument, nullptr, 0},
+      {"always-active", required_argument, nullptr, 0},
       {nullptr, no_argument, nullptr, 0},
   };
 
@@ -83,6 +147,32 @@ static char* parseCommandLine(int argc, char** argv) {
                 case 4: sscanf(optarg, "%d", &globalConfig.cppMaxSizeKB); break;
                 case 5: globalConfig.sep_module = optarg; break;
                 case 6: globalConfig.sep_aggr = optarg; break;
+                case 7: sscanf(optarg, "%d", &globalConfig.threadNum);
+                        Assert(globalConfig.threadNum >= 1, "invalid thread number %d", globalConfig.threadNum);
+                        break;
+                case 8: globalConfig.workSteal = true; break;
+                case 9: globalConfig.repcut = true; break;
+                case 10: sscanf(optarg, "%d", &globalConfig.batchLanes);
+                        Assert(globalConfig.batchLanes >= 1, "invalid batch size %d", globalConfig.batchLanes);
+                        break;
+                case 11: globalConfig.trace = true; break;
+                case 12: globalConfig.dispatch = true; break;
+                case 13: sscanf(optarg, "%d", &globalConfig.sparseMemKB); break;
+                case 14: globalConfig.dumpLIR = true; break;
+                case 15: globalConfig.backend = optarg;
+                        Assert(globalConfig.backend == "cpp" || globalConfig.backend == "llvm" || globalConfig.backend == "interp", "invalid backend %s", optarg);
+                        break;
+                case 16: globalConfig.dedup = true; break;
+                case 17: globalConfig.reroll = true; break;
+                case 18: globalConfig.graphCacheDir = optarg; break;
+                case 19: globalConfig.resumeFrom = optarg; break;
+                case 20: globalConfig.reportFile = optarg; break;
+                case 21: sscanf(optarg, "%d", &globalConfig.costProfile);
+                        Assert(globalConfig.costProfile >= 1, "invalid cost profile interval %d", globalConfig.costProfile);
+                        break;
+                case 22: globalConfig.srcMap = true; break;
+                case 23: globalConfig.profileFile = optarg; break;
+                case 24: sscanf(optarg, "%lf", &globalConfig.alwaysActiveRate); break;
                 case 0:
                 default: printUsage(argv[0]); exit(EXIT_SUCCESS);
               }
@@ -95,7 +185,8 @@ static char* parseCommandLine(int argc, char** argv) {
       }
     }
   }
-  assert(0);
+  Assert(!globalConfig.resumeFrom.empty(), "no input file");
+  return NULL;
 }
 
 static char* readFile(const char *InputFileName, size_t &size, size_t &mapSize) {
@@ -127,50 +218,70 @@ int main(int argc, char** argv) {
   const char *InputFileName = parseCommandLine(argc, argv);
 
   size_t size = 0, mapSize = 0;
-  char *strbuf;
-  FUNC_TIMER(strbuf = readFile(InputFileName, size, mapSize));
+  char *strbuf = NULL;
+  uint64_t cacheKey = 0;
+  std::string cacheFile;
+  if (InputFileName) {
+    FUNC_TIMER(strbuf = readFile(InputFileName, size, mapSize));
+    cacheKey = graphCacheKey(strbuf, size);
+  }
+  if (!globalConfig.resumeFrom.empty()) {
+    FUNC_TIMER(g = loadGraph(globalConfig.resumeFrom, cacheKey));
+    Assert(g, "can not resume from %s", globalConfig.resumeFrom.c_str());
+  } else if (!globalConfig.graphCacheDir.empty()) {
+    cacheFile = globalConfig.graphCacheDir + format("/%016lx.graph", cacheKey);
+    FUNC_TIMER(g = loadGraph(cacheFile, cacheKey));
+  }
+  if (g && strbuf) munmap(strbuf, mapSize);
 
-  PNode* globalRoot;
-  FUNC_TIMER(globalRoot= parseFIR(strbuf));
-  munmap(strbuf, mapSize);
+  if (!g) {
+    PNode* globalRoot;
+    FUNC_TIMER(globalRoot= parseFIR(strbuf));
+    munmap(strbuf, mapSize);
 
-  FUNC_WRAPPER(g = AST2Graph(globalRoot), "Init");
+    FUNC_WRAPPER(g = AST2Graph(globalRoot), "Init");
 
-  FUNC_TIMER(g->splitArray());
+    FUNC_TIMER(g->splitArray());
 
-  FUNC_TIMER(g->detectLoop());
+    FUNC_TIMER(g->detectLoop());
 
-  FUNC_WRAPPER(g->topoSort(), "TopoSort");
+    FUNC_WRAPPER(g->topoSort(), "TopoSort");
 
-  FUNC_TIMER(g->inferAllWidth());
+    FUNC_TIMER(g->inferAllWidth());
 
-  FUNC_WRAPPER(g->removeDeadNodes(), "RemoveDeadNodes");
+    FUNC_WRAPPER(g->removeDeadNodes(), "RemoveDeadNodes");
 
-  FUNC_WRAPPER(g->exprOpt(), "ExprOpt");
+    FUNC_WRAPPER(g->exprOpt(), "ExprOpt");
 
-  FUNC_TIMER(g->usedBits());
+    FUNC_TIMER(g->usedBits());
 
-  FUNC_TIMER(g->splitNodes());
+    FUNC_TIMER(g->splitNodes());
 
-  FUNC_TIMER(g->removeDeadNodes());
+    FUNC_TIMER(g->removeDeadNodes());
 
-  FUNC_WRAPPER(g->constantAnalysis(), "ConstantAnalysis");
+    FUNC_WRAPPER(g->constantAnalysis(), "ConstantAnalysis");
 
-  FUNC_WRAPPER(g->removeDeadNodes(), "RemoveDeadNodes");
+    FUNC_WRAPPER(g->removeDeadNodes(), "RemoveDeadNodes");
 
-  FUNC_WRAPPER(g->aliasAnalysis(), "AliasAnalysis");
+    FUNC_WRAPPER(g->aliasAnalysis(), "AliasAnalysis");
 
-  FUNC_WRAPPER(g->patternDetect(), "PatternDetect");
+    FUNC_WRAPPER(g->patternDetect(), "PatternDetect");
 
-  FUNC_WRAPPER(g->commonExpr(), "CommonExpr");
+    FUNC_WRAPPER(g->commonExpr(), "CommonExpr");
 
-  FUNC_WRAPPER(g->removeDeadNodes(), "RemoveDeadNodes");
+    FUNC_WRAPPER(g->removeDeadNodes(), "RemoveDeadNodes");
+
+    if (!cacheFile.empty()) FUNC_TIMER(saveGraph(g, cacheFile, cacheKey));
+  }
 
   // FUNC_WRAPPER(g->mergeNodes(), "MergeNodes");
+  if (!globalConfig.profileFile.empty()) FUNC_TIMER(loadProfile(globalConfig.profileFile));
   FUNC_WRAPPER(g->graphPartition(), "graphPartition");
 
   FUNC_WRAPPER(g->replicationOpt(), "Replication");
 
+  if (globalConfig.threadNum > 1 && globalConfig.repcut) FUNC_WRAPPER(g->repcutPartition(), "RepCut");
+
   FUNC_WRAPPER(g->mergeRegister(), "MergeRegister");
 
   FUNC_WRAPPER(g->constructRegs(), "ConstructRegs");
@@ -179,9 +290,34 @@ int main(int argc, char** argv) {
 
   FUNC_TIMER(g->instsGenerator());
 
-  FUNC_WRAPPER(g->cppEmitter(), "Final");
+  if (globalConfig.threadNum > 1) FUNC_TIMER(g->threadPartition());
+
+  /* features of the emitted C++ model, which the LIR backends do not implement */
+  if (globalConfig.backend != "cpp") {
+    Assert(globalConfig.sparseMemKB == 0, "--sparse-mem is supported by the cpp backend");
+    Assert(!globalConfig.trace, "--trace is supported by the cpp backend");
+    Assert(!globalConfig.dispatch, "--dispatch is supported by the cpp backend");
+    Assert(globalConfig.costProfile == 0, "--cost-profile is supported by the cpp backend");
+    Assert(!globalConfig.srcMap, "--srcmap is supported by the cpp backend");
+  }
+  if (globalConfig.backend == "llvm") {
+    Assert(globalConfig.threadNum == 1, "the LLVM backend evaluates the model in a single thread");
+    FUNC_TIMER(g->genLIR());
+    FUNC_WRAPPER(g->llvmEmitter(), "Final");
+  } else if (globalConfig.backend == "interp") {
+    Assert(globalConfig.threadNum == 1, "the interpreter evaluates the model in a single thread");
+    FUNC_TIMER(g->genLIR());
+    FUNC_WRAPPER(g->interpEmitter(), "Final");
+  } else {
+    Assert(!globalConfig.dedup, "--dedup is only supported by the llvm and interp backends, the C++ code is not emitted from the LIR");
+    Assert(!globalConfig.reroll, "--reroll is only supported by the llvm and interp backends, the C++ code is not emitted from the LIR");
+    Assert(!globalConfig.dumpLIR, "--dump-lir is only supported by the llvm and interp backends, the C++ code is not emitted from the LIR");
+    FUNC_WRAPPER(g->cppEmitter(), "Final");
+  }
 
   TIMER_END(total);
 
+  writeReport();
+
   return 0;
 }
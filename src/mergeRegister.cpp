@@ -94,6 +94,8 @@ void graph::mergeRegister() {
     if (reg->status != VALID_NODE) continue;
     totalNum ++;
     if (reg->isArray() || reg->getDst()->assignTree.size() != 1) continue;
+    /* registers read by other partitions are updated after all partitions finish */
+    if (globalConfig.threadNum > 1 && globalConfig.repcut) continue;
     bool split = false;
     if (maxNode[reg] && isNext(reg->getDst(), maxNode[reg])) split = true;
     /* checking updateTree */
@@ -127,7 +129,7 @@ void graph::mergeRegister() {
     }
   }
 
-  printf("[mergeRegister] merge %d registers (total %d)\n", num, totalNum);
+  printStat("[mergeRegister] merge %d registers (total %d)\n", num, totalNum);
 }
 
 void graph::constructRegs() {
@@ -55,5 +55,5 @@ void graph::patternDetect() {
   }
   removeNodesNoConnect(DEAD_NODE);
   reconnectAll();
-  printf("[patternDetect] find %d pattern1\n", num1);
+  printStat("[patternDetect] find %d pattern1\n", num1);
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+  profile: the activity of the superNodes of a profiling run, keyed by the names of their members so that
+  it applies to the nodes of another compilation of the same circuit
+*/
+
+#include "common.h"
+
+static std::map<std::string, NodeActivity> activity;
+static uint64_t cycles = 0;
+static bool loaded = false;
+
+uint64_t NodeActivity::profileCycles() {
+  return cycles;
+}
+
+/*
+  the table of costDump() of a model built with --cost-profile=1:
+    # 1 in <N> of <M> superNodes, <cycles> cycles, ...
+    # cppId calls valid ticks meanTicks share members
+    <cppId> <calls> <valid> <ticks> <meanTicks> <share> <member>...
+  or ACTIVE_FILE of the emulator of a model emitted by gsim built with PERF, where the last report counts:
+    totalActives <n> activePerCycle <n> totalValid <n> validPerCycle <n> cycles <cycles>
+    <cppId>: activeTimes <calls> validActive <valid> <member>...
+*/
+void loadProfile(std::string fileName) {
+  std::ifstream in(fileName);
+  Assert(in.is_open(), "can not open profile %s", fileName.c_str());
+  std::string line;
+  int superNum = 0;
+  while (std::getline(in, line)) {
+    if (line.empty()) continue;
+    if (line[0] == '#') {
+      /* superNodes out of a sampled profile would be taken as unknown, and never split or merged */
+      int interval;
+      if (sscanf(line.c_str(), "# 1 in %d of", &interval) == 1) {
+        Assert(interval == 1, "profile %s covers 1 in %d superNodes, --profile needs a model built with --cost-profile=1", fileName.c_str(), interval);
+      }
+      size_t pos = line.find(" cycles,");
+      if (pos != std::string::npos) {
+        size_t beg = line.rfind(' ', pos - 1);
+        cycles = std::stoull(line.substr(beg + 1, pos - beg - 1));
+      }
+      continue;
+    }
+    NodeActivity entry;
+    std::istringstream fields;
+    if (line.compare(0, 12, "totalActives") == 0) {
+      size_t pos = line.find(" cycles ");
+      Assert(pos != std::string::npos, "no cycles in the activity report of %s, written by an older emulator", fileName.c_str());
+      cycles = std::stoull(line.substr(pos + 8));
+      activity.clear();
+      superNum = 0;
+      continue;
+    }
+    int len = 0;
+    if (sscanf(line.c_str(), "%d: activeTimes %lu validActive %lu %n", &entry.group, &entry.calls, &entry.valid, &len) == 3 && len > 0) {
+      fields.str(line.substr(len));
+    } else {
+      std::string ticks, mean, share;
+      fields.str(line);
+      fields >> entry.group >> entry.calls >> entry.valid >> ticks >> mean >> share;
+      Assert(!fields.fail(), "invalid profile line: %s", line.c_str());
+    }
+    std::string member;
+    while (fields >> member) activity[member] = entry;
+    superNum ++;
+  }
+  Assert(cycles != 0, "no cycles in profile %s", fileName.c_str());
+  loaded = true;
+  printStat("[profile] %d superNodes, %ld nodes, %ld cycles from %s\n", superNum, activity.size(), cycles, fileName.c_str());
+}
+
+bool hasProfile() {
+  return loaded;
+}
+
+NodeActivity* nodeActivity(Node* node) {
+  auto iter = activity.find(node->name);
+  return iter == activity.end() ? nullptr : &iter->second;
+}
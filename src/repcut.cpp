@@ -0,0 +1,229 @@
+/*
+  repcutPartition: replication-aided partitioning (RepCut) for multi-threaded evaluation
+  Nodes are split at register boundaries into one partition per thread. Every partition
+  evaluates the combinational fan-in cones of its own registers, memories and side effects,
+  and combinational nodes shared by several cones are replicated into every partition that needs them.
+  Partitions then only communicate through registers, which are updated after a single barrier.
+*/
+
+#include "common.h"
+#include <map>
+#include <algorithm>
+
+/* nodes that can be evaluated by several partitions after duplication */
+static bool isReplicable(Node* node) {
+  if (node->super->superType != SUPER_VALID) return false;
+  if (node->type != NODE_OTHERS || node->status != VALID_NODE) return false;
+  if (node->isArray() || node->isArrayMember || node->assignTree.size() != 1) return false;
+  return !node->isReset() && !node->isClock;
+}
+
+/* nodes that must be evaluated by thread 0 in their original order (same as threadPartition) */
+static bool isPinned(Node* node) {
+  return node->type == NODE_SPECIAL || node->super->superType == SUPER_EXTMOD;
+}
+
+static int findGroup(std::vector<int>& group, int idx) {
+  while (group[idx] != idx) {
+    group[idx] = group[group[idx]];
+    idx = group[idx];
+  }
+  return idx;
+}
+
+static void unionGroup(std::vector<int>& group, int idx1, int idx2) {
+  group[findGroup(group, idx1)] = findGroup(group, idx2);
+}
+
+void graph::repcutPartition() {
+  int partNum = globalConfig.threadNum;
+  std::vector<Node*> nodes;
+  std::map<Node*, int> nodeIdx;
+  for (SuperNode* super : sortedSuper) {
+    for (Node* member : super->member) {
+      nodeIdx[member] = nodes.size();
+      nodes.push_back(member);
+    }
+  }
+
+  /* nodes that can not be replicated are grouped into units, every unit belongs to one partition */
+  std::vector<int> group(nodes.size());
+  for (size_t i = 0; i < nodes.size(); i ++) group[i] = i;
+  int pinnedIdx = -1;
+  for (size_t i = 0; i < nodes.size(); i ++) {
+    Node* node = nodes[i];
+    if (isReplicable(node)) continue;
+    if (isPinned(node)) {
+      if (pinnedIdx >= 0) unionGroup(group, i, pinnedIdx);
+      pinnedIdx = i;
+    }
+    /* superNodes with special types are not split */
+    if (node->super->superType != SUPER_VALID) unionGroup(group, i, nodeIdx[node->super->member[0]]);
+    /* registers are updated by the partition computing their next values */
+    if (node->type == NODE_REG_SRC && node->getDst() && nodeIdx.find(node->getDst()) != nodeIdx.end()) {
+      unionGroup(group, i, nodeIdx[node->getDst()]);
+    }
+    /* all ports of a memory are evaluated by the same partition */
+    if (node->type == NODE_READER || node->type == NODE_WRITER || node->type == NODE_READWRITER) {
+      for (Node* port : node->parent->member) {
+        if (nodeIdx.find(port) != nodeIdx.end()) unionGroup(group, i, nodeIdx[port]);
+      }
+    }
+  }
+  std::map<int, std::vector<int>> units;
+  for (size_t i = 0; i < nodes.size(); i ++) {
+    if (!isReplicable(nodes[i])) units[findGroup(group, i)].push_back(i);
+  }
+  int pinnedGroup = pinnedIdx >= 0 ? findGroup(group, pinnedIdx) : -1;
+
+  /* combinational fan-in cone of every unit */
+  std::vector<std::vector<int>> unitCone;
+  std::vector<std::vector<int>*> unitMember;
+  std::vector<int> unitGroup;
+  std::vector<int> unitOrder;
+  std::vector<char> visited(nodes.size(), 0);
+  for (auto& iter : units) {
+    std::vector<int> cone;
+    std::vector<int> stack(iter.second);
+    while (!stack.empty()) {
+      Node* top = nodes[stack.back()];
+      stack.pop_back();
+      for (Node* prev : top->prev) {
+        if (nodeIdx.find(prev) == nodeIdx.end()) continue;
+        int idx = nodeIdx[prev];
+        if (visited[idx] || !isReplicable(prev)) continue;
+        visited[idx] = 1;
+        cone.push_back(idx);
+        stack.push_back(idx);
+      }
+    }
+    for (int idx : cone) visited[idx] = 0;
+    unitOrder.push_back(unitCone.size());
+    unitCone.push_back(cone);
+    unitMember.push_back(&iter.second);
+    unitGroup.push_back(iter.first);
+  }
+
+  /* assign large units first, to the partition with the least cost after replicating the cone */
+  std::stable_sort(unitOrder.begin(), unitOrder.end(), [&](int a, int b) {
+    return unitCone[a].size() + unitMember[a]->size() > unitCone[b].size() + unitMember[b]->size();
+  });
+  std::vector<std::vector<char>> inPart(partNum, std::vector<char>(nodes.size(), 0));
+  std::vector<int> nodePart(nodes.size(), 0);
+  std::vector<size_t> load(partNum, 0);
+  for (int unit : unitOrder) {
+    int part = 0;
+    if (unitGroup[unit] != pinnedGroup) {
+      size_t minLoad = (size_t)-1;
+      for (int p = 0; p < partNum; p ++) {
+        size_t newLoad = load[p] + unitMember[unit]->size();
+        for (int idx : unitCone[unit]) newLoad += !inPart[p][idx];
+        if (newLoad < minLoad) {
+          minLoad = newLoad;
+          part = p;
+        }
+      }
+    }
+    load[part] += unitMember[unit]->size();
+    for (int idx : *unitMember[unit]) nodePart[idx] = part;
+    for (int idx : unitCone[unit]) {
+      if (inPart[part][idx]) continue;
+      inPart[part][idx] = 1;
+      load[part] ++;
+    }
+  }
+
+  /* replicate shared nodes next to the original one, the first partition keeps the original one */
+  std::map<std::pair<Node*, int>, Node*> repNode;
+  std::map<Node*, Node*> repOrigin;
+  std::map<Node*, int> partition;
+  size_t repNum = 0;
+  for (SuperNode* super : sortedSuper) {
+    std::vector<Node*> newMember;
+    for (Node* member : super->member) {
+      int idx = nodeIdx[member];
+      newMember.push_back(member);
+      partition[member] = nodePart[idx];
+      if (!isReplicable(member)) continue;
+      int primary = -1;
+      for (int p = 0; p < partNum; p ++) {
+        if (!inPart[p][idx]) continue;
+        if (primary < 0) {
+          primary = p;
+          partition[member] = p;
+          continue;
+        }
+        Node* dupNode = member->dup(member->type, format("%s$REP_%d", member->name.c_str(), p));
+        dupNode->usedBit = member->usedBit;
+        dupNode->assignTree.push_back(new ExpTree(member->assignTree[0]->getRoot()->dup(), new ENode(dupNode)));
+        dupNode->super = super;
+        newMember.push_back(dupNode);
+        repNode[std::make_pair(member, p)] = dupNode;
+        repOrigin[dupNode] = member;
+        partition[dupNode] = p;
+        repNum ++;
+      }
+    }
+    super->member = newMember;
+  }
+
+  /* nodes in each partition refer to the replicated nodes in the same partition */
+  std::map<Node*, std::set<Node*>> actualPrev;
+  for (SuperNode* super : sortedSuper) {
+    for (Node* member : super->member) {
+      Node* origin = repOrigin.find(member) == repOrigin.end() ? member : repOrigin[member];
+      int part = partition[member];
+      for (Node* prev : origin->prev) {
+        if (repNode.find(std::make_pair(prev, part)) == repNode.end()) {
+          actualPrev[member].insert(prev);
+          continue;
+        }
+        Node* dupNode = repNode[std::make_pair(prev, part)];
+        actualPrev[member].insert(dupNode);
+        for (ExpTree* tree : member->assignTree) tree->replace(prev, dupNode);
+        if (member->resetTree) member->resetTree->replace(prev, dupNode);
+        if (member->updateTree) member->updateTree->replace(prev, dupNode);
+      }
+    }
+  }
+
+  /*
+    split superNodes by partition, a member depending on a member of another partition
+    in the same superNode is moved to a later phase to keep the topological order
+  */
+  std::vector<SuperNode*> newSorted;
+  for (SuperNode* super : sortedSuper) {
+    if (super->superType != SUPER_VALID) {
+      super->threadId = partition[super->member[0]];
+      newSorted.push_back(super);
+      continue;
+    }
+    std::map<Node*, int> phase;
+    std::map<std::pair<int, int>, SuperNode*> splitSuper;
+    std::vector<Node*> members(super->member);
+    for (Node* member : members) {
+      int curPhase = 0;
+      for (Node* prev : actualPrev[member]) {
+        if (phase.find(prev) == phase.end()) continue;
+        curPhase = MAX(curPhase, phase[prev] + (partition[prev] != partition[member]));
+      }
+      /* inputs and registers are not evaluated, readers in other partitions need not wait for them */
+      if (member->type == NODE_INP || member->type == NODE_REG_SRC) curPhase = -1;
+      phase[member] = curPhase;
+      std::pair<int, int> key = std::make_pair(curPhase, partition[member]);
+      if (splitSuper.find(key) == splitSuper.end()) {
+        splitSuper[key] = splitSuper.empty() ? super : new SuperNode();
+        splitSuper[key]->member.clear();
+        splitSuper[key]->threadId = partition[member];
+      }
+      splitSuper[key]->member.push_back(member);
+      member->super = splitSuper[key];
+    }
+    for (auto iter : splitSuper) newSorted.push_back(iter.second);
+  }
+  sortedSuper = newSorted;
+  reconnectAll();
+
+  printStat("[repcut] %ld units, replicate %ld nodes\n", units.size(), repNum);
+  for (int p = 0; p < partNum; p ++) printStat("[repcut] partition %d: %ld nodes\n", p, load[p]);
+}
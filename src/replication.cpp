@@ -118,6 +118,6 @@ void graph::replicationOpt() {
   }
   removeNodesNoConnect(REPLICATION_NODE);
   reconnectAll();
-  printf("[replication] remove %ld nodes (%ld -> %ld)\n", optimizeNum, oldNum, countNodes());
-  printf("[replication] remove %ld superNodes (%ld -> %ld)\n", oldSuper - sortedSuper.size(), oldSuper, sortedSuper.size());
+  printStat("[replication] remove %ld nodes (%ld -> %ld)\n", optimizeNum, oldNum, countNodes());
+  printStat("[replication] remove %ld superNodes (%ld -> %ld)\n", oldSuper - sortedSuper.size(), oldSuper, sortedSuper.size());
 }
@@ -0,0 +1,143 @@
+/*
+  report: the compile cost of every pass for --report, in JSON for tracking regressions.
+  A pass records its wall and cpu time, the resident memory after it, its change and the peak, the size of
+  the graph after it and the statistic lines it prints
+*/
+
+#include "common.h"
+#include <sys/resource.h>
+#include <unistd.h>
+
+class PassRecord {
+public:
+  std::string name;
+  uint64_t wallUs;
+  uint64_t cpuUs;
+  uint64_t rssKB;
+  int64_t rssDeltaKB;
+  uint64_t peakRssKB;
+  /* -1 if the graph is not sorted yet */
+  int64_t nodeNum = -1;
+  int64_t superNum = -1;
+  int64_t enodeNum = -1;
+  int64_t lirInsts = -1;
+  std::vector<std::string> stats;
+};
+
+static std::vector<PassRecord> records;
+static std::vector<std::string> pendingStats;
+static struct timeval startTime = getTime();
+
+/* user and system time of all threads */
+static uint64_t cpuTime() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static uint64_t peakRss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static uint64_t currentRss() {
+  uint64_t size = 0, resident = 0;
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (!fp) return 0;
+  if (fscanf(fp, "%lu %lu", &size, &resident) != 2) resident = 0;
+  fclose(fp);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static size_t countENodes(ExpTree* tree) {
+  if (!tree) return 0;
+  size_t ret = 0;
+  std::vector<ENode*> stack = {tree->getRoot(), tree->getlval()};
+  while (!stack.empty()) {
+    ENode* top = stack.back();
+    stack.pop_back();
+    if (!top) continue;
+    ret ++;
+    stack.insert(stack.end(), top->child.begin(), top->child.end());
+  }
+  return ret;
+}
+
+PassReport::PassReport(const char* _name) {
+  if (globalConfig.reportFile.empty()) return;
+  name = _name;
+  wallStart = getTime();
+  cpuStart = cpuTime();
+  rssStart = currentRss();
+}
+
+void PassReport::end(graph* g) {
+  if (globalConfig.reportFile.empty()) return;
+  struct timeval wallEnd = getTime();
+  PassRecord record;
+  record.name = name;
+  record.wallUs = diffTime(wallStart, wallEnd);
+  record.cpuUs = cpuTime() - cpuStart;
+  record.rssKB = currentRss();
+  record.rssDeltaKB = (int64_t)record.rssKB - (int64_t)rssStart;
+  record.peakRssKB = peakRss();
+  if (g && !g->sortedSuper.empty()) {
+    record.nodeNum = record.enodeNum = 0;
+    record.superNum = g->sortedSuper.size();
+    for (SuperNode* super : g->sortedSuper) {
+      record.nodeNum += super->member.size();
+      for (Node* member : super->member) {
+        for (ExpTree* tree : member->assignTree) record.enodeNum += countENodes(tree);
+        for (ExpTree* tree : {member->valTree, member->memTree, member->resetCond, member->resetVal, member->updateTree, member->resetTree}) record.enodeNum += countENodes(tree);
+      }
+    }
+  }
+  if (g && g->lir) record.lirInsts = g->lir->instNum();
+  record.stats.swap(pendingStats);
+  records.push_back(record);
+}
+
+void printStat(const char* fmt, ...) {
+  char buf[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  std::string line = buf;
+  fputs(line.c_str(), stdout);
+  if (globalConfig.reportFile.empty()) return;
+  while (!line.empty() && line.back() == '\n') line.pop_back();
+  pendingStats.push_back(line);
+}
+
+static std::string jsonStr(const std::string& str) {
+  std::string ret = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') ret += std::string("\\") + c;
+    else if ((unsigned char)c < 0x20) ret += format("\\u%04x", c);
+    else ret += c;
+  }
+  return ret + "\"";
+}
+
+void writeReport() {
+  if (globalConfig.reportFile.empty()) return;
+  FILE* fp = fopen(globalConfig.reportFile.c_str(), "w");
+  Assert(fp, "can not open %s", globalConfig.reportFile.c_str());
+  struct timeval now = getTime();
+  fprintf(fp, "{\n  \"wallMs\": %.3f,\n  \"cpuMs\": %.3f,\n  \"peakRssKB\": %lu,\n  \"passes\": [", diffTime(startTime, now) / 1000.0, cpuTime() / 1000.0, peakRss());
+  for (size_t i = 0; i < records.size(); i ++) {
+    PassRecord& record = records[i];
+    fprintf(fp, "%s\n    {\"name\": %s, \"wallMs\": %.3f, \"cpuMs\": %.3f, \"rssKB\": %lu, \"rssDeltaKB\": %ld, \"peakRssKB\": %lu", i ? "," : "",
+            jsonStr(record.name).c_str(), record.wallUs / 1000.0, record.cpuUs / 1000.0, record.rssKB, record.rssDeltaKB, record.peakRssKB);
+    if (record.nodeNum >= 0) fprintf(fp, ", \"nodes\": %ld, \"superNodes\": %ld, \"enodes\": %ld", record.nodeNum, record.superNum, record.enodeNum);
+    if (record.lirInsts >= 0) fprintf(fp, ", \"lirInsts\": %ld", record.lirInsts);
+    fprintf(fp, ", \"stats\": [");
+    for (size_t j = 0; j < record.stats.size(); j ++) fprintf(fp, "%s%s", j ? ", " : "", jsonStr(record.stats[j]).c_str());
+    fprintf(fp, "]}");
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  fclose(fp);
+  printf("[report] %ld passes to %s\n", records.size(), globalConfig.reportFile.c_str());
+}
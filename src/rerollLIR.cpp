@@ -0,0 +1,336 @@
+/*
+  rerollLIR: roll the unrolled code of arrays of identical logic (entries of queues, ways of TLBs, ...) back
+  into loops. A run of consecutive blocks of a function is rolled if every block evaluates the same
+  instructions as the first one, except that it accesses the next entry of some vars and some constants
+  advance by a fixed step. The vars walked by loops are merged into arrays in the order of the blocks, split
+  arrays are usually merged back in the order of their indexes, so that the backends can vectorize the loops.
+  Only the llvm and interp backends roll loops: the cpp backend is not lowered from the LIR (see LIR.h), so
+  the emitted C++ stays unrolled.
+*/
+
+#include "common.h"
+
+/* runs with less blocks are left unrolled */
+#define REROLL_MIN_TRIPS 4
+/* the longest block and the number of lengths tried at every position */
+#define REROLL_MAX_BLOCK 256
+#define REROLL_MAX_CANDIDATES 8
+
+/* the varying operands of a block at the offset of their instruction */
+class RerollRun {
+public:
+  LIRFunc* func;
+  size_t start;
+  size_t len;
+  size_t trips = 1;
+  std::map<size_t, std::vector<LIRVar*>> varCols;
+  std::map<size_t, std::pair<uint64_t, uint64_t>> consCols;   // base and step
+  std::set<size_t> fixedVars;
+  std::set<size_t> fixedCons;
+  size_t covered() const { return len * trips; }
+};
+
+/* vars walked by loops are chained to the var of the next entry */
+static std::map<LIRVar*, LIRVar*> nextVar;
+static std::map<LIRVar*, LIRVar*> prevVar;
+/* vars referred to outside of instructions keep their own storage */
+static std::set<LIRVar*> pinnedVars;
+
+static uint64_t widthMask(int width) {
+  return width >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1;
+}
+
+/* the instructions that can be in the same position of two blocks */
+static uint64_t instSig(const LIRInst& inst) {
+  uint64_t ret = inst.op;
+  auto mix = [&ret](uint64_t val) { ret = (ret ^ val) * 1099511628211ull; };
+  mix(inst.width);
+  mix(inst.sign);
+  mix(inst.dst >= 0);
+  for (int src : inst.src) mix(src >= 0);
+  if (inst.var) {
+    mix(inst.var->width);
+    mix(inst.var->entryNum);
+  }
+  mix(inst.cons.size());
+  for (int id : inst.ids) mix(id);
+  mix(inst.args.size());
+  mix(std::hash<std::string>()(inst.str));
+  return ret;
+}
+
+class RerollFunc {
+public:
+  LIRFunc* func;
+  std::vector<uint64_t> sigs;
+  std::vector<int> defPos;    // -1 for no definition, -2 for several ones
+  std::vector<int> lastUse;
+  RerollFunc(LIRFunc* _func);
+  bool balanced(size_t start, size_t len);
+  bool matchTmp(int tmp0, size_t start0, int tmp, size_t start, size_t runStart, size_t len);
+  bool matchBlock(RerollRun& run, size_t k);
+  bool escapes(RerollRun& run);
+  void findRuns(std::vector<RerollRun>& runs);
+};
+
+RerollFunc::RerollFunc(LIRFunc* _func) : func(_func) {
+  defPos.assign(func->tmpWidth.size(), -1);
+  lastUse.assign(func->tmpWidth.size(), -1);
+  for (size_t i = 0; i < func->insts.size(); i ++) {
+    LIRInst& inst = func->insts[i];
+    sigs.push_back(instSig(inst));
+    if (inst.dst >= 0) defPos[inst.dst] = defPos[inst.dst] == -1 ? (int)i : -2;
+    for (int src : inst.src) {
+      if (src >= 0) lastUse[src] = i;
+    }
+    for (int arg : inst.args) lastUse[arg] = i;
+  }
+}
+
+bool RerollFunc::balanced(size_t start, size_t len) {
+  int depth = 0;
+  for (size_t i = start; i < start + len; i ++) {
+    LIROp op = func->insts[i].op;
+    if (op == LIR_IF) depth ++;
+    else if (op == LIR_ELSE && depth == 0) return false;
+    else if (op == LIR_ENDIF && -- depth < 0) return false;
+  }
+  return depth == 0;
+}
+
+/* temporaries defined in a block match by position, other ones are invariants defined before the run */
+bool RerollFunc::matchTmp(int tmp0, size_t start0, int tmp, size_t start, size_t runStart, size_t len) {
+  if (tmp0 < 0 || tmp < 0) return tmp0 == tmp;
+  int def0 = defPos[tmp0], def = defPos[tmp];
+  if (def0 == -2 || def == -2) return false;
+  bool inner0 = def0 >= (int)start0 && def0 < (int)(start0 + len);
+  bool inner = def >= (int)start && def < (int)(start + len);
+  if (inner0 || inner) return inner0 && inner && def0 - start0 == def - start;
+  return tmp0 == tmp && def < (int)runStart;
+}
+
+/* block k of run is the first block with its vars and constants advanced k times */
+bool RerollFunc::matchBlock(RerollRun& run, size_t k) {
+  size_t start0 = run.start, start = run.start + k * run.len;
+  for (size_t j = 0; j < run.len; j ++) {
+    LIRInst& inst0 = func->insts[start0 + j];
+    LIRInst& inst = func->insts[start + j];
+    if (sigs[start0 + j] != sigs[start + j] || inst.op != inst0.op || inst.imm != inst0.imm || inst.ids != inst0.ids || inst.str != inst0.str) return false;
+    if (inst.dst >= 0 && (defPos[inst.dst] != (int)(start + j) || defPos[inst0.dst] != (int)(start0 + j))) return false;
+    for (int i = 0; i < 3; i ++) {
+      if (!matchTmp(inst0.src[i], start0, inst.src[i], start, run.start, run.len)) return false;
+    }
+    for (size_t i = 0; i < inst.args.size(); i ++) {
+      if (!matchTmp(inst0.args[i], start0, inst.args[i], start, run.start, run.len)) return false;
+    }
+    if (inst.var) {
+      bool fixed = inst.var == inst0.var;
+      if (k == 1 && fixed) run.fixedVars.insert(j);
+      if (run.fixedVars.count(j) != fixed) return false;
+      if (!fixed) {
+        if (inst.var->entryNum != 1 || inst.var->width != inst0.var->width || inst.var->sign != inst0.var->sign) return false;
+        if (pinnedVars.count(inst.var) || pinnedVars.count(inst0.var)) return false;
+      }
+    }
+    if (inst.cons != inst0.cons) {
+      if (inst.cons.size() != 1 || inst.width > 64 || run.fixedCons.count(j)) return false;
+      uint64_t mask = widthMask(inst.width);
+      if (k == 1) run.consCols[j] = std::make_pair(inst0.cons[0], (inst.cons[0] - inst0.cons[0]) & mask);
+      std::pair<uint64_t, uint64_t>& col = run.consCols[j];
+      if (((col.first + k * col.second) & mask) != inst.cons[0]) return false;
+    } else if (inst.op == LIR_CONST) {
+      if (k == 1) run.fixedCons.insert(j);
+      if (!run.fixedCons.count(j)) return false;
+    }
+  }
+  for (size_t j = 0; j < run.len; j ++) {
+    if (!run.fixedVars.count(j) && func->insts[start0 + j].var) run.varCols[j].push_back(func->insts[start + j].var);
+  }
+  return true;
+}
+
+/* temporaries of the run are not visible after its loop */
+bool RerollFunc::escapes(RerollRun& run) {
+  size_t end = run.start + run.covered();
+  for (size_t i = run.start; i < end; i ++) {
+    int dst = func->insts[i].dst;
+    if (dst >= 0 && lastUse[dst] >= (int)end) return true;
+  }
+  return false;
+}
+
+/* link the vars of every column to their next entries, undone if any column conflicts with existing chains */
+static bool linkColumns(RerollRun& run) {
+  std::vector<LIRVar*> linked;
+  bool ok = true;
+  for (auto& iter : run.varCols) {
+    std::vector<LIRVar*>& col = iter.second;
+    for (size_t k = 0; ok && k + 1 < col.size(); k ++) {
+      LIRVar* var = col[k];
+      LIRVar* next = col[k + 1];
+      if (nextVar.count(var) || prevVar.count(next)) {
+        ok = nextVar.count(var) && nextVar[var] == next;
+        continue;
+      }
+      LIRVar* head = var;
+      while (prevVar.count(head)) head = prevVar[head];
+      if (head == next) {
+        ok = false;
+        continue;
+      }
+      nextVar[var] = next;
+      prevVar[next] = var;
+      linked.push_back(var);
+    }
+  }
+  if (ok) return true;
+  for (LIRVar* var : linked) {
+    prevVar.erase(nextVar[var]);
+    nextVar.erase(var);
+  }
+  return false;
+}
+
+void RerollFunc::findRuns(std::vector<RerollRun>& runs) {
+  size_t num = func->insts.size();
+  size_t start = 0;
+  while (start < num) {
+    std::vector<RerollRun> candidates;
+    for (size_t pos = start + 1; pos < num && pos <= start + REROLL_MAX_BLOCK && candidates.size() < REROLL_MAX_CANDIDATES; pos ++) {
+      if (sigs[pos] != sigs[start]) continue;
+      size_t len = pos - start;
+      if (start + len * REROLL_MIN_TRIPS > num || !balanced(start, len)) continue;
+      RerollRun run;
+      run.func = func;
+      run.start = start;
+      run.len = len;
+      while (run.start + (run.trips + 1) * len <= num && matchBlock(run, run.trips)) run.trips ++;
+      for (auto& iter : run.varCols) iter.second.resize(run.trips - 1);
+      while (run.trips >= REROLL_MIN_TRIPS && escapes(run)) run.trips --;
+      if (run.trips < REROLL_MIN_TRIPS) continue;
+      for (auto& iter : run.varCols) {
+        iter.second.resize(run.trips - 1);
+        iter.second.insert(iter.second.begin(), func->insts[start + iter.first].var);
+      }
+      candidates.push_back(run);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const RerollRun& a, const RerollRun& b) { return a.covered() > b.covered(); });
+    bool rolled = false;
+    for (RerollRun& run : candidates) {
+      if (!linkColumns(run)) continue;
+      runs.push_back(run);
+      start += run.covered();
+      rolled = true;
+      break;
+    }
+    if (!rolled) start ++;
+  }
+}
+
+/* dst = base + idx * step in the width of the constant */
+static void progression(LIRFunc* func, int idx, LIRInst& inst, std::pair<uint64_t, uint64_t>& col, std::vector<LIRInst>& insts) {
+  auto newInst = [&](LIROp op, int src0, int src1) {
+    LIRInst ret(op);
+    ret.dst = func->newTmp(inst.width);
+    ret.width = inst.width;
+    ret.src[0] = src0;
+    ret.src[1] = src1;
+    insts.push_back(ret);
+    return ret.dst;
+  };
+  auto newConst = [&](uint64_t val) {
+    LIRInst ret(LIR_CONST);
+    ret.dst = func->newTmp(inst.width);
+    ret.width = inst.width;
+    ret.cons.push_back(val);
+    insts.push_back(ret);
+    return ret.dst;
+  };
+  int val = newInst(LIR_EXT, idx, -1);
+  if (col.second != 1) val = newInst(LIR_MUL, val, newConst(col.second));
+  if (col.first != 0) val = newInst(LIR_ADD, val, newConst(col.first));
+  insts.back().dst = inst.dst;
+}
+
+static void rollRun(RerollRun& run, std::map<LIRVar*, std::pair<LIRVar*, int>>& entries) {
+  LIRFunc* func = run.func;
+  int idx = func->newTmp(LIR_IDX_WIDTH);
+  std::vector<LIRInst> body;
+  LIRInst loop(LIR_LOOP);
+  loop.dst = idx;
+  loop.imm = run.trips;
+  body.push_back(loop);
+  for (size_t j = 0; j < run.len; j ++) {
+    LIRInst inst = func->insts[run.start + j];
+    if (run.consCols.find(j) != run.consCols.end()) {
+      progression(func, idx, inst, run.consCols[j], body);
+      continue;
+    }
+    if (run.varCols.find(j) != run.varCols.end()) {
+      std::pair<LIRVar*, int>& entry = entries[run.varCols[j][0]];
+      inst.var = entry.first;
+      inst.src[0] = idx;
+      inst.imm = entry.second;
+    }
+    body.push_back(inst);
+  }
+  LIRInst endLoop(LIR_ENDLOOP);
+  endLoop.src[0] = idx;
+  endLoop.imm = run.trips;
+  body.push_back(endLoop);
+  func->insts.erase(func->insts.begin() + run.start, func->insts.begin() + run.start + run.covered());
+  func->insts.insert(func->insts.begin() + run.start, body.begin(), body.end());
+}
+
+void graph::rerollLIR() {
+  LIRProgram* program = lir;
+  size_t prevInsts = program->instNum();
+  nextVar.clear();
+  prevVar.clear();
+  pinnedVars.clear();
+  for (LIRPort& port : program->inputs) pinnedVars.insert(port.var);
+  for (LIRPort& port : program->outputs) pinnedVars.insert(port.var);
+  for (LIRReset& reset : program->resets) pinnedVars.insert(reset.cond);
+
+  std::vector<LIRFunc*> funcs = {&program->init, &program->prologue};
+  for (LIRFunc* func : program->supers) {
+    if (func) funcs.push_back(func);
+  }
+  for (LIRReset& reset : program->resets) funcs.push_back(&reset.func);
+  std::vector<RerollRun> runs;
+  for (LIRFunc* func : funcs) RerollFunc(func).findRuns(runs);
+
+  /* every chain of vars becomes an array */
+  std::map<LIRVar*, std::pair<LIRVar*, int>> entries;
+  size_t arrayNum = 0;
+  for (LIRVar* var : std::vector<LIRVar*>(program->vars)) {
+    if (prevVar.count(var) || !nextVar.count(var)) continue;
+    int num = 0;
+    for (LIRVar* member = var; member; member = nextVar.count(member) ? nextVar[member] : nullptr) num ++;
+    std::string name = var->name + "$ROLL";
+    while (program->varMap.count(name)) name += "_";
+    LIRVar* array = program->getVar(name, var->width, var->sign, num, nullptr);
+    int idx = 0;
+    for (LIRVar* member = var; member; member = nextVar.count(member) ? nextVar[member] : nullptr) entries[member] = std::make_pair(array, idx ++);
+    arrayNum ++;
+  }
+  for (LIRFunc* func : funcs) {
+    for (LIRInst& inst : func->insts) {
+      if (!inst.var || entries.find(inst.var) == entries.end()) continue;
+      Assert(inst.src[0] < 0 && inst.imm == 0, "%s is not accessed as a scalar", inst.var->name.c_str());
+      inst.imm = entries[inst.var].second;
+      inst.var = entries[inst.var].first;
+    }
+  }
+  /* later runs first, so that the positions of earlier ones are kept */
+  for (auto iter = runs.rbegin(); iter != runs.rend(); iter ++) rollRun(*iter, entries);
+
+  std::vector<LIRVar*> vars;
+  for (LIRVar* var : program->vars) {
+    if (entries.find(var) == entries.end()) vars.push_back(var);
+    else program->varMap.erase(var->name);
+  }
+  program->vars = vars;
+  for (size_t i = 0; i < vars.size(); i ++) vars[i]->id = i;
+  printStat("[rerollLIR] %ld loops over %ld arrays, insts %ld -> %ld\n", runs.size(), arrayNum, prevInsts, program->instNum());
+}
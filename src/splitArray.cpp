@@ -439,7 +439,7 @@ void graph::splitArray() {
     }
   }
   Assert(partialVisited.size() == 0, "partial is not empty!");
-  printf("[splitArray] split %d arrays\n", num);
+  printStat("[splitArray] split %d arrays\n", num);
   splitOptionalArray();
   /* treat arrayMember with no arrayNext as normal nodes, update assignTree */
   /* with arrayNext can also be updated */
@@ -585,5 +585,5 @@ void graph::splitOptionalArray() {
     }
     num ++;
   }
-  printf("[splitOptionalArray] split %d arrays\n", num);
+  printStat("[splitOptionalArray] split %d arrays\n", num);
 }
@@ -273,6 +273,8 @@ NodeComponent* ENode::inferComponent(Node* n) {
     case OP_SHL:
       ret = childComp[0]->dup();
       ret->addElementAll(new NodeElement("0", 16, values[0] - 1, 0));
+      /* the high bits may be cut by usedBits */
+      if (ret->countWidth() > width) ret = ret->getbits(width - 1, 0);
       break;
     case OP_SHR:
       ret = childComp[0]->getbits(childComp[0]->width - 1, values[0]);
@@ -875,6 +877,6 @@ void graph::splitNodes() {
 
   reconnectAll();
 
-  printf("[splitNode] update %d nodes (total %ld)\n", num, countNodes());
-  printf("[splitNode] split %ld nodes (total %ld)\n", splittedNodesSeg.size(), countNodes());
+  printStat("[splitNode] update %d nodes (total %ld)\n", num, countNodes());
+  printStat("[splitNode] split %ld nodes (total %ld)\n", splittedNodesSeg.size(), countNodes());
 }
\ No newline at end of file
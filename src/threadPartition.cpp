@@ -0,0 +1,296 @@
+/*
+  threadPartition: distribute superNodes among threads for multi-threaded evaluation (--threads)
+  superNodes are levelized by every relation that orders their evaluation in sortedSuper.
+  Each level is distributed among threads, and a barrier is only inserted before a level
+  when some superNode in it depends on a superNode evaluated by another thread since the last barrier.
+  superNodes between two barriers form an epoch.
+  With --work-steal, the dependencies form a task graph instead, which is scheduled at runtime.
+  With --repcut, threads are given by repcutPartition and only epochs are computed here.
+*/
+
+#include "common.h"
+#include <map>
+#include <algorithm>
+
+/* minimum cost of a level to justify a barrier for load balancing */
+#define SYNC_MIN_COST 64
+
+static std::map<SuperNode*, std::set<SuperNode*>> dependSuper;
+static std::map<SuperNode*, std::set<SuperNode*>> effDependSuper;
+
+static bool isEmptySuper(SuperNode* super) {
+  return super->instsEmpty() && super->superType != SUPER_EXTMOD;
+}
+
+/* superNodes must be evaluated by thread 0 in their original order */
+static bool isPinnedSuper(SuperNode* super) {
+  if (super->superType == SUPER_EXTMOD) return true;
+  for (Node* member : super->member) {
+    if (member->type == NODE_SPECIAL) return true;
+  }
+  return false;
+}
+
+/* superNodes that may call activateAll(), no other superNode can be evaluated simultaneously */
+static bool isExclusiveSuper(SuperNode* super) {
+  if (super->superType == SUPER_ASYNC_RESET) return true;
+  for (Node* member : super->member) {
+    if (member->isAsyncReset()) return true;
+  }
+  return false;
+}
+
+static size_t superCost(SuperNode* super) {
+  return super->insts.size() + 1;
+}
+
+/* all superNodes that read, write or activate the superNode of node, or are accessed by it */
+static void relatedSuper(Node* node, std::set<SuperNode*>& related) {
+  for (Node* n : node->prev) related.insert(n->super);
+  for (Node* n : node->next) related.insert(n->super);
+  for (Node* n : node->depPrev) related.insert(n->super);
+  for (Node* n : node->depNext) related.insert(n->super);
+  if (node->type == NODE_REG_SRC || node->type == NODE_REG_DST) {
+    if (node->getSrc()) related.insert(node->getSrc()->super);
+    if (node->getDst()) related.insert(node->getDst()->super);
+    if (node->type == NODE_REG_DST && !node->regSplit) {
+      for (Node* n : node->getSrc()->next) related.insert(n->super);
+    }
+  }
+  if (node->type == NODE_REG_UPDATE) {
+    Node* reg = node->regNext;
+    related.insert(reg->super);
+    if (reg->getDst()) related.insert(reg->getDst()->super);
+    for (Node* n : reg->next) related.insert(n->super);
+  }
+  if (node->type == NODE_READER || node->type == NODE_WRITER || node->type == NODE_READWRITER) {
+    for (Node* port : node->parent->member) related.insert(port->super);
+  }
+}
+
+/* dependencies where empty superNodes are replaced by their dependencies */
+static std::set<SuperNode*>& effDepend(SuperNode* super) {
+  if (effDependSuper.find(super) != effDependSuper.end()) return effDependSuper[super];
+  std::set<SuperNode*> ret;
+  for (SuperNode* dep : dependSuper[super]) {
+    if (isEmptySuper(dep)) {
+      std::set<SuperNode*>& depEff = effDepend(dep);
+      ret.insert(depEff.begin(), depEff.end());
+    } else {
+      ret.insert(dep);
+    }
+  }
+  effDependSuper[super] = ret;
+  return effDependSuper[super];
+}
+
+/* a superNode depends on all related superNodes ahead of it in sortedSuper */
+static void buildDepend(std::vector<SuperNode*>& sortedSuper, std::map<SuperNode*, size_t>& order) {
+  SuperNode* prevPinned = nullptr;
+  std::map<Node*, SuperNode*> prevWriter;
+  for (SuperNode* super : sortedSuper) {
+    std::set<SuperNode*> related;
+    for (Node* member : super->member) {
+      relatedSuper(member, related);
+      /* writers of the same memory are serialized */
+      if (member->type == NODE_WRITER || member->type == NODE_READWRITER) {
+        if (prevWriter.find(member->parent) != prevWriter.end()) related.insert(prevWriter[member->parent]);
+        prevWriter[member->parent] = super;
+      }
+    }
+    if (isPinnedSuper(super)) {
+      if (prevPinned) related.insert(prevPinned);
+      prevPinned = super;
+    }
+    for (SuperNode* rel : related) {
+      if (!rel || rel == super || order.find(rel) == order.end()) continue;
+      if (order[rel] < order[super]) dependSuper[super].insert(rel);
+      else dependSuper[rel].insert(super);
+    }
+  }
+}
+
+/*
+  superNodes that each non-empty superNode must be evaluated behind when sortedSuper is reordered within a thread:
+  the dependencies of buildDepend, and all superNodes on the other side of an exclusive superNode
+*/
+void graph::orderDepend(std::map<SuperNode*, std::set<SuperNode*>>& depend) {
+  std::map<SuperNode*, size_t> order;
+  for (size_t i = 0; i < sortedSuper.size(); i ++) order[sortedSuper[i]] = i;
+  buildDepend(sortedSuper, order);
+  SuperNode* lastExclusive = nullptr;
+  std::vector<SuperNode*> sinceExclusive;
+  for (SuperNode* super : sortedSuper) {
+    if (isEmptySuper(super)) continue;
+    depend[super] = effDepend(super);
+    if (lastExclusive) depend[super].insert(lastExclusive);
+    if (isExclusiveSuper(super)) {
+      depend[super].insert(sinceExclusive.begin(), sinceExclusive.end());
+      sinceExclusive.clear();
+      lastExclusive = super;
+    } else {
+      sinceExclusive.push_back(super);
+    }
+  }
+  dependSuper.clear();
+  effDependSuper.clear();
+}
+
+/*
+  every non-empty superNode is a task, which is ready after all its predecessors finished in the current cycle.
+  Exclusive superNodes depend on all tasks ahead of them, and all tasks behind them depend on them.
+*/
+static void buildTaskGraph(std::vector<SuperNode*>& sortedSuper, std::map<SuperNode*, size_t>& order) {
+  std::set<SuperNode*> frontier; // tasks without successors
+  SuperNode* lastExclusive = nullptr;
+  size_t edgeNum = 0, rootNum = 0;
+  for (SuperNode* super : sortedSuper) {
+    if (isEmptySuper(super)) continue;
+    std::set<SuperNode*> deps = effDepend(super);
+    if (isExclusiveSuper(super)) {
+      deps.insert(frontier.begin(), frontier.end());
+      lastExclusive = super;
+    } else if (lastExclusive) {
+      bool afterExclusive = false;
+      for (SuperNode* dep : deps) afterExclusive |= order[dep] >= order[lastExclusive];
+      if (!afterExclusive) deps.insert(lastExclusive);
+    }
+    for (SuperNode* dep : deps) {
+      dep->taskNext.push_back(super);
+      frontier.erase(dep);
+    }
+    frontier.insert(super);
+    super->taskDepNum = deps.size();
+    edgeNum += deps.size();
+    if (deps.empty()) rootNum ++;
+  }
+  printStat("[threadPartition] task graph: %ld edges, %ld roots, %ld sinks\n", edgeNum, rootNum, frontier.size());
+}
+
+/* a barrier is inserted before superNodes depending on another partition in the current epoch */
+static int repcutEpoch(std::vector<SuperNode*>& sortedSuper, std::vector<size_t>& totalLoad) {
+  int floorEpoch = 0, maxEpoch = 0;
+  bool anyAssigned = false;
+  for (SuperNode* super : sortedSuper) {
+    if (isEmptySuper(super)) continue;
+    /* registers are updated by the partition computing their next values */
+    if (super->superType == SUPER_UPDATE_REG) super->threadId = super->member[0]->regNext->getDst()->super->threadId;
+    int epoch = floorEpoch;
+    /* empty superNodes only hold inputs and registers here, which do not order their readers */
+    for (SuperNode* dep : dependSuper[super]) {
+      if (!isEmptySuper(dep)) epoch = MAX(epoch, dep->epoch + (dep->threadId != super->threadId));
+    }
+    if (isExclusiveSuper(super)) {
+      epoch = MAX(epoch, anyAssigned ? maxEpoch + 1 : 0);
+      floorEpoch = epoch + 1;
+    }
+    super->epoch = epoch;
+    maxEpoch = MAX(maxEpoch, epoch);
+    anyAssigned = true;
+    totalLoad[super->threadId] += superCost(super);
+  }
+  return maxEpoch;
+}
+
+void graph::threadPartition() {
+  int threadNum = globalConfig.threadNum;
+  std::map<SuperNode*, size_t> order;
+  for (size_t i = 0; i < sortedSuper.size(); i ++) order[sortedSuper[i]] = i;
+  buildDepend(sortedSuper, order);
+
+  if (globalConfig.workSteal) {
+    buildTaskGraph(sortedSuper, order);
+    dependSuper.clear();
+    effDependSuper.clear();
+    return;
+  }
+
+  if (globalConfig.repcut) {
+    std::vector<size_t> totalLoad(threadNum, 0);
+    int barrierNum = repcutEpoch(sortedSuper, totalLoad);
+    printStat("[threadPartition] repcut: %d barriers, %d threads\n", barrierNum, threadNum);
+    for (int i = 0; i < threadNum; i ++) printStat("[threadPartition] thread %d: cost %ld\n", i, totalLoad[i]);
+    dependSuper.clear();
+    effDependSuper.clear();
+    return;
+  }
+
+  /* levelize */
+  std::map<SuperNode*, int> level;
+  std::vector<std::vector<SuperNode*>> levelSuper;
+  int floorLevel = 0;
+  for (SuperNode* super : sortedSuper) {
+    if (isEmptySuper(super)) continue;
+    int lv = floorLevel;
+    for (SuperNode* dep : effDepend(super)) lv = MAX(lv, level[dep] + 1);
+    if (isExclusiveSuper(super)) {
+      lv = MAX(lv, (int)levelSuper.size());
+      floorLevel = lv + 1;
+    }
+    level[super] = lv;
+    if ((int)levelSuper.size() <= lv) levelSuper.resize(lv + 1);
+    levelSuper[lv].push_back(super);
+  }
+
+  /* distribute levels among threads */
+  std::vector<size_t> load(threadNum, 0);
+  std::vector<size_t> totalLoad(threadNum, 0);
+  int epoch = 0;
+  bool epochUsed = false;
+  bool forceSync = false;
+  for (std::vector<SuperNode*>& supers : levelSuper) {
+    if (supers.empty()) continue;
+    std::stable_sort(supers.begin(), supers.end(), [](SuperNode* a, SuperNode* b) { return superCost(a) > superCost(b); });
+    bool needSync = forceSync;
+    forceSync = false;
+    std::vector<int> affinity(supers.size(), -1);
+    for (size_t i = 0; i < supers.size() && !needSync; i ++) {
+      std::set<int> threads;
+      for (SuperNode* dep : effDepend(supers[i])) {
+        if (dep->epoch == epoch) threads.insert(dep->threadId);
+      }
+      if (isExclusiveSuper(supers[i]) || threads.size() > 1) needSync = true;
+      else if (threads.size() == 1) affinity[i] = *threads.begin();
+      if (isPinnedSuper(supers[i]) && affinity[i] > 0) needSync = true;
+    }
+    std::vector<size_t> levelLoad(threadNum, 0);
+    std::vector<int> assign(supers.size());
+    size_t levelCost = 0;
+    if (!needSync) {
+      std::vector<size_t> newLoad(load);
+      for (size_t i = 0; i < supers.size(); i ++) {
+        int tid = affinity[i];
+        if (tid < 0) tid = isPinnedSuper(supers[i]) ? 0 : std::min_element(newLoad.begin(), newLoad.end()) - newLoad.begin();
+        assign[i] = tid;
+        newLoad[tid] += superCost(supers[i]);
+        levelLoad[tid] += superCost(supers[i]);
+        levelCost += superCost(supers[i]);
+      }
+      /* a barrier is worthwhile if the level is large but evaluated by few threads */
+      size_t parallelism = MIN((size_t)threadNum, supers.size());
+      size_t maxLevelLoad = *std::max_element(levelLoad.begin(), levelLoad.end());
+      if (levelCost >= SYNC_MIN_COST * parallelism && maxLevelLoad * parallelism > 2 * levelCost) needSync = true;
+      else load = newLoad;
+    }
+    if (needSync) {
+      if (epochUsed) epoch ++;
+      std::fill(load.begin(), load.end(), 0);
+      for (size_t i = 0; i < supers.size(); i ++) {
+        assign[i] = isPinnedSuper(supers[i]) || isExclusiveSuper(supers[i]) ? 0 : std::min_element(load.begin(), load.end()) - load.begin();
+        load[assign[i]] += superCost(supers[i]);
+        if (isExclusiveSuper(supers[i])) forceSync = true;
+      }
+    }
+    for (size_t i = 0; i < supers.size(); i ++) {
+      supers[i]->threadId = assign[i];
+      supers[i]->epoch = epoch;
+      totalLoad[assign[i]] += superCost(supers[i]);
+    }
+    epochUsed = true;
+  }
+
+  printStat("[threadPartition] %ld levels, %d barriers, %d threads\n", levelSuper.size(), epoch, threadNum);
+  for (int i = 0; i < threadNum; i ++) printStat("[threadPartition] thread %d: cost %ld\n", i, totalLoad[i]);
+  dependSuper.clear();
+  effDependSuper.clear();
+}
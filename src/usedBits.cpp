@@ -83,7 +83,7 @@ void ENode::passWidthToChild() {
       childBits.push_back(usedBit);
       break;
     case OP_SHL:
-      childBits.push_back(MAX(0, usedBit - values[0]));
+      childBits.push_back(MAX(1, usedBit - values[0]));
       break;
     case OP_SHR:
       childBits.push_back(usedBit + values[0]);